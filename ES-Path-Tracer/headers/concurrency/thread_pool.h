@@ -0,0 +1,57 @@
+#ifndef ES_PATH_TRACER__CONCURRENCY__THREAD_POOL_H_
+#define ES_PATH_TRACER__CONCURRENCY__THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrency
+{
+	/*	Thread_Pool objects start their threads once and keep them waiting for work, so that 
+		consecutive frames and jobs (scene build, rendering, output encoding) do not pay for
+		thread creation. Work is given as a parallel region, a task that every thread of the 
+		pool runs once, or as a parallel loop. Both block until all threads are done, and must
+		not be called from a task running in the same pool */
+	class Thread_Pool {
+	public:
+		// A number of threads of 0 uses one thread per hardware thread
+		explicit Thread_Pool(int num_threads = 0, bool pin_threads = false);
+		~Thread_Pool();
+
+		Thread_Pool(const Thread_Pool&) = delete;
+		Thread_Pool& operator=(const Thread_Pool&) = delete;
+
+		// Runs task(thread_index) on every thread of the pool
+		void run(const std::function<void(int)>& task);
+
+		// Calls body(i) for every i in [begin, end), handing indices out to the threads one by one
+		void parallel_for(int begin, int end, const std::function<void(int)>& body);
+
+		// Acessor functions
+		int num_threads() const { return (int) m_threads.size(); }
+		bool pin_threads() const { return m_pin_threads; }
+
+	private:
+		std::vector<std::thread> m_threads;
+		bool m_pin_threads;
+		// Serializes parallel regions requested from different threads
+		std::mutex m_run_lock;
+		// Protects the members below
+		std::mutex m_lock;
+		std::condition_variable m_work_ready;
+		std::condition_variable m_work_done;
+		const std::function<void(int)>* m_task;
+		unsigned long long m_generation;
+		int m_busy_threads;
+		bool m_stop;
+
+		void worker(int thread_index);
+
+		// Binds the thread to the hardware thread of the same index, where supported
+		void pin(int thread_index);
+	};
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef ES_PATH_TRACER__CONFIG__RENDER_CONFIG_H_
+#define ES_PATH_TRACER__CONFIG__RENDER_CONFIG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../path-tracer/evolution_strategy_path_tracer.h"
+#include "../path-tracer/monte_carlo_path_tracer.h"
+#include "../path-tracer/path_tracer.h"
+#include "../path-tracer/wavefront_path_tracer.h"
+
+namespace config
+{
+	/*	Render_Config objects hold the options of a run of the renderer, resolved once at start 
+		up from the command line and configuration files, so that no option is looked up by name
+		while rendering. Options are given as --name=value or --name value, and boolean options
+		also as --name alone. --config=file reads a file of "name = value" lines, where '#' 
+		starts a comment; options are applied in order, so later ones override earlier ones */
+	class Render_Config {
+	public:
+		enum Integrator { EVOLUTION_STRATEGY_INTEGRATOR, MONTE_CARLO_INTEGRATOR, WAVEFRONT_INTEGRATOR };
+
+		// Rendering in this process, or distributed over a coordinator and its workers
+		enum Mode { LOCAL_MODE, COORDINATOR_MODE, WORKER_MODE };
+
+		Integrator integrator;
+		Mode mode;
+		bool help;
+
+		// Distributed rendering
+		std::string host;
+		int port;
+		int passes_per_job;
+		int tiles_per_job;
+		double job_timeout;
+
+		// General parameters
+		int num_threads;  // 0 uses every hardware thread
+		bool pin_threads;
+		int max_passes;
+		double time_budget;
+		double adaptive_threshold;
+		int adaptive_min_passes;
+		std::string checkpoint_filename;
+		double checkpoint_interval;
+		bool resume;
+		int resolution_width;
+		double window_width;
+		double aspect_ratio;
+		double gamma_coefficient;
+		double gamma_exponent;
+		int tile_size;
+		int max_bounces;
+		int roulette_min_bounces;
+		double roulette_threshold;
+		Path_Tracer::Light_Selection light_selection;
+		bool has_seed;
+		std::uint64_t seed;
+
+		// Evolution Strategy parameters
+		int max_iterations_per_pixel;
+		int population_size;
+		double children_population_ratio;
+		Evolution_Strategy_Path_Tracer::Heuristic heuristic;
+		int histogram_radius;
+		Evolution_Strategy_Path_Tracer::Radiance_Coefficient fitness_radiance_coefficient;
+		Evolution_Strategy_Path_Tracer::Frequency_Coefficient fitness_frequency_coefficient;
+		Evolution_Strategy_Path_Tracer::Radiance_Coefficient ranking_radiance_coefficient;
+		Evolution_Strategy_Path_Tracer::Frequency_Coefficient ranking_frequency_coefficient;
+
+		// Vanilla Path Tracer parameters
+		int samples_per_pixel;
+		Monte_Carlo_Path_Tracer::Sampler sampler;
+		bool sort_secondary_rays;
+		int wavefront_size;
+
+		// Output
+		std::string output_filename;
+		// Whether tiles are written to the file as they are finished, instead of all at the end
+		bool stream;
+		bool display;
+		// Whether the render statistics are printed, and the file where they are written as JSON
+		bool print_stats;
+		std::string stats_filename;
+		// File where a Chrome trace of the render threads is written, empty for none
+		std::string trace_filename;
+
+		// Default options
+		Render_Config();
+
+		/*	Applies the options of the command line, arguments 1 to argc - 1. Throws 
+			std::invalid_argument on unknown options or invalid values, and std::runtime_error if 
+			a configuration file cannot be read */
+		void parse_command_line(int argc, char* argv[]);
+
+		/*	Applies the options of a configuration file, with the errors of parse_command_line. 
+			A file that includes itself, directly or through others, is an invalid argument */
+		void load(const std::string& filename);
+
+		// Applies one option
+		void set(const std::string& name, const std::string& value);
+
+		// Description of the options
+		static std::string usage();
+
+	private:
+		// Configuration files being loaded, the outermost first, to reject one including itself
+		std::vector<std::string> m_loading_files;
+	};
+}
+
+#endif
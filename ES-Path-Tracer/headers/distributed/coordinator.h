@@ -0,0 +1,76 @@
+#ifndef ES_PATH_TRACER__DISTRIBUTED__COORDINATOR_H_
+#define ES_PATH_TRACER__DISTRIBUTED__COORDINATOR_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../image/framebuffer.h"
+#include "../path-tracer/path_tracer.h"
+#include "protocol.h"
+#include "socket.h"
+
+namespace distributed
+{
+	/*	Coordinator objects render an image with worker processes, possibly on other machines. 
+		The image of a path tracer is split into jobs of passes_per_job passes of a run of 
+		tiles_per_job tiles, which are handed out to the workers that connect, one at a time 
+		per worker. Results are merged into the framebuffer as they arrive, by adding up their 
+		radiance sums, sample counts and luminance statistics, so jobs of the same tiles may be
+		rendered by different workers. A worker that drops its connection, sends an invalid result or takes longer
+		than the job timeout is dropped, and its job is handed out again */
+	class Coordinator {
+	public:
+		static const int DEFAULT_JOB_TIMEOUT = 600;
+
+		/*	Jobs cover the whole image of path_tracer, with its tile size, number of passes and 
+			seed. A number of passes per job of 0 renders every pass of the tiles in one job, 
+			and a number of tiles per job of 0 (or more than a row of tiles) puts a whole row of
+			tiles in each job, to keep every thread of the workers busy */
+		explicit Coordinator(const Path_Tracer& path_tracer, int passes_per_job = 0, int tiles_per_job = 0);
+
+		/*	Renders the image into framebuffer with the workers that connect to listener, and 
+			returns once every job is merged. It waits for workers as long as jobs are left */
+		void render(Socket& listener, Framebuffer& framebuffer);
+
+		// Acessor functions
+		int num_jobs() const { return (int) m_jobs.size(); }
+		double job_timeout() const { return m_job_timeout; }
+		// Jobs handed out again after their worker was dropped, in the last render
+		int reissued_jobs() const { return m_reissued_jobs; }
+
+		// Seconds a worker may take to answer a job. 0 waits indefinitely
+		void set_job_timeout(double seconds);
+
+	private:
+		int m_width;
+		int m_height;
+		int m_tile_size;
+		std::vector<Job> m_jobs;
+		double m_job_timeout;
+		// Render state, protected by m_lock
+		std::mutex m_lock;
+		std::condition_variable m_job_available;
+		Framebuffer* m_framebuffer;
+		std::deque<int> m_pending_jobs;
+		std::vector<unsigned char> m_merged_jobs;
+		int m_remaining_jobs;
+		int m_reissued_jobs;
+
+		// Talks to one worker until no job is left or the worker is dropped
+		void serve(Socket socket);
+
+		// Waits for a job to hand out. Returns false when every job is merged
+		bool take_job(Job& job);
+
+		void reissue_job(const Job& job);
+
+		// Returns false if the payload is not a result of the job
+		bool merge_result(const Job& job, const std::string& payload);
+	};
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ES_PATH_TRACER__DISTRIBUTED__PROTOCOL_H_
+#define ES_PATH_TRACER__DISTRIBUTED__PROTOCOL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "socket.h"
+
+namespace distributed
+{
+	/*	Messages between the coordinator and its workers. A worker opens the connection with
+		HELLO, then receives JOB messages and answers each with a RESULT, until the coordinator
+		sends SHUTDOWN. Every message is a header (type and payload size) followed by the 
+		payload. Numbers are sent in the byte order of the machine, so all the processes of a 
+		render must run on machines of the same endianness */
+	enum Message_Type : std::uint32_t { HELLO = 1, JOB = 2, RESULT = 3, SHUTDOWN = 4 };
+
+	const std::uint32_t PROTOCOL_VERSION = 2;
+
+	// Largest payload accepted, to reject corrupted headers
+	const std::uint64_t MAX_PAYLOAD_SIZE = 1ull << 32;
+
+	/*	Passes [first_pass, first_pass + num_passes) of tiles [tile, tile + num_tiles) of the 
+		image, numbered row by row in its grid of tiles. The tiles of a job lie in one row of 
+		the grid, so that its result is a single window, and the threads of the worker share 
+		them. Jobs of the same tiles with disjoint passes draw different samples, and their 
+		results add up to those of all their passes */
+	struct Job {
+		std::int32_t id;
+		std::int32_t tile;
+		std::int32_t num_tiles;
+		std::int32_t first_pass;
+		std::int32_t num_passes;
+		std::uint64_t seed;
+	};
+
+	// Return false if the connection is lost or the message is malformed
+	bool send_message(Socket& socket, Message_Type type, const std::string& payload);
+	bool receive_message(Socket& socket, Message_Type& type, std::string& payload);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef ES_PATH_TRACER__DISTRIBUTED__SOCKET_H_
+#define ES_PATH_TRACER__DISTRIBUTED__SOCKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace distributed
+{
+	/*	Socket objects own a TCP socket, either listening for connections or connected to a 
+		peer, and close it when destroyed. They can be moved but not copied. Failing to set up
+		a socket throws std::runtime_error, while a lost connection is reported by the return 
+		value of the transfer functions, so that the caller can recover from it */
+	class Socket {
+	public:
+		Socket() : m_handle(INVALID_HANDLE) {}
+		~Socket() { close(); }
+
+		Socket(Socket&& other);
+		Socket& operator=(Socket&& other);
+
+		Socket(const Socket&) = delete;
+		Socket& operator=(const Socket&) = delete;
+
+		static Socket connect(const std::string& host, int port);
+
+		// Socket accepting connections on every interface. Port 0 picks a free port
+		static Socket listen(int port, int backlog = 16);
+
+		// Waits for the next connection to a listening socket
+		Socket accept();
+
+		// Port a listening socket is bound to
+		int local_port() const;
+
+		/*	Waits until data or a connection can be read without blocking. Returns false if 
+			nothing arrived within the given number of seconds */
+		bool wait_readable(double seconds) const;
+
+		// Receiving fails if no data arrives for this many seconds. 0 waits indefinitely
+		void set_receive_timeout(double seconds);
+
+		// Returns false if the connection is lost before all bytes are sent
+		bool send_all(const void* data, size_t size);
+
+		// Returns false if the connection is lost or times out before size bytes arrive
+		bool receive_all(void* data, size_t size);
+
+		void close();
+
+		bool valid() const { return m_handle != INVALID_HANDLE; }
+
+	private:
+		// Native handle, large enough for both Winsock and POSIX sockets
+		static const std::intptr_t INVALID_HANDLE = -1;
+		std::intptr_t m_handle;
+
+		explicit Socket(std::intptr_t handle) : m_handle(handle) {}
+	};
+}
+
+#endif
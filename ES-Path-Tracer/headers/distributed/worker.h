@@ -0,0 +1,27 @@
+#ifndef ES_PATH_TRACER__DISTRIBUTED__WORKER_H_
+#define ES_PATH_TRACER__DISTRIBUTED__WORKER_H_
+
+#include <string>
+
+#include "../path-tracer/path_tracer.h"
+
+namespace distributed
+{
+	/*	Worker objects render the jobs handed out by a coordinator. Their path tracer must be 
+		set up like the coordinator's: same scene, camera, resolution, tile size and number of
+		samples per pass. Jobs change its seed, tiles and range of passes */
+	class Worker {
+	public:
+		explicit Worker(Path_Tracer& path_tracer) : m_path_tracer(path_tracer) {}
+
+		/*	Connects to the coordinator and renders jobs until it is told to stop. Returns the 
+			number of jobs rendered. Throws std::runtime_error if the coordinator cannot be 
+			reached or the connection is lost */
+		int run(const std::string& host, int port);
+
+	private:
+		Path_Tracer& m_path_tracer;
+	};
+}
+
+#endif
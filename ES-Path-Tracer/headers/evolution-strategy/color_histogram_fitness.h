@@ -4,32 +4,66 @@
 #include "../geometry/ray.h"
 #include "../path-tracer/color_histogram.h"
 #include "../path-tracer/path_tracer.h"
+#include "../shading/color3.h"
 #include "individual.h"
 
 namespace es
 {
+	/*	Fitness of an individual: the radiance coefficient of the gamma corrected color of its
+		path, times the frequency coefficient of that color in the histogram of the pixel */
 	class Color_Histogram_Fitness {
 	public:
+		/*	Coefficients of a gamma corrected color: 1, the maximum or the mean of its channels,
+			normalized to [0, 1] or not, or the product of the normalized mean and maximum */
+		enum Radiance_Coefficient {
+			NO_RADIANCE_COEFFICIENT,
+			MAXIMUM_RADIANCE,
+			NORM_MAXIMUM_RADIANCE,
+			MEAN_RADIANCE,
+			NORM_MEAN_RADIANCE,
+			NORM_MEAN_AND_MAXIMUM_RADIANCE
+		};
+
+		/*	Coefficients of the frequency of a color in a histogram: 1, or the information 
+			quantity of the color or its inverse */
+		enum Frequency_Coefficient {
+			NO_FREQUENCY_COEFFICIENT,
+			INFORMATION_QUANTITY,
+			INVERSE_INFORMATION_QUANTITY
+		};
+
 		Color_Histogram_Fitness(
 			const Path_Tracer& path_tracer,
 			Color_Histogram* color_histogram,
 			const Ray& ray,
-			int radius = 4);
+			const Path_Tracer::Eye_Ray_Hit& eye_ray_hit,
+			int radius = 4,
+			Radiance_Coefficient radiance_coefficient = NORM_MEAN_RADIANCE,
+			Frequency_Coefficient frequency_coefficient = INFORMATION_QUANTITY);
 
 		double operator()(Individual& individual);
 
+		static double radiance_coefficient(Radiance_Coefficient coefficient, const Radiance3& display_value);
+
 		// Acessor functions
 		const Color_Histogram* color_histogram() const { return m_color_histogram; }
 		int radius() const { return m_radius; }
+		Radiance_Coefficient radiance_coefficient() const { return m_radiance_coefficient; }
+		Frequency_Coefficient frequency_coefficient() const { return m_frequency_coefficient; }
 		// Setters
 		void set_color_histogram(Color_Histogram* histogram);
 		void set_radius(int radius);
+		void set_radiance_coefficient(Radiance_Coefficient coefficient) { m_radiance_coefficient = coefficient; }
+		void set_frequency_coefficient(Frequency_Coefficient coefficient) { m_frequency_coefficient = coefficient; }
 
 	private:
 		const Path_Tracer* m_path_tracer;
 		Color_Histogram* m_color_histogram;
 		const Ray& m_ray;
+		const Path_Tracer::Eye_Ray_Hit& m_eye_ray_hit;
 		int m_radius;
+		Radiance_Coefficient m_radiance_coefficient;
+		Frequency_Coefficient m_frequency_coefficient;
 	};
 }
 
@@ -0,0 +1,47 @@
+#ifndef ES_PATH_TRACER_GEOMETRY_RAY_PACKET_H_
+#define ES_PATH_TRACER_GEOMETRY_RAY_PACKET_H_
+
+#include "aab.h"
+#include "ray.h"
+#include "triangle.h"
+
+/*	Ray_Packet objects hold up to SIZE coherent rays (e.g. the eye rays of a 2x2 block of
+	pixels) in structure-of-arrays layout, so that box, plane and triangle tests are computed
+	for every ray at once by short fixed-length loops the compiler can vectorize. Rays are
+	selected through lane masks, where bit i corresponds to the i-th ray of the packet */
+class Ray_Packet {
+public:
+	static const int SIZE = 4;
+
+	double origin[3][SIZE];
+	double direction[3][SIZE];
+
+	Ray_Packet(const Ray* rays, int num_rays);
+
+	int size() const { return m_size; }
+
+	// Mask with the lanes that hold a ray
+	int mask() const { return (1 << m_size) - 1; }
+
+	// Rebuilds the i-th ray of the packet
+	Ray ray(int i) const;
+
+	// True if all rays have the same direction sign in every axis, so that they visit kd-tree
+	// children in the same order
+	bool coherent() const;
+
+	// Parameters t where each ray crosses the axis-aligned plane at the given position
+	void intersect_plane(int axis, double position, double t[SIZE]) const;
+
+	// AABB intersection for the lanes in mask. Returns the mask of lanes that hit the box
+	int intersect(const AAB& aabb, int mask, double t_near[SIZE], double t_far[SIZE]) const;
+
+	// Triangle intersection for the lanes in mask. Returns the mask of lanes that hit the
+	// triangle, whose parameters are stored in t
+	int intersect(const Triangle& tri, int mask, double t[SIZE]) const;
+
+private:
+	int m_size;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ES_PATH_TRACER__GEOMETRY__RAY_STREAM_H_
+#define ES_PATH_TRACER__GEOMETRY__RAY_STREAM_H_
+
+#include <vector>
+
+#include "aab.h"
+#include "ray.h"
+
+/*	Ray_Stream objects collect the rays of many independent paths so that they can be traced
+	in coherent order. Rays are sorted by a key made of their direction octant followed by the
+	Morton code of their origin's cell in a grid over the given bounds, so consecutive rays
+	start close to each other and visit the acceleration structures in the same order. Every
+	ray carries an id that identifies the path it belongs to */
+class Ray_Stream {
+public:
+	// Bits per axis of the origin grid
+	static const int GRID_BITS = 10;
+
+	Ray_Stream(const AAB& bounds) : m_bounds(bounds) {}
+
+	void push(const Ray& ray, int id);
+
+	void sort();
+
+	void clear() { m_entries.clear(); }
+
+	// Acessor functions
+	size_t size() const { return m_entries.size(); }
+	bool empty() const { return m_entries.empty(); }
+	const Ray& ray(size_t i) const { return m_entries[i].ray; }
+	int id(size_t i) const { return m_entries[i].id; }
+	const AAB& bounds() const { return m_bounds; }
+
+private:
+	struct Entry {
+		unsigned long long key;
+		int id;
+		Ray ray;
+
+		Entry(unsigned long long key, int id, const Ray& ray) : key(key), id(id), ray(ray) {}
+	};
+
+	AAB m_bounds;
+	std::vector<Entry> m_entries;
+
+	unsigned long long key(const Ray& ray) const;
+
+	unsigned int grid_cell(double position, double min, double max) const;
+
+	static unsigned long long expand_bits(unsigned int value);
+};
+
+#endif
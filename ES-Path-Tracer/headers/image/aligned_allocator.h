@@ -0,0 +1,46 @@
+#ifndef ES_PATH_TRACER__IMAGE__ALIGNED_ALLOCATOR_H_
+#define ES_PATH_TRACER__IMAGE__ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/*	Standard allocator that returns memory aligned to ALIGNMENT bytes (a power of two at least
+	as large as a pointer), so that buffers start at a cache line boundary. The block returned 
+	by operator new is stored just before the aligned address to be released afterwards */
+template <typename T, std::size_t ALIGNMENT>
+class Aligned_Allocator {
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind { typedef Aligned_Allocator<U, ALIGNMENT> other; };
+
+	Aligned_Allocator() {}
+
+	template <typename U>
+	Aligned_Allocator(const Aligned_Allocator<U, ALIGNMENT>&) {}
+
+	T* allocate(std::size_t n)
+	{
+		void* block = ::operator new(n * sizeof(T) + ALIGNMENT + sizeof(void*));
+		const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+		void** aligned = reinterpret_cast<void**>((address + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+		aligned[-1] = block;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* pointer, std::size_t)
+	{
+		if (pointer)
+			::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const Aligned_Allocator<U, ALIGNMENT>&) const { return true; }
+
+	template <typename U>
+	bool operator!=(const Aligned_Allocator<U, ALIGNMENT>&) const { return false; }
+};
+
+#endif
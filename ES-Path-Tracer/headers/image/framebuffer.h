@@ -0,0 +1,123 @@
+#ifndef ES_PATH_TRACER__IMAGE__FRAMEBUFFER_H_
+#define ES_PATH_TRACER__IMAGE__FRAMEBUFFER_H_
+
+#include <iosfwd>
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "../shading/color3.h"
+
+/*	Framebuffer objects accumulate the linear radiance estimated for every pixel of an image,
+	together with the number of samples behind it, so that passes can be added progressively 
+	and images rendered separately can be merged. Pixels can also carry a number of extra 
+	float channels (e.g. albedo or depth for a denoiser).
+
+	A framebuffer can hold a window of a larger image, whose position in the image is given by
+	its offsets. Pixels are always addressed relative to the framebuffer.
+
+	Pixels estimated in several independent estimates (e.g. one per rendering pass) also track
+	the mean and variance of the luminance of their estimates, with Welford's algorithm, to 
+	tell how far the pixel is from convergence.
+	
+	All values live in one contiguous float buffer aligned to a cache line. The image is split
+	in square tiles, stored one after another, and the pixels of a tile are stored row by row.
+	With the tile size of the renderer, each thread writes to a contiguous block of memory that
+	no other thread touches. Tiles on the right and bottom borders are padded to full size */
+class Framebuffer {
+public:
+	static const int ALIGNMENT = 64;
+	static const int DEFAULT_TILE_SIZE = 16;
+
+	// Floats per pixel taken by the radiance sum
+	static const int RADIANCE_CHANNELS = 3;
+
+	Framebuffer();
+	Framebuffer(int width, int height, int tile_size = DEFAULT_TILE_SIZE, int extra_channels = 0);
+
+	// Adds the sum of num_samples radiance samples to the pixel
+	void accumulate(int row, int col, const Radiance3& radiance_sum, int num_samples);
+
+	/*	Adds an independent estimate of the pixel, the mean of num_samples radiance samples, and
+		updates the pixel's luminance statistics */
+	void add_estimate(int row, int col, const Radiance3& mean_radiance, int num_samples);
+
+	// Replaces the pixel's accumulated radiance by the mean of num_samples samples
+	void set(int row, int col, const Radiance3& mean_radiance, int num_samples);
+
+	// Mean radiance of the samples accumulated in the pixel, 0 if there is none
+	Radiance3 radiance(int row, int col) const;
+
+	int num_samples(int row, int col) const { return m_num_samples[index(row, col)]; }
+	int num_estimates(int row, int col) const { return m_num_estimates[index(row, col)]; }
+
+	// Sample variance of the luminance of the pixel's estimates, 0 with less than two of them
+	double luminance_variance(int row, int col) const;
+
+	/*	Half width of the confidence interval of the pixel's mean luminance, for the given 
+		number of standard errors (1.96 for 95%) */
+	double luminance_error(int row, int col, double standard_errors = 1.96) const;
+
+	double luminance(int row, int col) const { return m_luminance_mean[index(row, col)]; }
+
+	float& extra_channel(int row, int col, int channel);
+	float extra_channel(int row, int col, int channel) const;
+
+	/*	Adds the samples of a framebuffer with the same dimensions and channels. Luminance 
+		statistics are combined as those of the union of both sets of estimates */
+	void merge(const Framebuffer& other);
+
+	/*	Adds the samples of a framebuffer that holds a window of the same image, with the same 
+		extra channels, to the pixels it overlaps */
+	void merge_region(const Framebuffer& region);
+
+	// Removes all samples
+	void clear();
+
+	/*	Writes the layout and every accumulator to a binary stream, in native byte order, so that
+		read restores the framebuffer exactly */
+	void write(std::ostream& out) const;
+	// Throws std::runtime_error if the stream does not hold a valid framebuffer
+	void read(std::istream& in);
+
+	// Acessor functions
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	int tile_size() const { return m_tile_size; }
+	int extra_channels() const { return m_extra_channels; }
+	int channels() const { return RADIANCE_CHANNELS + m_extra_channels; }
+	int row_offset() const { return m_row_offset; }
+	int col_offset() const { return m_col_offset; }
+
+	// Position of the framebuffer's top left pixel in the image
+	void set_offset(int row_offset, int col_offset);
+
+	// Raw buffer of channels() floats per pixel, in tile order (see index)
+	const float* data() const { return m_data.data(); }
+	const unsigned int* sample_counts() const { return m_num_samples.data(); }
+
+	// Position of the pixel in tile order
+	int index(int row, int col) const;
+
+private:
+	int m_width;
+	int m_height;
+	int m_tile_size;
+	int m_extra_channels;
+	int m_tiles_per_row;
+	int m_row_offset;
+	int m_col_offset;
+	std::vector<float, Aligned_Allocator<float, ALIGNMENT>> m_data;
+	std::vector<unsigned int, Aligned_Allocator<unsigned int, ALIGNMENT>> m_num_samples;
+	// Welford accumulators of the luminance of the estimates
+	std::vector<unsigned int, Aligned_Allocator<unsigned int, ALIGNMENT>> m_num_estimates;
+	std::vector<float, Aligned_Allocator<float, ALIGNMENT>> m_luminance_mean;
+	std::vector<float, Aligned_Allocator<float, ALIGNMENT>> m_luminance_m2;
+
+	float* pixel(int row, int col) { return &m_data[index(row, col) * channels()]; }
+	const float* pixel(int row, int col) const { return &m_data[index(row, col) * channels()]; }
+
+	// Adds the samples and luminance statistics of pixel j of other to pixel i
+	void merge_pixel(int i, const Framebuffer& other, int j);
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ES_PATH_TRACER__IMAGE__IMAGE_WRITER_H_
+#define ES_PATH_TRACER__IMAGE__IMAGE_WRITER_H_
+
+#include <string>
+
+#include "../concurrency/thread_pool.h"
+#include "framebuffer.h"
+#include "tone_mapper.h"
+
+/*	Writers of the mean radiance of a framebuffer to image files. Float formats stream the 
+	pixels straight from the framebuffer, with one buffered write per row or tile; PPM files
+	are written at once from the display values of the tone mapper. Each one throws 
+	std::runtime_error if the file cannot be written */
+namespace image_writer
+{
+	/*	Headers of PPM and PFM files, which are followed by the pixels row by row, with 3 bytes 
+		per pixel in PPM files and 3 floats in PFM files, from the bottom row up */
+	std::string ppm_header(int width, int height);
+	std::string pfm_header(int width, int height);
+
+	/*	Binary PPM (P6) of the 8-bit display values of the tone mapper, mapped by the threads of
+		the pool, if any */
+	void write_ppm(const std::string& filename, const Framebuffer& framebuffer, const Tone_Mapper& tone_mapper,
+		concurrency::Thread_Pool* thread_pool = nullptr);
+
+	// PFM of 32-bit float linear radiance, in the byte order of the machine
+	void write_pfm(const std::string& filename, const Framebuffer& framebuffer);
+
+	/*	Tiled OpenEXR of 32-bit float linear radiance, with the framebuffer's tile size. Its data
+		window is the framebuffer's window of the image */
+	void write_exr(const std::string& filename, const Framebuffer& framebuffer);
+
+	// Extension of the file name, in lower case, without the dot
+	std::string extension(const std::string& filename);
+
+	/*	Writes with the format of the file's extension: .pfm and .exr keep the linear radiance,
+		anything else is written as a PPM of display values */
+	void write_image(const std::string& filename, const Framebuffer& framebuffer, const Tone_Mapper& tone_mapper,
+		concurrency::Thread_Pool* thread_pool = nullptr);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef ES_PATH_TRACER__IMAGE__TILE_WRITER_H_
+#define ES_PATH_TRACER__IMAGE__TILE_WRITER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "tiled_exr_writer.h"
+#include "tone_mapper.h"
+
+/*	Tile_Writer objects write the tiles of an image to its file while it is being rendered, from a
+	thread of their own, so that file output overlaps with rendering and the image never has 
+	to be held in memory as a whole. Tiles are queued by push, which blocks while the queue is 
+	full, hence at most max_queued_tiles finished tiles wait in memory.
+
+	The format follows the extension of the file, as in image_writer::write_image. PPM and PFM 
+	files are laid out in full when opened, and the rows of each tile are written at their 
+	fixed offsets; OpenEXR files are tiled, with the tile size of the writer. Pixels of tiles 
+	that are never pushed are black */
+class Tile_Writer {
+public:
+	static const int DEFAULT_MAX_QUEUED_TILES = 64;
+
+	/*	Opens the file for a window of width x height pixels at (row_offset, col_offset) of the
+		image, whose tiles are tile_size pixels wide from the window's origin. Throws 
+		std::runtime_error if the file cannot be written */
+	Tile_Writer(
+		const std::string& filename,
+		int width,
+		int height,
+		int tile_size,
+		int row_offset,
+		int col_offset,
+		const Tone_Mapper& tone_mapper,
+		int max_queued_tiles = DEFAULT_MAX_QUEUED_TILES);
+
+	// Finishes the file if finish was not called, ignoring errors
+	~Tile_Writer();
+
+	Tile_Writer(const Tile_Writer&) = delete;
+	Tile_Writer& operator=(const Tile_Writer&) = delete;
+
+	/*	Queues a framebuffer that holds one tile of the window, at its offsets. Throws 
+		std::runtime_error if writing an earlier tile failed */
+	void push(std::unique_ptr<Framebuffer> tile);
+
+	/*	Writes the queued tiles and closes the file. Throws std::runtime_error if any tile could 
+		not be written */
+	void finish();
+
+private:
+	enum Format { PPM_FORMAT, PFM_FORMAT, EXR_FORMAT };
+
+	Format m_format;
+	int m_width;
+	int m_height;
+	int m_tile_size;
+	int m_row_offset;
+	int m_col_offset;
+	// Copied, so that the display values do not change while the tiles are written
+	Tone_Mapper m_tone_mapper;
+	size_t m_max_queued_tiles;
+
+	std::ofstream m_out;
+	// Size of the header of PPM and PFM files
+	std::streamoff m_header_size;
+	std::unique_ptr<Tiled_EXR_Writer> m_exr_writer;
+
+	// Queue shared with the writer thread, protected by m_lock
+	std::mutex m_lock;
+	std::condition_variable m_queue_changed;
+	std::deque<std::unique_ptr<Framebuffer>> m_queue;
+	bool m_finishing;
+	std::exception_ptr m_error;
+	std::thread m_thread;
+
+	void thread_code();
+
+	void write_tile(const Framebuffer& tile);
+	void close();
+};
+
+#endif
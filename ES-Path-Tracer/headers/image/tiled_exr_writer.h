@@ -0,0 +1,67 @@
+#ifndef ES_PATH_TRACER__IMAGE__TILED_EXR_WRITER_H_
+#define ES_PATH_TRACER__IMAGE__TILED_EXR_WRITER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*	Tiled_EXR_Writer objects write a tiled OpenEXR file of linear RGB radiance, with 32-bit float
+	channels and no compression, one tile at a time. The header and a table of tile offsets are 
+	written when the file is opened, tiles are appended in whatever order they are written, and
+	the offset table is filled in when the file is closed; hence only one tile is ever held in 
+	memory. A file that is not closed has no valid offset table */
+class Tiled_EXR_Writer {
+public:
+	/*	Opens the file for an image of width x height pixels, split in square tiles of tile_size
+		pixels, whose top left pixel is at (row_offset, col_offset) of the full image. Throws
+		std::runtime_error if the file cannot be written */
+	Tiled_EXR_Writer(
+		const std::string& filename,
+		int width,
+		int height,
+		int tile_size,
+		int row_offset = 0,
+		int col_offset = 0);
+
+	// Closes the file if it is still open, ignoring errors
+	~Tiled_EXR_Writer();
+
+	Tiled_EXR_Writer(const Tiled_EXR_Writer&) = delete;
+	Tiled_EXR_Writer& operator=(const Tiled_EXR_Writer&) = delete;
+
+	/*	Writes tile (tile_row, tile_col) of the grid of tiles, from rgb, which holds its pixels
+		row by row with three floats each. Tiles on the right and bottom borders are clipped to
+		the image, and so are their rows in rgb. Throws std::invalid_argument for tiles outside the grid or written twice, 
+		and std::runtime_error if the file cannot be written */
+	void write_tile(int tile_row, int tile_col, const float* rgb);
+
+	/*	Writes the offset table and closes the file. Throws std::runtime_error if a tile was not
+		written or the file cannot be written */
+	void close();
+
+	// Acessor functions
+	int width() const { return m_width; }
+	int height() const { return m_height; }
+	int tile_size() const { return m_tile_size; }
+	int tiles_per_row() const { return (m_width + m_tile_size - 1) / m_tile_size; }
+	int tiles_per_column() const { return (m_height + m_tile_size - 1) / m_tile_size; }
+	bool has_tile(int tile_row, int tile_col) const { return m_tile_offsets[tile_row * tiles_per_row() + tile_col] != 0; }
+	// Width and height of a tile, clipped to the image
+	int tile_width(int tile_col) const;
+	int tile_height(int tile_row) const;
+
+private:
+	std::ofstream m_out;
+	int m_width;
+	int m_height;
+	int m_tile_size;
+	// Position of the offset table in the file
+	std::uint64_t m_table_position;
+	// Position in the file of every tile, row by row in the grid, 0 until it is written
+	std::vector<std::uint64_t> m_tile_offsets;
+	// Chunk being written, reused from tile to tile
+	std::vector<unsigned char> m_chunk;
+};
+
+#endif
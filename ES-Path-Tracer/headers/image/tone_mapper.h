@@ -0,0 +1,73 @@
+#ifndef ES_PATH_TRACER__IMAGE__TONE_MAPPER_H_
+#define ES_PATH_TRACER__IMAGE__TONE_MAPPER_H_
+
+#include <vector>
+
+#include "../concurrency/thread_pool.h"
+#include "../shading/color3.h"
+#include "framebuffer.h"
+
+/*	Tone_Mapper objects turn linear radiance into 8-bit display values, as a post-process stage
+	over a rendered framebuffer: the radiance is scaled by the exposure, clamped to [0, 1] and
+	raised to the gamma exponent, then scaled to [0, 255] and truncated.
+
+	The power function is read from a table rather than computed with std::pow. Since it is
+	smooth on a logarithmic scale, the table splits every power of two of [2^-MIN_EXPONENT, 1]
+	in SEGMENTS_PER_OCTAVE segments, indexed straight from the bits of the float, and values
+	are interpolated linearly within a segment; below 2^-MIN_EXPONENT, the smallest normal 
+	float, it is linear down to 0.
+	The error stays far below one display level, so only values right on a level boundary may
+	round to the neighbouring level. The conversion has no branches, so loops over pixels can
+	be vectorized by the compiler.
+
+	The exposure only scales the radiance, and the table is rebuilt whenever the gamma changes,
+	so the same linear framebuffer can be mapped again with other settings without rendering
+	it again */
+class Tone_Mapper {
+public:
+	static const int MIN_EXPONENT = 126;
+	static const int SEGMENT_BITS = 5;
+	static const int SEGMENTS_PER_OCTAVE = 1 << SEGMENT_BITS;
+
+	Tone_Mapper(double exposure = 1.0, double gamma_exponent = 1.0 / 2.2);
+
+	// Acessor functions
+	double exposure() const { return m_exposure; }
+	double gamma_exponent() const { return m_gamma_exponent; }
+
+	void set_exposure(double exposure);
+	void set_gamma_exponent(double gamma_exponent);
+
+	// Display value of a linear radiance, in [0, 255], before truncation
+	float display_value(float radiance) const;
+
+	// Display value of every channel, truncated to an integer, as in 8-bit images
+	Radiance3 quantize(const Radiance3& radiance) const;
+
+	/*	Writes the 8-bit display values of num_pixels pixels, 3 bytes each, given the radiance
+		sums of the pixels (3 floats at the start of every stride floats) and their numbers of
+		samples, as stored in a framebuffer. Pixels without samples are black */
+	void quantize(const float* radiance_sums, const unsigned int* num_samples, int stride,
+		int num_pixels, unsigned char* bytes) const;
+
+	// Writes the 8-bit display values of a row of the framebuffer, 3 bytes per pixel
+	void quantize_row(const Framebuffer& framebuffer, int row, unsigned char* bytes) const;
+
+	/*	Maps the whole framebuffer to 8-bit display values, 3 bytes per pixel from the top row
+		down, splitting the rows among the threads of the pool, if any */
+	void quantize_image(const Framebuffer& framebuffer, std::vector<unsigned char>& bytes,
+		concurrency::Thread_Pool* thread_pool = nullptr) const;
+
+private:
+	double m_exposure;
+	double m_gamma_exponent;
+
+	// Display values at the start of every segment, and at 1 (twice, to interpolate at 1)
+	std::vector<float> m_table;
+	// Display value at 2^-MIN_EXPONENT, divided by it, for the linear part below it
+	float m_low_slope;
+
+	void build_table();
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include <type_traits>
 
 #include "../geometry/ray.h"
+#include "../geometry/ray_packet.h"
 #include "../geometry/plane.h"
 #include "../geometry/triangle.h"
 #include "../geometry/aab.h"
@@ -55,12 +56,18 @@ namespace kd_tree
     public:
         ~KD_Tree() { delete root; }
 
+        // The tree is built within the bounding box, declared before the root to be computed first
         KD_Tree(const std::vector<const Triangle*>& triangles) :
-            root(rec_build_tree(triangles, bounding_box)),
-            bounding_box(compute_aabb(triangles)) {}
+            bounding_box(compute_aabb(triangles)),
+            root(build_tree(triangles)) {}
 
         const Triangle* intersect(Ray ray) const;
 
+        /*  Packet version of intersect. Rays in the packet are traversed together while they 
+            agree on the order of visited children; the triangle hit by each ray in mask is 
+            stored in triangles, or nullptr if there is none */
+        void intersect(Ray_Packet packet, int mask, const Triangle* triangles[Ray_Packet::SIZE]) const;
+
         const AAB& aabb() const { return bounding_box; }
 
     private:
@@ -73,6 +80,8 @@ namespace kd_tree
 
         enum SIDE { LEFT, RIGHT };
 
+        // Builds the tree of the triangles in the bounding box, timing the build
+        KD_Node* build_tree(const std::vector<const Triangle*>& triangles);
         KD_Node* rec_build_tree(const std::vector<const Triangle*>& triangles, AAB region);
  
         void KD_Tree::find_plane(const std::vector<const Triangle*>& triangles, AAB region,
@@ -0,0 +1,41 @@
+#ifndef ES_PATH_TRACER__PATH_TRACER__CHECKPOINT_H_
+#define ES_PATH_TRACER__PATH_TRACER__CHECKPOINT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../image/framebuffer.h"
+
+/*	Checkpoint objects hold the state of a progressive render between two passes, from which it 
+	can be resumed: the framebuffer with all its accumulators, the pixels that adaptive sampling
+	no longer samples, the index of the next pass and the render time spent so far. When the
+	time budget interrupted the next pass, its first next_tile tiles, in the order of the tile
+	scheduler, have already been rendered, and the resumed render starts after them. Pass p draws
+	the samples of every pixel from sample p * samples_per_estimate of a sequence keyed by the 
+	seed and the pixel index, so the seed and the pass index fix the position of every random 
+	number stream.
+
+	Checkpoints are written to a temporary file that then replaces the previous one, hence a
+	render killed while writing leaves the last complete checkpoint behind */
+class Checkpoint {
+public:
+	std::uint64_t seed;
+	int samples_per_estimate;
+	int next_pass;
+	int next_tile;
+	double elapsed_seconds;
+	Framebuffer framebuffer;
+	// Pixels (row-major) that are no longer sampled
+	std::vector<unsigned char> converged;
+
+	Checkpoint() : seed(0), samples_per_estimate(0), next_pass(0), next_tile(0), elapsed_seconds(0.0) {}
+
+	// Returns the size of the file, in bytes. Throws std::runtime_error if it cannot be written
+	long long save(const std::string& filename) const;
+
+	// Throws std::runtime_error if the file cannot be read or does not hold a checkpoint
+	void load(const std::string& filename);
+};
+
+#endif
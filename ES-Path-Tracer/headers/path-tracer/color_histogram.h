@@ -35,6 +35,4 @@ private:
 	Color3 from_hash_key(int key) const;
 };
 
-#include "evolution_strategy_path_tracer.h"
-
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ES_PATH_TRACER__PATH_TRACER__EVOLUTION_STRATEGY_PATH_TRACER_H_
 #define ES_PATH_TRACER__PATH_TRACER__EVOLUTION_STRATEGY_PATH_TRACER_H_
 
+#include "../evolution-strategy/color_histogram_fitness.h"
 #include "../geometry/ray.h"
 #include "../scene/scene.h"
 #include "camera.h"
@@ -11,6 +12,16 @@
 
 class Evolution_Strategy_Path_Tracer : public Path_Tracer {
 public:
+	typedef es::Color_Histogram_Fitness::Radiance_Coefficient Radiance_Coefficient;
+	typedef es::Color_Histogram_Fitness::Frequency_Coefficient Frequency_Coefficient;
+
+	/*	Estimates of a pixel from its evolution: the weighted mean of the colors gathered in its
+		histogram, the mean radiance of the final population, or the weighted mean of the 
+		colors of the histogram that rank highest by the ranking coefficients */
+	enum Heuristic { HISTOGRAM_MEAN_HEURISTIC, POPULATION_MEAN_HEURISTIC, RANKED_COLORS_HEURISTIC };
+
+	static const int DEFAULT_HISTOGRAM_RADIUS = 4;
+
 	Evolution_Strategy_Path_Tracer(
 		const Camera* camera,
 		const scene::Scene* scene,
@@ -27,22 +38,43 @@ public:
 	int max_iterations_per_pixel() const { return m_max_iterations_per_pixel; }
 	double children_population_ratio() const { return m_children_population_ratio; }
 	int population_size() const { return m_population_size; }
+	Heuristic heuristic() const { return m_heuristic; }
+	int histogram_radius() const { return m_histogram_radius; }
+	Radiance_Coefficient fitness_radiance_coefficient() const { return m_fitness_radiance_coefficient; }
+	Frequency_Coefficient fitness_frequency_coefficient() const { return m_fitness_frequency_coefficient; }
+	Radiance_Coefficient ranking_radiance_coefficient() const { return m_ranking_radiance_coefficient; }
+	Frequency_Coefficient ranking_frequency_coefficient() const { return m_ranking_frequency_coefficient; }
 
 	void set_max_iterations_per_pixel(int max_iterations);
 	void set_children_population_ratio(double children_population_ratio);
 	void set_population_size(int population_size);
+	void set_heuristic(Heuristic heuristic) { m_heuristic = heuristic; }
+	// Radius of the neighbourhood of a color whose frequency the fitness function measures
+	void set_histogram_radius(int radius);
+	// Coefficients of the fitness of individuals
+	void set_fitness_coefficients(Radiance_Coefficient radiance, Frequency_Coefficient frequency);
+	// Coefficients by which the colors of the histogram are ranked by RANKED_COLORS_HEURISTIC
+	void set_ranking_coefficients(Radiance_Coefficient radiance, Frequency_Coefficient frequency);
 
 private:
 	int m_max_iterations_per_pixel;
 	double m_children_population_ratio;
 	int m_population_size;
+	Heuristic m_heuristic;
+	int m_histogram_radius;
+	Radiance_Coefficient m_fitness_radiance_coefficient;
+	Frequency_Coefficient m_fitness_frequency_coefficient;
+	Radiance_Coefficient m_ranking_radiance_coefficient;
+	Frequency_Coefficient m_ranking_frequency_coefficient;
+
+	virtual Radiance3 estimate_pixel_color(const Ray& ray, const Eye_Ray_Hit& eye_ray_hit,
+		int pixel_index, int first_sample) const;
 
-	virtual Radiance3 estimate_pixel_color(const Ray& ray) const;
+	// Every estimate is made from the paths of one population
+	virtual int samples_per_estimate() const { return m_population_size; }
 
-	static bool color_compare_predicate(
-		int color0,
-		int color1,
-		const Color_Histogram& color_histogram);
+	// Ranking coefficient of a color of the histogram
+	double ranking_coefficient(int color, const Color_Histogram& color_histogram) const;
 };
 
 #endif
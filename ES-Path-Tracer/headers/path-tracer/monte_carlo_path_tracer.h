@@ -1,7 +1,10 @@
 #ifndef ES_PATH_TRACER__PATH_TRACER__MONTE_CARLO_PATH_TRACER_H_
 #define ES_PATH_TRACER__PATH_TRACER__MONTE_CARLO_PATH_TRACER_H_
 
+#include <memory>
+
 #include "../geometry/ray.h"
+#include "../random/random_sequence.h"
 #include "../scene/scene.h"
 #include "camera.h"
 #include "path_tracer.h"
@@ -10,6 +13,10 @@
 
 class Monte_Carlo_Path_Tracer : public Path_Tracer {
 public:
+	/*	Random sequences the samples of a pixel are drawn from: independent uniform numbers, 
+		or the low-discrepancy Owen-scrambled Sobol and Halton sequences */
+	enum Sampler { UNIFORM_SAMPLER, SOBOL_SAMPLER, HALTON_SAMPLER };
+
 	Monte_Carlo_Path_Tracer(
 		const Camera* camera,
 		const scene::Scene* scene,
@@ -24,10 +31,30 @@ public:
 	int samples_per_pixel() const { return m_samples_per_pixel; }
 	void set_samples_per_pixel(int samples_per_pixel);
 
+	/*	When enabled, the samples of the pixels of a tile are traced together one bounce at a 
+		time, with their secondary rays sorted into coherent order before being traced */
+	bool sort_secondary_rays() const { return m_sort_secondary_rays; }
+	void set_sort_secondary_rays(bool sort_secondary_rays) { m_sort_secondary_rays = sort_secondary_rays; }
+
+	Sampler sampler() const { return m_sampler; }
+	void set_sampler(Sampler sampler) { m_sampler = sampler; }
+
+protected:
+	// Sequence of the pixel with the given index, decorrelated from those of other pixels
+	std::unique_ptr<random::Random_Sequence> create_random_sequence(int pixel_index) const;
+
 private:
 	int m_samples_per_pixel;
+	bool m_sort_secondary_rays;
+	Sampler m_sampler;
+
+	Radiance3 estimate_pixel_color(const Ray& ray, const Eye_Ray_Hit& eye_ray_hit,
+		int pixel_index, int first_sample) const;
+
+	// With sorted secondary rays, traces the paths of the pixels of the tile in batches
+	void render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const;
 
-	Radiance3 estimate_pixel_color(const Ray& ray) const;
+	int samples_per_estimate() const { return m_samples_per_pixel; }
 };
 
 #endif
\ No newline at end of file
@@ -1,18 +1,30 @@
 #ifndef ES_PATH_TRACER__PATH_TRACER__PATH_TRACER_H_
 #define ES_PATH_TRACER__PATH_TRACER__PATH_TRACER_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "../concurrency/thread_pool.h"
 #include "../geometry/ray.h"
 #include "../geometry/vector3.h"
+#include "../image/framebuffer.h"
+#include "../image/tone_mapper.h"
 #include "../path-tracer/camera.h"
+#include "../path-tracer/checkpoint.h"
+#include "../path-tracer/tile_scheduler.h"
 #include "../random/random_sequence.h"
 #include "../scene/area_light.h"
 #include "../scene/scene.h"
 #include "../shading/color3.h"
 #include "../shading/surface_element.h"
+#include "../stats/render_stats.h"
 
 class Path_Tracer {
 public:
@@ -20,6 +32,33 @@ public:
 	static const bool m_emit = true;
 	static const bool m_direct = true;
 
+	static const int DEFAULT_MAX_BOUNCES = 32;
+	static const int DEFAULT_ROULETTE_MIN_BOUNCES = 3;
+	static const double DEFAULT_ROULETTE_THRESHOLD;
+	static const int DEFAULT_TILE_SIZE = 16;
+	static const int DEFAULT_MAX_PASSES = 1;
+	static const int DEFAULT_ADAPTIVE_MIN_PASSES = 4;
+	static const int DEFAULT_CHECKPOINT_INTERVAL = 600;
+
+	// Function called with the framebuffer after every rendering pass, and the number of passes
+	typedef std::function<void(const Framebuffer& framebuffer, int num_passes)> pass_callback;
+	// Function given every tile finished by stream_image, which it takes over
+	typedef std::function<void(std::unique_ptr<Framebuffer> tile)> tile_callback;
+
+	/*	Strategies for choosing the light triangle sampled by direct lighting: proportionally to 
+		its area, or by its importance to the shading point through the scene's light hierarchy */
+	enum Light_Selection { AREA_WEIGHTED, LIGHT_HIERARCHY };
+
+	/*	Closest intersection of a pixel's eye ray. Eye rays are traced once per pixel and pass,
+		in packets, and the hit is shared by every sample of the pixel. Pixels whose eye ray 
+		misses the scene are not estimated at all */
+	struct Eye_Ray_Hit {
+		bool found;
+		scene::Surface_Element surfel;
+
+		Eye_Ray_Hit() : found(false) {}
+	};
+
 	Path_Tracer(
 		const Camera* camera,
 		const scene::Scene* scene,
@@ -32,26 +71,82 @@ public:
 
 	Path_Tracer(const Path_Tracer& other);
 
-	void compute_image(std::vector<std::vector<Radiance3>>& image);
+	/*	Renders the image into framebuffer, which is resized to the resolution of the image. The
+		image is rendered progressively, in passes that add samples_per_estimate samples to every 
+		pixel, until max_passes passes are done or the time budget is spent. The first pass is
+		always completed; a pass interrupted by the deadline leaves its remaining tiles with one
+		pass less, which the framebuffer's sample counts account for.
+		
+		With adaptive sampling, pixels whose mean luminance is known within the adaptive 
+		threshold (relative half width of its 95% confidence interval) after adaptive_min_passes
+		passes are not sampled by the next passes, which leaves their time to the noisy ones */
+	void compute_image(Framebuffer& framebuffer);
+
+	/*	Resumes the render saved in a checkpoint file, going on into framebuffer with the passes 
+		that were left, starting with the tiles that the time budget left out of the last pass. 
+		The path tracer must be set up as for the interrupted render, except for the seed, which
+		is taken from the checkpoint; every tile then gets the same passes as in an uninterrupted
+		render. Throws std::runtime_error if the checkpoint cannot be read and 
+		std::invalid_argument if it belongs to another image window or sampling rate */
+	void resume_image(Framebuffer& framebuffer, const std::string& checkpoint_filename);
+
+	/*	Renders the image tile by tile, instead of pass by pass: every tile goes through all its
+		passes in a framebuffer of its own, at the tile's offsets, which is handed to output as 
+		soon as it is done. output is called from the render threads, possibly at the same time.
+		Only the tiles being rendered are held in memory, and they get the same samples as in
+		compute_image, so together they make up the same image. The time budget, checkpoints 
+		and the pass callback do not apply */
+	void stream_image(const tile_callback& output);
 
 	Radiance3 path_trace(
 		const Ray& ray,
 		random::Random_Sequence& random_seq,
 		bool is_eye_ray,
 		double refractive_index = 1.0) const;
+
+	// Path tracing of an eye ray whose first intersection is already known
+	Radiance3 path_trace(
+		const Ray& eye_ray,
+		const Eye_Ray_Hit& eye_ray_hit,
+		random::Random_Sequence& random_seq) const;
 	
-	Radiance3 gamma_correction(Radiance3 radiance) const;
-	double gamma_correction(double radiance) const;
+	/*	Display value of the radiance in [0, 255], truncated to an integer, from the tone mapper.
+		Images are mapped from the linear framebuffer by the tone mapper itself */
+	Radiance3 gamma_correction(Radiance3 radiance) const { return m_tone_mapper.quantize(radiance); }
+	double gamma_correction(double radiance) const { return (int) m_tone_mapper.display_value((float) radiance); }
+
+	// Linear radiance whose gamma correction is the given display value in [0, 255]
+	Radiance3 inverse_gamma_correction(Radiance3 display_value) const;
+	double inverse_gamma_correction(double display_value) const;
 	
 	// Acessor functions
 	const Camera* camera() const { return m_camera; }
 	const scene::Scene* scene() const { return m_scene; }
 	double window_width() const { return m_window_width; }
 	int resolution_width() const { return m_resolution_width; }
+	int resolution_height() const;
 	double aspect_ratio() const { return m_aspect_ratio; }
-	double gamma_coefficient() const { return m_gamma_coefficient; }
-	double gamma_exponent() const { return m_gamma_exponent; }
+	double gamma_coefficient() const { return m_tone_mapper.exposure(); }
+	double gamma_exponent() const { return m_tone_mapper.gamma_exponent(); }
+	const Tone_Mapper& tone_mapper() const { return m_tone_mapper; }
 	int num_threads() const { return m_num_threads; }
+	concurrency::Thread_Pool* thread_pool() const { return m_thread_pool; }
+	int tile_size() const { return m_tile_size; }
+	int max_passes() const { return m_max_passes; }
+	int first_pass() const { return m_first_pass; }
+	double time_budget() const { return m_time_budget; }
+	double adaptive_threshold() const { return m_adaptive_threshold; }
+	int adaptive_min_passes() const { return m_adaptive_min_passes; }
+	bool has_crop_window() const { return m_has_crop_window; }
+	const Tile_Scheduler::Tile& crop_window() const { return m_crop_window; }
+	const std::vector<int>& tiles() const { return m_tiles; }
+	const std::string& checkpoint_filename() const { return m_checkpoint_filename; }
+	double checkpoint_interval() const { return m_checkpoint_interval; }
+	int max_bounces() const { return m_max_bounces; }
+	std::uint64_t seed() const { return m_seed; }
+	int roulette_min_bounces() const { return m_roulette_min_bounces; }
+	double roulette_threshold() const { return m_roulette_threshold; }
+	Light_Selection light_selection() const { return m_light_selection; }
 	
 	// Setters
 	void set_camera(const Camera* camera);
@@ -62,6 +157,200 @@ public:
 	void set_gamma_coefficient(double gamma_coefficient);
 	void set_gamma_exponent(double exponent);
 	void set_num_threads(int num_threads);
+	/*	Renders with the threads of a pool shared with other jobs. Without one (nullptr), the 
+		path tracer starts a pool of num_threads threads the first time an image is computed 
+		and keeps it for the next ones */
+	void set_thread_pool(concurrency::Thread_Pool* thread_pool) { m_thread_pool = thread_pool; }
+	void set_tile_size(int tile_size);
+	/*	Renders only rows [row_begin, row_end) and columns [col_begin, col_end) of the image. 
+		The framebuffer then holds that window, at its offsets, and its pixels get the same 
+		eye rays and random numbers as in a full-frame render, so windows rendered separately 
+		merge seamlessly */
+	void set_crop_window(int row_begin, int row_end, int col_begin, int col_end);
+	void reset_crop_window() { m_has_crop_window = false; }
+	/*	Renders only the listed tiles of the crop window (or of the image, without one), 
+		numbered row by row in its grid of tile_size tiles. The framebuffer holds the smallest
+		window that contains them. An empty list renders every tile */
+	void set_tiles(const std::vector<int>& tiles) { m_tiles = tiles; }
+	void set_max_passes(int max_passes);
+	/*	Index of the first pass rendered by compute_image; passes go on up to max_passes. Renders
+		of disjoint ranges of passes draw different samples, and merging their framebuffers 
+		gives the render of all their passes */
+	void set_first_pass(int first_pass);
+	// Wall-clock time, in seconds, after which no more passes are started. 0 disables it
+	void set_time_budget(double seconds);
+	// Relative error at which pixels stop being sampled. 0 disables adaptive sampling
+	void set_adaptive_threshold(double threshold);
+	void set_adaptive_min_passes(int min_passes);
+	// Used to export intermediate images. It runs while the render threads are idle
+	void set_pass_callback(const pass_callback& callback) { m_pass_callback = callback; }
+	/*	Saves a checkpoint of the render to this file after a pass, once every checkpoint 
+		interval, and after the last pass. An empty name disables checkpoints */
+	void set_checkpoint_filename(const std::string& filename) { m_checkpoint_filename = filename; }
+	/*	Minimum wall-clock time, in seconds, between two checkpoints. It is stretched when 
+		needed so that writing checkpoints takes at most a small fraction of the render time */
+	void set_checkpoint_interval(double seconds);
+	void set_max_bounces(int max_bounces);
+	void set_seed(std::uint64_t seed) { m_seed = seed; }
+	void set_roulette_min_bounces(int min_bounces);
+	void set_roulette_threshold(double threshold);
+	void set_light_selection(Light_Selection light_selection) { m_light_selection = light_selection; }
+
+protected:
+	/*	State of a path that is extended one vertex at a time. The radiance gathered so far is
+		already weighted by the throughput of the vertices before the current one */
+	struct Path_State {
+		Ray ray;
+		Color3 throughput;
+		Radiance3 radiance;
+		double refractive_index;
+		bool is_eye_ray;
+		int bounces;
+		// Sample of the random sequence the path draws from
+		std::uint64_t sample;
+		/*	Data of the last scattering, used to weight emitters hit by the path's ray against
+			the direct lighting estimate of the previous vertex. scatter_pdf is 0 after a delta
+			scattering, and emission_throughput is the throughput that light emitted towards 
+			the previous vertex gets when it is estimated by scattering. shading_position is 
+			the previous vertex itself, where its light sample was taken, rather than the 
+			bumped origin of the ray */
+		double scatter_pdf;
+		Color3 emission_throughput;
+		bool direct_light_sampled;
+		Point3 shading_position;
+
+		Path_State(const Ray& eye_ray) : ray(eye_ray), throughput(1.0), radiance(0.0),
+			refractive_index(1.0), is_eye_ray(true), bounces(0), sample(0), scatter_pdf(0.0),
+			emission_throughput(0.0), direct_light_sampled(false), shading_position(0.0) {}
+	};
+
+	/*	Direct lighting sample of a vertex, before the visibility of the light point is known.
+		weight holds the BSDF and the cosine at the vertex, divided by the density of the light
+		point, and scattered_weight its Lambertian part, the only one also estimated by 
+		scattering and hence weighted against it. If the shadow ray hits another emitter first,
+		that emitter is connected instead of the sampled point */
+	struct Light_Connection {
+		Ray shadow_ray;
+		double distance;
+		Point3 shading_position;
+		Color3 weight;
+		Color3 scattered_weight;
+		// Density with which scattering from the vertex would have chosen the shadow ray
+		double scatter_pdf;
+		Radiance3 power;
+		Point3 light_position;
+		Vector3 light_normal;
+		const Triangle* light_triangle;
+
+		Light_Connection() : shadow_ray(Point3(0.0), Vector3(0.0, 0.0, 1.0)), distance(0.0),
+			shading_position(0.0), weight(0.0), scattered_weight(0.0), scatter_pdf(0.0), power(0.0),
+			light_position(0.0), light_normal(0.0), light_triangle(nullptr) {}
+	};
+
+	/*	Shades the vertex where the path's ray hits surfel and scatters the path into its next
+		ray. Returns false when the path is terminated at this vertex, either because the ray 
+		was absorbed, because the path reached the maximum number of bounces or by Russian 
+		roulette */
+	bool extend_path(
+		Path_State& path,
+		const scene::Surface_Element& surfel,
+		random::Random_Sequence& random_seq) const;
+
+	/*	The stages of extend_path, for integrators that trace the shadow rays of many vertices
+		together. A vertex is shaded by calling, in this order: begin_vertex, which adds the 
+		light emitted towards the path and tells whether direct lighting is sampled; 
+		sample_light_connection, if so; and scatter_path. Once the shadow ray of a connection 
+		has been traced, connect_light gives its radiance, to be weighted by the throughput the 
+		path had at the vertex */
+	bool begin_vertex(
+		Path_State& path,
+		const scene::Surface_Element& surfel,
+		random::Random_Sequence& random_seq) const;
+
+	void sample_light_connection(
+		const Path_State& path,
+		const scene::Surface_Element& surfel,
+		random::Random_Sequence& random_seq,
+		Light_Connection& connection) const;
+
+	bool scatter_path(
+		Path_State& path,
+		const scene::Surface_Element& surfel,
+		bool direct_light_sampled,
+		random::Random_Sequence& random_seq) const;
+
+	/*	Radiance of a light connection whose shadow ray found the given hit (occluded tells 
+		whether there was one) before reaching the light point */
+	Radiance3 connect_light(
+		const Light_Connection& connection,
+		bool occluded,
+		const scene::Surface_Element& shadow_ray_surfel) const;
+
+	/*	Traces num_paths paths from the eye ray of each of num_pixels pixels, all together, one 
+		bounce at a time. The paths of a pixel take the num_paths samples of its sequence that 
+		start at first_sample. At every bounce the rays of the live paths of every pixel are 
+		sorted by origin cell and direction octant and traced in that order, in packets. Adds 
+		the sum of the radiance of the paths of each pixel to radiance_sums */
+	void trace_sorted_paths(
+		const Ray* eye_rays,
+		const Eye_Ray_Hit* eye_ray_hits,
+		random::Random_Sequence* const* random_seqs,
+		int num_pixels,
+		int num_paths,
+		std::uint64_t first_sample,
+		Radiance3* radiance_sums) const;
+
+	// State of a rendering pass shared by the render threads
+	struct Pass {
+		Framebuffer* framebuffer;
+		Tile_Scheduler* scheduler;
+		// Index of the first sample of every pixel in this pass
+		int first_sample;
+		/*	Pixels of the framebuffer (row-major) that are no longer sampled, or nullptr without 
+			adaptive sampling */
+		const std::vector<unsigned char>* converged;
+		// Whether the pass stops handing out tiles once the deadline is reached
+		bool has_deadline;
+		std::chrono::steady_clock::time_point deadline;
+		// Progress over all passes
+		std::atomic<long long>* completed_pixels;
+		long long total_pixels;
+		double elapsed_ratio;
+
+		// Whether the pixel, in image coordinates, is no longer sampled
+		bool pixel_converged(int row, int col) const
+		{
+			return converged && (*converged)[(row - framebuffer->row_offset()) * framebuffer->width()
+				+ (col - framebuffer->col_offset())];
+		}
+
+		// Adds an estimate to the pixel, in image coordinates
+		void add_estimate(int row, int col, const Radiance3& mean_radiance, int num_samples) const
+		{
+			STATS_ADD(stats::SAMPLES, num_samples);
+			framebuffer->add_estimate(row - framebuffer->row_offset(), col - framebuffer->col_offset(),
+				mean_radiance, num_samples);
+		}
+	};
+
+	/*	Renders the pixels of tile that are not converged, adding one estimate of 
+		samples_per_estimate samples to each. By default, eye rays are traced in packets and 
+		every pixel is estimated by estimate_pixel_color. Only the thread rendering the tile 
+		writes its pixels */
+	virtual void render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const;
+
+	/*	Traces the eye rays of the pixels of tile that are not converged, in packets of 
+		neighbouring pixels, and lists those pixels (row and column) with their eye rays and 
+		hits, in the same order */
+	void trace_eye_rays(
+		const Tile_Scheduler::Tile& tile,
+		const Pass* pass,
+		std::vector<std::pair<int, int>>& pixels,
+		std::vector<Ray>& eye_rays,
+		std::vector<Eye_Ray_Hit>& eye_ray_hits) const;
+
+	// Ray from the camera through the center of the pixel
+	Ray eye_ray(int row, int col) const;
 
 private:
 	// Image-related members
@@ -70,32 +359,105 @@ private:
 	double m_window_width;
 	double m_aspect_ratio;
 	int m_resolution_width;
-	double m_gamma_coefficient;
-	double m_gamma_exponent;
+	// Exposure (the gamma coefficient) and gamma exponent
+	Tone_Mapper m_tone_mapper;
+	// Integrator-related members
+	int m_max_bounces;
+	int m_roulette_min_bounces;
+	double m_roulette_threshold;
+	std::uint64_t m_seed;
+	Light_Selection m_light_selection;
+	// Progressive rendering-related members
+	int m_max_passes;
+	int m_first_pass;
+	double m_time_budget;
+	pass_callback m_pass_callback;
+	double m_adaptive_threshold;
+	int m_adaptive_min_passes;
+	std::string m_checkpoint_filename;
+	double m_checkpoint_interval;
 	// Concurrency-related members
-	std::mutex m_pixel_lock;
-	std::mutex m_image_lock;
-	int m_current_row;
-	int m_current_col;
+	std::mutex m_progress_lock;
 	int m_num_threads;
+	int m_tile_size;
+	concurrency::Thread_Pool* m_thread_pool;
+	std::unique_ptr<concurrency::Thread_Pool> m_own_thread_pool;
+	// Region-related members
+	bool m_has_crop_window;
+	Tile_Scheduler::Tile m_crop_window;
+	std::vector<int> m_tiles;
+
+	void trace_path(Path_State& path, random::Random_Sequence& random_seq) const;
 
 	Radiance3 estimate_direct_light_from_area_lights(
 		random::Random_Sequence& random_seq,
 		const scene::Surface_Element& surfel,
-		const Vector3& w_o,
-		double current_refractive_index) const;
+		const Path_State& path) const;
 
-	Radiance3 estimate_indirect_light(
+	/*	Whether the path may be scattered from its current vertex, i.e. it is not terminated
+		there by the bounce limit or because indirect light is off */
+	bool can_scatter(const Path_State& path) const;
+
+	/*	Solid angle density with which direct lighting samples a point of a light triangle seen 
+		from position, 0 if the triangle does not belong to a light */
+	double light_sampling_pdf(
+		const Point3& position,
+		const Triangle* light_triangle,
+		const Point3& light_position,
+		const Vector3& light_normal) const;
+
+	bool survives_roulette(Path_State& path, random::Random_Sequence& random_seq) const;
+
+	bool scatter_ray(
 		random::Random_Sequence& random_seq,
 		const scene::Surface_Element& surfel,
 		const Vector3& w_o,
-		bool is_eye_ray) const;
+		Ray& outgoing_ray,
+		Color3& coefficient,
+		double& outgoing_refractive_index,
+		bool& delta) const;
+
+	const scene::Area_Light& pick_random_light(double u) const;
+
+	/*	Chooses the light triangle to sample from position, with the given selection strategy. 
+		It always takes two numbers of the sequence, to keep the same dimensions in use */
+	const Triangle& pick_light_triangle(
+		random::Random_Sequence& random_seq,
+		const Point3& position,
+		const scene::Area_Light*& light,
+		double& probability) const;
+
+	double light_triangle_probability(const Point3& position, const Triangle& triangle) const;
+
+	/*	Renders tiles taken from the pass' scheduler until none is left. Each thread writes only 
+		the pixels of its own tiles */
+	void thread_code(Pass* pass);
+
+	// Counts the pixels of a finished tile in the progress of the pass, and prints it
+	void report_progress(Pass* pass, long long num_pixels);
+
+	/*	Marks the pixels of a row of the framebuffer whose estimate is within the adaptive 
+		threshold as converged, and returns the number of pixels of the row left to sample */
+	int update_converged(const Framebuffer& framebuffer, std::vector<unsigned char>& converged, int row) const;
+
+	/*	Renders passes from first_pass on, for the tiles of scheduler, into framebuffer, which 
+		already holds the earlier ones, as does converged the pixels they left converged. The
+		first first_tile tiles of first_pass, in the order of the scheduler, are also already
+		rendered. elapsed_seconds is the render time spent on the earlier passes */
+	void render_passes(Framebuffer& framebuffer, Tile_Scheduler& scheduler,
+		std::vector<unsigned char>& converged, int first_pass, int first_tile, double elapsed_seconds);
 
-	const scene::Area_Light& pick_random_light() const;
+	// Image window split into tiles, from the crop window, if any
+	Tile_Scheduler::Tile render_window() const;
 
-	void thread_code(std::vector<std::vector<Radiance3>>* image);
+	/*	Estimates the linear radiance of the pixel with the given eye ray, from samples_per_estimate
+		samples starting at first_sample. The pixel index (row-major) and the sample indices 
+		identify the random number streams */
+	virtual Radiance3 estimate_pixel_color(const Ray& ray, const Eye_Ray_Hit& eye_ray_hit,
+		int pixel_index, int first_sample) const = 0;
 
-	virtual Radiance3 estimate_pixel_color(const Ray& ray) const = 0;
+	// Number of samples an estimate of estimate_pixel_color counts for in the framebuffer
+	virtual int samples_per_estimate() const = 0;
 
 	std::string Path_Tracer::build_progress_bar(double progress) const;
 };
@@ -0,0 +1,68 @@
+#ifndef ES_PATH_TRACER__PATH_TRACER__TILE_SCHEDULER_H_
+#define ES_PATH_TRACER__PATH_TRACER__TILE_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/*	Tile_Scheduler objects split an image into square tiles and hand them out to the render 
+	threads through an atomic counter, so that no lock is taken to get work. Tiles are visited
+	in Morton order of their grid position, so tiles rendered at the same time are close to 
+	each other in the image. Every pixel belongs to exactly one tile, hence threads can write
+	the pixels of their tiles without synchronization */
+class Tile_Scheduler {
+public:
+	// Rows [row_begin, row_end) and columns [col_begin, col_end) of the image
+	struct Tile {
+		int row_begin;
+		int row_end;
+		int col_begin;
+		int col_end;
+
+		int num_pixels() const { return (row_end - row_begin) * (col_end - col_begin); }
+	};
+
+	Tile_Scheduler(int width, int height, int tile_size);
+
+	/*	Schedules only the pixels of window, split into tiles from its top left corner. Tiles 
+		keep their image coordinates. When tiles is not empty, only the listed tiles, numbered 
+		row by row in the window's grid, are handed out */
+	Tile_Scheduler(const Tile& window, int tile_size, const std::vector<int>& tiles = std::vector<int>());
+
+	// Takes the next tile to render. Returns false when all tiles have been handed out
+	bool next(Tile& tile);
+
+	// Hands out every tile again, from the given one in the order of next
+	void reset(int first_tile = 0) { m_next_tile = first_tile; }
+
+	// Number of tiles handed out since the last reset, including those it skipped
+	int num_handed_out() const { return std::min((int) m_next_tile.load(), num_tiles()); }
+
+	// Acessor functions
+	int num_tiles() const { return (int) m_tiles.size(); }
+	long long num_pixels() const;
+	int width() const { return m_window.col_end - m_window.col_begin; }
+	int height() const { return m_window.row_end - m_window.row_begin; }
+	const Tile& window() const { return m_window; }
+	// Smallest rectangle that contains every scheduled tile
+	Tile bounds() const;
+	int tile_size() const { return m_tile_size; }
+
+	// Number of tiles in a row and a column of the window's grid
+	int tiles_per_row() const { return (width() + m_tile_size - 1) / m_tile_size; }
+	int tiles_per_column() const { return (height() + m_tile_size - 1) / m_tile_size; }
+
+private:
+	Tile m_window;
+	int m_tile_size;
+	std::vector<Tile> m_tiles;
+	std::atomic<int> m_next_tile;
+
+	void schedule(const std::vector<int>& tiles);
+
+	static Tile image_window(int width, int height);
+
+	static unsigned int morton_code(unsigned int x, unsigned int y);
+};
+
+#endif
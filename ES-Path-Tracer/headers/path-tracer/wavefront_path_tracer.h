@@ -0,0 +1,104 @@
+#ifndef ES_PATH_TRACER__PATH_TRACER__WAVEFRONT_PATH_TRACER_H_
+#define ES_PATH_TRACER__PATH_TRACER__WAVEFRONT_PATH_TRACER_H_
+
+#include <memory>
+#include <vector>
+
+#include "../geometry/ray.h"
+#include "../geometry/ray_stream.h"
+#include "../random/random_sequence.h"
+#include "../scene/scene.h"
+#include "../shading/color3.h"
+#include "../shading/surface_element.h"
+#include "camera.h"
+#include "monte_carlo_path_tracer.h"
+#include "tile_scheduler.h"
+
+/*	Wavefront_Path_Tracer objects compute the same estimate as Monte_Carlo_Path_Tracer, but
+	instead of following each path to its end they advance every path of a tile together, one
+	vertex at a time, through separate stages:
+		- generate: trace the eye rays of the tile's pixels and start samples_per_pixel paths
+		  at each hit;
+		- shade: shade the vertices of the hit queue, grouped by material class, queueing
+		  their shadow rays and their scattered rays;
+		- connect: trace the queued shadow rays and add the light they reach;
+		- extend: find the closest hits of the queued scattered rays.
+	Each stage is a loop over one queue, and rays are sorted into coherent order and traced in
+	packets. At most wavefront_size paths are in flight, which bounds the memory of the queues */
+class Wavefront_Path_Tracer : public Monte_Carlo_Path_Tracer {
+public:
+	static const int DEFAULT_WAVEFRONT_SIZE = 1 << 14;
+
+	Wavefront_Path_Tracer(
+		const Camera* camera,
+		const scene::Scene* scene,
+		double window_width,
+		double aspect_ratio,
+		int resolution_width,
+		int samples_per_pixel,
+		double gamma_coefficient = 7,
+		double gamma_exponent = 1.0 / 2.2,
+		int num_threads = 4);
+
+	int wavefront_size() const { return m_wavefront_size; }
+	void set_wavefront_size(int wavefront_size);
+
+private:
+	// Paths in flight, with the tile pixel each one belongs to
+	struct Wavefront {
+		std::vector<Path_State> paths;
+		std::vector<int> pixels;
+		// Random sequence of every pixel of the tile
+		std::vector<std::unique_ptr<random::Random_Sequence>> random_seqs;
+	};
+
+	// Vertices waiting to be shaded, as parallel arrays indexed by queue position
+	struct Hit_Queue {
+		std::vector<int> paths;
+		std::vector<scene::Surface_Element> surfels;
+
+		void push(int path, const scene::Surface_Element& surfel)
+		{
+			paths.push_back(path);
+			surfels.push_back(surfel);
+		}
+		void clear() { paths.clear(); surfels.clear(); }
+		size_t size() const { return paths.size(); }
+		bool empty() const { return paths.empty(); }
+	};
+
+	// Shadow rays waiting to be traced, as parallel arrays indexed by queue position
+	struct Shadow_Queue {
+		std::vector<int> paths;
+		std::vector<Light_Connection> connections;
+
+		void push(int path, const Light_Connection& connection)
+		{
+			paths.push_back(path);
+			connections.push_back(connection);
+		}
+		void clear() { paths.clear(); connections.clear(); }
+		size_t size() const { return paths.size(); }
+	};
+
+	int m_wavefront_size;
+
+	void render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const;
+
+	/*	Closest hits of the rays of the stream, traced in packets in the stream's order. Rays
+		that leave the scene end their paths */
+	void extend(const Wavefront& wavefront, const Ray_Stream& rays, Hit_Queue& hits) const;
+
+	/*	Shades the vertices of hits, which is left empty, queueing the next ray of every path
+		that goes on in rays and its direct lighting sample in shadow_rays */
+	void shade(Wavefront& wavefront, Hit_Queue& hits, Ray_Stream& rays, Shadow_Queue& shadow_rays) const;
+
+	// Traces the queued shadow rays, which is left empty, and adds their light to the paths
+	void connect(Wavefront& wavefront, Shadow_Queue& shadow_rays) const;
+
+	/*	Index of the group in which a material is shaded, by the lobes it has, so that
+		consecutive vertices run through the same branches of the shading code */
+	static int material_class(const scene::Surface_Element::Material_Data& material);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ES_PATH_TRACER__RANDOM__ALIAS_TABLE_H_
+#define ES_PATH_TRACER__RANDOM__ALIAS_TABLE_H_
+
+#include <vector>
+
+namespace random
+{
+	/*	Alias table (Vose's method) for sampling a discrete distribution in constant time. 
+		Built once in O(n) from non-negative weights, which need not be normalized; each sample 
+		then costs one uniform number, a multiplication and a comparison */
+	class Alias_Table {
+	public:
+		Alias_Table() : m_total_weight(0) {}
+		Alias_Table(const std::vector<double>& weights);
+
+		// Index sampled with probability proportional to its weight, given u uniform on [0, 1)
+		int sample(double u) const;
+
+		// Probability of sampling index i
+		double probability(int i) const { return m_probabilities[i]; }
+
+		// Acessor functions
+		int size() const { return (int) m_bins.size(); }
+		bool empty() const { return m_bins.empty(); }
+		double total_weight() const { return m_total_weight; }
+
+	private:
+		struct Bin {
+			double threshold;
+			int alias;
+
+			Bin() : threshold(1.0), alias(0) {}
+		};
+
+		std::vector<Bin> m_bins;
+		std::vector<double> m_probabilities;
+		double m_total_weight;
+	};
+}
+
+#endif
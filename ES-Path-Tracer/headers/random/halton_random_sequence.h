@@ -0,0 +1,39 @@
+#ifndef ES_PATH_TRACER__RANDOM__HALTON_RANDOM_SEQUENCE_H_
+#define ES_PATH_TRACER__RANDOM__HALTON_RANDOM_SEQUENCE_H_
+
+#include <cstdint>
+
+#include "random_number_engine.h"
+#include "random_sequence.h"
+
+namespace random
+{
+	/*	Halton sequence, whose d-th dimension is the radical inverse of the sample index in the 
+		d-th prime base. Every pixel shifts each dimension by its own random offset (a 
+		Cranley-Patterson rotation), which decorrelates pixels while keeping the stratification
+		of the sequence. Dimensions beyond NUM_DIMENSIONS, where the bases become too large to
+		stratify a usable number of samples, are drawn from a PCG32 stream of the sample */
+	class Halton_Random_Sequence : public Random_Sequence {
+	public:
+		static const int NUM_DIMENSIONS = 64;
+
+		Halton_Random_Sequence(std::uint64_t seed, std::uint64_t key);
+
+		void start_sample(std::uint64_t sample);
+
+		void set_dimension(size_t dimension);
+
+		double next();
+
+		double next_light_sample() { return next(); }
+
+	private:
+		std::uint64_t m_key;
+		double m_offsets[NUM_DIMENSIONS];
+		PCG32 m_engine;
+
+		static double radical_inverse(int base, std::uint64_t index);
+	};
+}
+
+#endif
@@ -1,11 +1,60 @@
 #ifndef ES_PATH_TRACER__RANDOM__RANDOM_NUMBER_ENGINE_H_
 #define ES_PATH_TRACER__RANDOM__RANDOM_NUMBER_ENGINE_H_
 
+#include <cstdint>
 #include <random>
 
 namespace random
 {
-	std::mt19937& mt_engine_singleton();
+	/*	PCG32 engine (permuted congruential generator, XSH-RR output). Its whole state is two 
+		64-bit words, so engines are cheap to create and copy. Each stream is an independent
+		sequence, and any position of a stream can be reached in O(log n) steps with advance,
+		which makes it usable as a counter-based generator. Satisfies the requirements of a 
+		uniform random bit generator, so it can be used with the standard distributions */
+	class PCG32 {
+	public:
+		typedef std::uint32_t result_type;
+
+		PCG32(std::uint64_t seed = 0x853c49e6748fea9bULL, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+		{
+			set_stream(seed, stream);
+		}
+
+		// Restarts the engine at the first position of the given stream
+		void set_stream(std::uint64_t seed, std::uint64_t stream);
+
+		// Skips the next delta numbers of the stream
+		void advance(std::uint64_t delta);
+
+		result_type operator()()
+		{
+			const std::uint64_t old_state = m_state;
+			m_state = old_state * MULTIPLIER + m_increment;
+
+			const std::uint32_t xorshifted = std::uint32_t(((old_state >> 18u) ^ old_state) >> 27u);
+			const std::uint32_t rotation = std::uint32_t(old_state >> 59u);
+			return (xorshifted >> rotation) | (xorshifted << ((~rotation + 1u) & 31u));
+		}
+
+		// Uniform number on [0, 1), with 32 bits of resolution
+		double next_double() { return operator()() * (1.0 / 4294967296.0); }
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+	private:
+		static const std::uint64_t MULTIPLIER = 6364136223846793005ULL;
+
+		std::uint64_t m_state;
+		std::uint64_t m_increment;
+	};
+
+	/*	Engine of the calling thread. Every thread gets its own stream of a seed drawn once per 
+		run, so threads never share generator state */
+	PCG32& thread_engine();
+
+	// Mixes two 64-bit values into a well-distributed key, e.g. to derive per-pixel streams
+	std::uint64_t hash(std::uint64_t a, std::uint64_t b);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,7 @@
 #ifndef ES_PATH_TRACER__RANDOM__RANDOM_SEQUENCE_H_
 #define ES_PATH_TRACER__RANDOM__RANDOM_SEQUENCE_H_
 
+#include <cstdint>
 #include <random>
 
 #include "../geometry/vector3.h"
@@ -10,17 +11,34 @@ namespace random
 {
 	class Random_Sequence {
 	public:
-		Random_Sequence() : m_mt_engine(random::mt_engine_singleton()), m_index(0) {}
+		Random_Sequence() : m_index(0), m_sample(0) {}
+
+		virtual ~Random_Sequence() {}
 
 		virtual double next() = 0;
+
+		/*	Sequences made of samples, each an independent point of many dimensions, restart at
+			the first dimension of the given sample. Others ignore it */
+		virtual void start_sample(std::uint64_t) {}
+
+		/*	Moves to the given dimension of the current sample, so that each random decision of a 
+			path reads the same dimension in every sample. Sequences read in order ignore it */
+		virtual void set_dimension(size_t) {}
+
+		/*	Number used to choose lights and light points. By default it is drawn from the 
+			thread's engine, so that sequences searched over (e.g. ES individuals) are made only
+			of scattering decisions; samplers override it to take it from the sequence */
+		virtual double next_light_sample();
+
+		std::uint64_t sample() const { return m_sample; }
 		
 		virtual Vector3 uniform_distributed_hemisphere_sample();
 		
 		virtual Vector3 cos_distributed_hemisphere_sample();
 
 	protected:
-		std::mt19937& m_mt_engine;
 		size_t m_index;
+		std::uint64_t m_sample;
 
 		virtual double next_element();
 	};
@@ -0,0 +1,45 @@
+#ifndef ES_PATH_TRACER__RANDOM__SOBOL_RANDOM_SEQUENCE_H_
+#define ES_PATH_TRACER__RANDOM__SOBOL_RANDOM_SEQUENCE_H_
+
+#include <cstdint>
+
+#include "random_sequence.h"
+
+namespace random
+{
+	/*	Owen-scrambled Sobol sequence, following Burley's "Practical Hash-based Owen Scrambling"
+		(2020). Dimensions are taken in groups of four, each group a 4D Sobol point whose index 
+		is shuffled and whose coordinates are scrambled with seeds derived from the pixel key and
+		the group. Groups are thus decorrelated from each other and from other pixels, while the
+		points of a group stay well stratified, and any sample count gives a valid estimate */
+	class Sobol_Random_Sequence : public Random_Sequence {
+	public:
+		static const int DIMENSIONS_PER_GROUP = 4;
+
+		Sobol_Random_Sequence(std::uint64_t seed, std::uint64_t key);
+
+		void start_sample(std::uint64_t sample);
+
+		void set_dimension(size_t dimension);
+
+		double next();
+
+		double next_light_sample() { return next(); }
+
+	private:
+		std::uint64_t m_key;
+		// Group of dimensions whose point is cached, or -1
+		long long m_group;
+		double m_point[DIMENSIONS_PER_GROUP];
+
+		void compute_group(size_t group);
+
+		static std::uint32_t sobol(std::uint32_t index, int dimension);
+
+		static std::uint32_t nested_uniform_scramble(std::uint32_t value, std::uint32_t seed);
+
+		static std::uint32_t reverse_bits(std::uint32_t value);
+	};
+}
+
+#endif
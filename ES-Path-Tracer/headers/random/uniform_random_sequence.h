@@ -1,22 +1,35 @@
 #ifndef ES_PATH_TRACER__RANDOM__UNIFORM_RANDOM_SEQUENCE_H_
 #define ES_PATH_TRACER__RANDOM__UNIFORM_RANDOM_SEQUENCE_H_
 
-#include <random>
-#include <vector>
+#include <cstdint>
 
+#include "random_number_engine.h"
 #include "random_sequence.h"
 
 namespace random
 {
+	/*	Sequence of independent uniform numbers on [0, 1). Numbers are not stored: every 
+		(key, sample) pair selects its own PCG32 stream, and the i-th number drawn for a sample 
+		is the i-th number of that stream, so a pixel's samples are reproducible regardless of 
+		the thread or the order in which they are computed. Without a key, a random one is 
+		drawn from the thread's engine */
 	class Uniform_Random_Sequence : public Random_Sequence {
 	public:
-		Uniform_Random_Sequence() {}
-		Uniform_Random_Sequence(const std::vector<double>& values) : sequence(values) {}
-    
+		Uniform_Random_Sequence();
+		Uniform_Random_Sequence(std::uint64_t seed, std::uint64_t key);
+
+		// Restarts the sequence at the first dimension of the given sample
+		void start_sample(std::uint64_t sample);
+
+		void set_dimension(size_t dimension);
+
 		double next();
-		
+
+		double next_light_sample() { return next(); }
+
 	private:
-		std::vector<double> sequence;
+		std::uint64_t m_key;
+		PCG32 m_engine;
 	};
 }
 
@@ -5,8 +5,10 @@
 
 #include "../geometry/aab.h"
 #include "../geometry/ray.h"
+#include "../geometry/ray_packet.h"
 #include "../geometry/triangle.h"
 #include "../kd-tree/kd_tree.h"
+#include "../random/alias_table.h"
 #include "../shading/color3.h"
 #include "../shading/surface_element.h"
 #include "light.h"
@@ -18,21 +20,37 @@ namespace scene
         Area_Light(const Radiance3& m_power, const std::vector<const Triangle*>& triangles);
 
         bool intersect(const Ray& ray, double& t, Surface_Element& surfel) const;
+
+		// Packet intersection, returning the mask of rays that hit the light
+		int intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+			Surface_Element surfels[Ray_Packet::SIZE]) const;
         
 		const AAB& aabb() const { return m_kd_tree.aabb(); }
 
 		double area() const { return m_area; }
 
-		void sample_point(Point3& sample_position, Vector3& sample_normal) const;
+		const std::vector<const Triangle*>& triangles() const { return m_triangles; }
+
+		// Point of the triangle given by u and v uniform on [0, 1)
+		void sample_point(const Triangle& triangle, double u, double v, Point3& sample_position,
+			Vector3& sample_normal) const;
+
+		// Triangle sampled with probability proportional to its area, given u uniform on [0, 1)
+		const Triangle& sample_triangle(double u) const;
 
     private:
 		const double m_area;
         const kd_tree::KD_Tree m_kd_tree;
 		const std::vector<const Triangle*> m_triangles;
+		// Selects triangles with probability proportional to their area
+		const random::Alias_Table m_triangle_selection;
 
 		static double total_area(const std::vector<const Triangle*>& triangles);
 
-		const Triangle* sample_triangle() const;
+		static std::vector<double> triangle_areas(const std::vector<const Triangle*>& triangles);
+
+		bool fill_surface_element(const Ray& ray, const Triangle& triangle, double& t,
+			Surface_Element& surfel) const;
     };
 }
 
@@ -0,0 +1,81 @@
+#ifndef ES_PATH_TRACER__SCENE__LIGHT_BVH_H_
+#define ES_PATH_TRACER__SCENE__LIGHT_BVH_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "../geometry/aab.h"
+#include "../geometry/point3.h"
+#include "../geometry/triangle.h"
+#include "../geometry/vector3.h"
+#include "area_light.h"
+
+namespace scene
+{
+	/*	Bounding volume hierarchy over the triangles of all area lights, used to pick the 
+		triangle to sample for direct lighting by its importance to the shading point. Every 
+		node stores the bounds, the total power and a cone bounding the normals of the triangles 
+		below it, from which an upper estimate of the light they can send to a point is computed 
+		(Estevez and Kulla, 2018). Triangles are picked by descending from the root, choosing 
+		each child with probability proportional to its importance */
+	class Light_BVH {
+	public:
+		Light_BVH() {}
+		Light_BVH(const std::vector<Area_Light*>& area_lights);
+
+		bool empty() const { return m_nodes.empty(); }
+
+		/*	Picks a triangle for the given position using u, uniform on [0, 1). The light it 
+			belongs to is stored in light, and the probability of picking it in probability */
+		const Triangle& sample(const Point3& position, double u, const Area_Light*& light,
+			double& probability) const;
+
+		// Probability with which sample picks the given triangle, 0 if it is not an emitter
+		double probability(const Point3& position, const Triangle& triangle) const;
+
+		// True if the triangle belongs to one of the area lights
+		bool contains(const Triangle& triangle) const { return m_leaves.count(&triangle) != 0; }
+
+	private:
+		struct Node {
+			AAB bounds;
+			double power;
+			Vector3 axis;
+			double cone_angle;
+			int parent;
+			// Interior nodes: index of the second child, the first one is the next node
+			int right;
+			// Leaves: triangle and the light it belongs to
+			const Triangle* triangle;
+			const Area_Light* light;
+
+			Node() : power(0), axis(0.0), cone_angle(0), parent(-1), right(-1), triangle(nullptr),
+				light(nullptr) {}
+
+			bool is_leaf() const { return triangle != nullptr; }
+		};
+
+		struct Emitter {
+			const Triangle* triangle;
+			const Area_Light* light;
+			Point3 centroid;
+
+			Emitter(const Triangle* triangle, const Area_Light* light, const Point3& centroid)
+				: triangle(triangle), light(light), centroid(centroid) {}
+		};
+
+		std::vector<Node> m_nodes;
+		std::unordered_map<const Triangle*, int> m_leaves;
+
+		int build(std::vector<Emitter>& emitters, size_t begin, size_t end, int parent);
+
+		double importance(const Node& node, const Point3& position) const;
+
+		// Probability of descending from an interior node into its first child
+		double left_probability(int node, const Point3& position) const;
+
+		static void merge(Node& node, const Node& left, const Node& right);
+	};
+}
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "../geometry/aab.h"
 #include "../geometry/ray.h"
+#include "../geometry/ray_packet.h"
 #include "../geometry/triangle.h"
 #include "../kd-tree/kd_tree.h"
 #include "../shading/surface_element.h"
@@ -19,10 +20,15 @@ namespace scene
 			Surface_Element::Material_Data material);
         
 		bool intersect(const Ray &ray, double &t, Surface_Element& surfel) const;
+		int intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+			Surface_Element surfels[Ray_Packet::SIZE]) const;
         const AAB& aabb() const;
 
     private:
         kd_tree::KD_Tree m_kd_tree;
+
+		void fill_surface_element(const Ray &ray, const Triangle& triangle, double &t,
+			Surface_Element& surfel) const;
     };
 }
 
@@ -2,6 +2,7 @@
 #define ES_PATH_TRACER__SCENE__OBJECT_H_
 
 #include "../geometry/ray.h"
+#include "../geometry/ray_packet.h"
 #include "../geometry/aab.h"
 #include "../shading/surface_element.h"
 
@@ -12,6 +13,21 @@ namespace scene
 		Object(const Surface_Element::Material_Data& material) { set_material(material); }
 
 		virtual bool intersect(const Ray &ray, double &t, Surface_Element& surfel) const = 0;
+
+		/*	Packet intersection. Each ray in mask is intersected as in the single ray version, 
+			and the mask of rays that hit the object is returned. By default the rays are 
+			intersected one by one */
+		virtual int intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+			Surface_Element surfels[Ray_Packet::SIZE]) const
+		{
+			int hit_mask = 0;
+
+			for (int i = 0; i < packet.size(); ++i)
+				if ((mask & (1 << i)) && intersect(packet.ray(i), t[i], surfels[i]))
+					hit_mask |= 1 << i;
+
+			return hit_mask;
+		}
         virtual const AAB& aabb() const = 0;
 
 		virtual const Surface_Element::Material_Data& material() const { return m_material; }
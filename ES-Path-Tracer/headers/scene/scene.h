@@ -1,12 +1,17 @@
 #ifndef ES_PATH_TRACER__SCENE__SCENE_H_
 #define ES_PATH_TRACER__SCENE__SCENE_H_
 
+#include <algorithm>
 #include <vector>
 
+#include "../geometry/aab.h"
+#include "../geometry/ray_packet.h"
 #include "../geometry/vector3.h"
+#include "../random/alias_table.h"
 #include "../shading/color3.h"
 #include "../shading/surface_element.h"
 #include "area_light.h"
+#include "light_bvh.h"
 #include "object.h"
 
 class Path_Tracer;
@@ -20,23 +25,57 @@ namespace scene
         friend class Path_Tracer;
 
     public:
+        Scene() : m_total_light_area(0), m_lights_finalized(true), m_aabb() {}
         ~Scene();
         
         bool intersect(const Ray &ray, double& max_t, Surface_Element& surfel,
 			double refractive_index) const;
 
+		/*	Packet version of intersect, for the rays in mask, each travelling through a medium of
+			its own refractive index. Returns the mask of rays that hit the scene before their 
+			max_t */
+		int intersect(const Ray_Packet& packet, int mask, double max_t[Ray_Packet::SIZE],
+			Surface_Element surfels[Ray_Packet::SIZE], 
+			const double refractive_indices[Ray_Packet::SIZE]) const;
+
+		// Packet version of intersect for rays that travel through the same medium
+		int intersect(const Ray_Packet& packet, int mask, double max_t[Ray_Packet::SIZE],
+			Surface_Element surfels[Ray_Packet::SIZE], double refractive_index) const
+		{
+			double refractive_indices[Ray_Packet::SIZE];
+			std::fill(refractive_indices, refractive_indices + Ray_Packet::SIZE, refractive_index);
+			return intersect(packet, mask, max_t, surfels, refractive_indices);
+		}
+
 		void clear();
 
         // Insertion functions
-        void add_object(Object* ptr) { m_objects.push_back(ptr); }
+        void add_object(Object* ptr);
         //void add_point_light(Point_Light* ptr) { m_point_lights.push_back(ptr); }
 		void add_area_light(Area_Light* ptr);
 
+		/*	Builds the light selection structures of the added lights. Must be called after 
+			the last light is added and before rendering */
+		void finalize();
+		bool is_finalized() const { return m_lights_finalized; }
+
+		// Bounding box of every object and light in the scene
+		const AAB& aabb() const { return m_aabb; }
+
     private:
         std::vector<Object*> m_objects;
         //std::vector<Point_Light*> m_point_lights;
         std::vector<Area_Light*> m_area_lights;
 		double m_total_light_area;
+		// Selects area lights with probability proportional to their area
+		random::Alias_Table m_light_selection;
+		// Selects light triangles by their importance to a shading point
+		Light_BVH m_light_bvh;
+		// False while lights were added after the last finalize
+		bool m_lights_finalized;
+		AAB m_aabb;
+
+		void expand_aabb(const AAB& aabb);
     };
 }
 
@@ -5,6 +5,7 @@
 
 #include "../geometry/vector3.h"
 #include "../geometry/point3.h"
+#include "../geometry/triangle.h"
 #include "../random/random_sequence.h"
 #include "../shading/color3.h"
 
@@ -25,15 +26,17 @@ namespace scene
             /*  The normal is the triangle's face normal, which can be used for ray bumping; 
 			the tangent0 and tangent1 vectors form an orthonormal basis with it. The position 
 			is the actual position on the surface, and may be changed by displacement or bump 
-			mapping */
+			mapping. The triangle is the one the position lies on, or null for other surfaces */
 
             Vector3 normal, tangent0, tangent1;
             Point3 position;
+			const Triangle* triangle;
 
-            Geometric_Data() : normal(0), tangent0(0), tangent1(0), position(0) {}
+            Geometric_Data() : normal(0), tangent0(0), tangent1(0), position(0), triangle(nullptr) {}
             Geometric_Data(const Vector3& normal, const Vector3& tangent0, const Vector3& tangent1,
 				const Point3& position)
-				: normal(normal), tangent0(tangent0), tangent1(tangent1), position(position) {}
+				: normal(normal), tangent0(tangent0), tangent1(tangent1), position(position),
+				triangle(nullptr) {}
         };
 
         struct Material_Data {
@@ -85,16 +88,31 @@ namespace scene
         Material_Data material;
         // ======================================
 
+		/*	delta tells whether w_o was chosen by a delta lobe (the perfect mirror or refraction),
+			which scatter_pdf does not cover */
         bool scatter(
 			const Vector3& w_i,
 			Vector3& w_o,
 			Color3& coefficient,
-			random::Random_Sequence& rnd) const;
+			random::Random_Sequence& rnd,
+			bool& delta) const;
+
+		/*	Solid angle density with which scatter returns w_o for the incoming direction w_i 
+			(pointing towards the surface) from its Lambertian lobe, the only one with a density.
+			Mirror reflected and refracted directions are sampled from delta distributions */
+		double scatter_pdf(const Vector3& w_i, const Vector3& w_o) const;
 
 		// Assumes both vectors point outwards
 		Radiance3 evaluate_bsdf(const Vector3& w_i, const Vector3& w_o) const;
 
+		// Lambertian part of evaluate_bsdf, the part that scatter samples with scatter_pdf
+		Radiance3 evaluate_lambertian_bsdf(const Vector3& w_i, const Vector3& w_o) const;
+
 	private:
+		static double lobe_probability(const Color3& lobe_color);
+		// Sum of the probabilities of every lobe, the average reflectance of the material
+		double scatter_probability() const;
+
 		Vector3 mirror_reflect(const Vector3& incident, Vector3 normal = Vector3(0.0)) const;
 		Vector3 refract(const Vector3& incoming, Vector3 normal = Vector3(0.0)) const;
     };
@@ -0,0 +1,124 @@
+#ifndef ES_PATH_TRACER__STATS__RENDER_STATS_H_
+#define ES_PATH_TRACER__STATS__RENDER_STATS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+/*	Compile-time switch of the render statistics. Defined as false (e.g. /D RENDER_STATS=false),
+	the STATS_ macros expand to nothing, so the counters cost nothing in the renderer */
+#ifndef RENDER_STATS
+#define RENDER_STATS true
+#endif
+
+/*	Render statistics, counted by every thread in counters of its own, without locks or atomic
+	operations, and summed once the work is done. Counters are updated through the STATS_
+	macros below, so that they can be compiled out */
+namespace stats
+{
+	enum Counter {
+		EYE_RAYS,
+		INDIRECT_RAYS,
+		SHADOW_RAYS,
+		KD_TREE_NODES,
+		TRIANGLE_TESTS,
+		SAMPLES,
+		FITNESS_EVALUATIONS,
+		GENERATIONS,
+		NUM_COUNTERS
+	};
+
+	// Nested phases are also counted in the enclosing ones (accelerators are built with the scene)
+	enum Phase { SCENE_BUILD_PHASE, ACCELERATOR_BUILD_PHASE, RENDER_PHASE, OUTPUT_PHASE, NUM_PHASES };
+
+	// Paths of this many bounces or more share the last bar of the path length histogram
+	const int MAX_PATH_LENGTH = 16;
+
+	// Cache line size, to which the counters of each thread are aligned and padded
+	const std::size_t CACHE_LINE_SIZE = 64;
+
+	/*	Aligned to whole cache lines, so that threads counting in their own counters do not 
+		invalidate the lines of each other */
+	struct alignas(CACHE_LINE_SIZE) Thread_Counters {
+		std::uint64_t counters[NUM_COUNTERS];
+		// Number of paths by their number of bounces
+		std::uint64_t path_lengths[MAX_PATH_LENGTH + 1];
+		double phase_seconds[NUM_PHASES];
+	};
+
+	/*	Counters of the calling thread, created the first time the thread asks for them and kept
+		until the end of the program, so that they can be summed after the thread is gone */
+	Thread_Counters& thread_counters();
+
+	inline void add_path_length(int bounces)
+	{
+		++thread_counters().path_lengths[std::min(bounces, MAX_PATH_LENGTH)];
+	}
+
+	// Phase_Timer objects add the time from their construction to their destruction to a phase
+	class Phase_Timer {
+	public:
+		explicit Phase_Timer(Phase phase) : m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+		~Phase_Timer()
+		{
+			thread_counters().phase_seconds[m_phase] += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - m_start).count();
+		}
+
+		Phase_Timer(const Phase_Timer&) = delete;
+		Phase_Timer& operator=(const Phase_Timer&) = delete;
+
+	private:
+		Phase m_phase;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	/*	Render_Stats objects hold the sum of the counters of every thread. They must be collected
+		while no thread is counting, e.g. between renders */
+	class Render_Stats {
+	public:
+		// Sums the counters of every thread
+		static Render_Stats collect();
+		// Sets the counters of every thread to 0
+		static void reset();
+
+		// Acessor functions
+		std::uint64_t counter(Counter counter) const { return m_totals.counters[counter]; }
+		std::uint64_t num_paths(int bounces) const { return m_totals.path_lengths[bounces]; }
+		double phase_seconds(Phase phase) const { return m_totals.phase_seconds[phase]; }
+		long long num_pixels() const { return m_num_pixels; }
+
+		// Number of pixels of the image, by which the samples per pixel are computed
+		void set_num_pixels(long long num_pixels) { m_num_pixels = num_pixels; }
+
+		double samples_per_pixel() const;
+		double mean_path_length() const;
+
+		// One JSON object with every counter, the path length histogram and the phase times
+		void write_json(std::ostream& out) const;
+		// Table of the counters, for people
+		void write_table(std::ostream& out) const;
+
+	private:
+		Thread_Counters m_totals;
+		long long m_num_pixels;
+
+		Render_Stats();
+	};
+}
+
+#if RENDER_STATS
+#define STATS_ADD(counter, amount) (::stats::thread_counters().counters[counter] += (amount))
+#define STATS_PATH_LENGTH(bounces) ::stats::add_path_length(bounces)
+#define STATS_PHASE_TIMER(phase) ::stats::Phase_Timer stats_phase_timer(phase)
+#define STATS_PHASE_TIME(phase, seconds) (::stats::thread_counters().phase_seconds[phase] += (seconds))
+#else
+#define STATS_ADD(counter, amount) ((void) 0)
+#define STATS_PATH_LENGTH(bounces) ((void) 0)
+#define STATS_PHASE_TIMER(phase) ((void) 0)
+#define STATS_PHASE_TIME(phase, seconds) ((void) 0)
+#endif
+
+#endif
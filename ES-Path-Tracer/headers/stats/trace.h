@@ -0,0 +1,107 @@
+#ifndef ES_PATH_TRACER__STATS__TRACE_H_
+#define ES_PATH_TRACER__STATS__TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "render_stats.h"
+
+/*	Timeline of the work of every thread, as spans (tiles, waits for locks and other threads,
+	accelerator builds, file output) that can be written in the Chrome trace event format and
+	opened in a trace viewer (chrome://tracing, Perfetto), to see idle threads and stragglers.
+
+	Every thread records its spans in a buffer of its own, without locks, which is registered
+	the first time the thread records a span. Tracing is off until enabled, and then costs two
+	clock reads per span. Spans are recorded through the TRACE_ macros below, which are
+	compiled out with the render statistics (see RENDER_STATS) */
+namespace stats
+{
+	struct Trace_Event {
+		// Static strings: names are not copied
+		const char* name;
+		const char* category;
+		// Nanoseconds from the start of the trace
+		std::int64_t start;
+		std::int64_t duration;
+		// Tile of the span, or -1
+		int row;
+		int col;
+	};
+
+	class Trace {
+	public:
+		// Spans recorded by a thread beyond this number are dropped, and counted
+		static const int MAX_EVENTS_PER_THREAD = 1 << 20;
+
+		static void enable() { s_enabled.store(true, std::memory_order_relaxed); }
+		static void disable() { s_enabled.store(false, std::memory_order_relaxed); }
+		static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+		// Name of the calling thread in the trace (by default, "thread" and its number)
+		static void set_thread_name(const std::string& name);
+
+		// Records a span of the calling thread
+		static void record(const char* name, const char* category,
+			std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end,
+			int row = -1, int col = -1);
+
+		/*	Writes the spans of every thread as a Chrome trace event JSON object. Must be called
+			while no thread records spans, e.g. between renders */
+		static void write_json(std::ostream& out);
+		// Throws std::runtime_error if the file cannot be written
+		static void save(const std::string& filename);
+
+		// Removes every span recorded so far
+		static void clear();
+
+	private:
+		static std::atomic<bool> s_enabled;
+	};
+
+	// Trace_Span objects record the span from their construction to their destruction
+	class Trace_Span {
+	public:
+		Trace_Span(const char* name, const char* category, int row = -1, int col = -1) :
+			m_name(name),
+			m_category(category),
+			m_row(row),
+			m_col(col),
+			m_active(Trace::enabled())
+		{
+			if (m_active)
+				m_start = std::chrono::steady_clock::now();
+		}
+
+		~Trace_Span()
+		{
+			if (m_active)
+				Trace::record(m_name, m_category, m_start, std::chrono::steady_clock::now(), m_row, m_col);
+		}
+
+		Trace_Span(const Trace_Span&) = delete;
+		Trace_Span& operator=(const Trace_Span&) = delete;
+
+	private:
+		const char* m_name;
+		const char* m_category;
+		int m_row;
+		int m_col;
+		bool m_active;
+		std::chrono::steady_clock::time_point m_start;
+	};
+}
+
+#if RENDER_STATS
+#define TRACE_SPAN(name, category) ::stats::Trace_Span trace_span(name, category)
+#define TRACE_TILE_SPAN(name, category, row, col) ::stats::Trace_Span trace_span(name, category, row, col)
+#define TRACE_THREAD_NAME(name) ::stats::Trace::set_thread_name(name)
+#else
+#define TRACE_SPAN(name, category) ((void) 0)
+#define TRACE_TILE_SPAN(name, category, row, col) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+#endif
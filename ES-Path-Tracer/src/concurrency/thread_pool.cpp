@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#endif
+
+#include "concurrency/thread_pool.h"
+#include "stats/trace.h"
+
+namespace concurrency
+{
+	// ============================================================================
+	// ======================== CONSTRUCTOR / DESTRUCTOR ==========================
+	// ============================================================================
+
+	Thread_Pool::Thread_Pool(int num_threads, bool pin_threads) :
+		m_pin_threads(pin_threads),
+		m_task(nullptr),
+		m_generation(0),
+		m_busy_threads(0),
+		m_stop(false)
+	{
+		if (num_threads < 0)
+			throw std::invalid_argument("Number of threads must be non-negative");
+
+		if (num_threads == 0)
+			num_threads = std::max(1, (int) std::thread::hardware_concurrency());
+
+		for (int i = 0; i < num_threads; ++i)
+			m_threads.push_back(std::thread(&Thread_Pool::worker, this, i));
+	}
+
+	Thread_Pool::~Thread_Pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_stop = true;
+		}
+		m_work_ready.notify_all();
+
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ============================= WORK FUNCTIONS ===============================
+	// ============================================================================
+
+	void Thread_Pool::run(const std::function<void(int)>& task)
+	{
+		std::lock_guard<std::mutex> run_lock(m_run_lock);
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		m_task = &task;
+		m_busy_threads = num_threads();
+		++m_generation;
+		m_work_ready.notify_all();
+
+		{
+			TRACE_SPAN("wait for pool", "wait");
+			m_work_done.wait(lock, [this]() { return m_busy_threads == 0; });
+		}
+		m_task = nullptr;
+	}
+
+	void Thread_Pool::parallel_for(int begin, int end, const std::function<void(int)>& body)
+	{
+		std::atomic<int> next_index(begin);
+
+		run([&](int) {
+			for (int i = next_index++; i < end; i = next_index++)
+				body(i);
+		});
+	}
+
+	void Thread_Pool::worker(int thread_index)
+	{
+		if (m_pin_threads)
+			pin(thread_index);
+
+		TRACE_THREAD_NAME("pool thread " + std::to_string(thread_index));
+
+		unsigned long long last_generation = 0;
+
+		while (true)
+		{
+			const std::function<void(int)>* task;
+
+			{
+				std::unique_lock<std::mutex> lock(m_lock);
+				m_work_ready.wait(lock, [&]() { return m_stop || m_generation != last_generation; });
+
+				if (m_stop)
+					return;
+
+				last_generation = m_generation;
+				task = m_task;
+			}
+
+			{
+				TRACE_SPAN("task", "pool");
+				(*task)(thread_index);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				if (--m_busy_threads == 0)
+					m_work_done.notify_one();
+			}
+		}
+	}
+
+	void Thread_Pool::pin(int thread_index)
+	{
+		const unsigned int num_cores = std::max(1u, std::thread::hardware_concurrency());
+		const unsigned int core = thread_index % num_cores;
+
+#ifdef _WIN32
+		SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		CPU_SET(core, &cpu_set);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+	}
+
+	// ============================================================================
+}
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "config/render_config.h"
+#include "distributed/coordinator.h"
+#include "path-tracer/evolution_strategy_path_tracer.h"
+#include "path-tracer/monte_carlo_path_tracer.h"
+#include "path-tracer/path_tracer.h"
+#include "path-tracer/wavefront_path_tracer.h"
+
+const int DEFAULT_PORT = 40000;
+
+namespace config
+{
+	// ============================================================================
+	// ============================== VALUE PARSING ===============================
+	// ============================================================================
+
+	static int parse_int(const std::string& name, const std::string& value)
+	{
+		size_t end = 0;
+		int result = 0;
+
+		try
+		{
+			result = std::stoi(value, &end);
+		}
+		catch (const std::exception&)
+		{
+			end = 0;
+		}
+
+		if (end == 0 || end != value.size())
+			throw std::invalid_argument("Option " + name + " expects an integer, not \"" + value + "\"");
+		return result;
+	}
+
+	static std::uint64_t parse_uint64(const std::string& name, const std::string& value)
+	{
+		size_t end = 0;
+		std::uint64_t result = 0;
+
+		try
+		{
+			result = std::stoull(value, &end);
+		}
+		catch (const std::exception&)
+		{
+			end = 0;
+		}
+
+		if (end == 0 || end != value.size() || value[0] == '-')
+			throw std::invalid_argument("Option " + name + " expects an unsigned integer, not \"" + value + "\"");
+		return result;
+	}
+
+	static double parse_double(const std::string& name, const std::string& value)
+	{
+		size_t end = 0;
+		double result = 0;
+
+		try
+		{
+			result = std::stod(value, &end);
+		}
+		catch (const std::exception&)
+		{
+			end = 0;
+		}
+
+		if (end == 0 || end != value.size())
+			throw std::invalid_argument("Option " + name + " expects a number, not \"" + value + "\"");
+		return result;
+	}
+
+	// Also accepts ratios, such as 16:9
+	static double parse_ratio(const std::string& name, const std::string& value)
+	{
+		const size_t colon = value.find(':');
+
+		if (colon == std::string::npos)
+			return parse_double(name, value);
+
+		const double denominator = parse_double(name, value.substr(colon + 1));
+		if (denominator == 0)
+			throw std::invalid_argument("Option " + name + " has a zero denominator");
+		return parse_double(name, value.substr(0, colon)) / denominator;
+	}
+
+	static bool parse_bool(const std::string& name, const std::string& value)
+	{
+		if (value == "true" || value == "1" || value == "yes" || value == "on")
+			return true;
+		if (value == "false" || value == "0" || value == "no" || value == "off")
+			return false;
+		throw std::invalid_argument("Option " + name + " expects true or false, not \"" + value + "\"");
+	}
+
+	template<typename T>
+	static T parse_enum(
+		const std::string& name,
+		const std::string& value,
+		const std::vector<std::pair<std::string, T>>& values)
+	{
+		std::string names;
+
+		for (const std::pair<std::string, T>& entry : values)
+		{
+			if (entry.first == value)
+				return entry.second;
+			names += (names.empty() ? "" : ", ") + entry.first;
+		}
+
+		throw std::invalid_argument("Option " + name + " expects one of " + names + ", not \"" + value + "\"");
+	}
+
+	static Evolution_Strategy_Path_Tracer::Radiance_Coefficient parse_radiance_coefficient(
+		const std::string& name,
+		const std::string& value)
+	{
+		typedef es::Color_Histogram_Fitness Fitness;
+		return parse_enum<Fitness::Radiance_Coefficient>(name, value, {
+			{ "none", Fitness::NO_RADIANCE_COEFFICIENT },
+			{ "maximum", Fitness::MAXIMUM_RADIANCE },
+			{ "norm-maximum", Fitness::NORM_MAXIMUM_RADIANCE },
+			{ "mean", Fitness::MEAN_RADIANCE },
+			{ "norm-mean", Fitness::NORM_MEAN_RADIANCE },
+			{ "norm-mean-and-maximum", Fitness::NORM_MEAN_AND_MAXIMUM_RADIANCE } });
+	}
+
+	static Evolution_Strategy_Path_Tracer::Frequency_Coefficient parse_frequency_coefficient(
+		const std::string& name,
+		const std::string& value)
+	{
+		typedef es::Color_Histogram_Fitness Fitness;
+		return parse_enum<Fitness::Frequency_Coefficient>(name, value, {
+			{ "none", Fitness::NO_FREQUENCY_COEFFICIENT },
+			{ "information", Fitness::INFORMATION_QUANTITY },
+			{ "inverse-information", Fitness::INVERSE_INFORMATION_QUANTITY } });
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ================================= OPTIONS ==================================
+	// ============================================================================
+
+	struct Option {
+		std::string name;
+		// Boolean options may be given without a value
+		bool is_flag;
+		std::string description;
+		std::function<void(Render_Config&, const std::string&, const std::string&)> apply;
+	};
+
+	static const std::vector<Option>& options()
+	{
+		typedef Render_Config C;
+		typedef const std::string& S;
+
+		static const std::vector<Option> options = {
+			{ "help", true, "print this description",
+				[](C& c, S n, S v) { c.help = parse_bool(n, v); } },
+			{ "config", false, "file of \"name = value\" options",
+				[](C& c, S, S v) { c.load(v); } },
+			{ "integrator", false, "es, mc or wavefront",
+				[](C& c, S n, S v) { c.integrator = parse_enum<C::Integrator>(n, v, {
+					{ "es", C::EVOLUTION_STRATEGY_INTEGRATOR },
+					{ "mc", C::MONTE_CARLO_INTEGRATOR },
+					{ "wavefront", C::WAVEFRONT_INTEGRATOR } }); } },
+			{ "mode", false, "local, coordinator or worker",
+				[](C& c, S n, S v) { c.mode = parse_enum<C::Mode>(n, v, {
+					{ "local", C::LOCAL_MODE },
+					{ "coordinator", C::COORDINATOR_MODE },
+					{ "worker", C::WORKER_MODE } }); } },
+			{ "host", false, "coordinator a worker connects to",
+				[](C& c, S, S v) { c.host = v; } },
+			{ "port", false, "port of the coordinator",
+				[](C& c, S n, S v) { c.port = parse_int(n, v); } },
+			{ "passes-per-job", false, "passes of a tile per distributed job, 0 for all",
+				[](C& c, S n, S v) { c.passes_per_job = parse_int(n, v); } },
+			{ "tiles-per-job", false, "tiles of a row per distributed job, 0 for a whole row",
+				[](C& c, S n, S v) { c.tiles_per_job = parse_int(n, v); } },
+			{ "job-timeout", false, "seconds a worker may take per job, 0 for none",
+				[](C& c, S n, S v) { c.job_timeout = parse_double(n, v); } },
+			{ "threads", false, "render threads, 0 for every hardware thread",
+				[](C& c, S n, S v) { c.num_threads = parse_int(n, v); } },
+			{ "pin-threads", true, "pin render threads to cores",
+				[](C& c, S n, S v) { c.pin_threads = parse_bool(n, v); } },
+			{ "passes", false, "progressive rendering passes",
+				[](C& c, S n, S v) { c.max_passes = parse_int(n, v); } },
+			{ "time-budget", false, "seconds after which no pass is started, 0 for none",
+				[](C& c, S n, S v) { c.time_budget = parse_double(n, v); } },
+			{ "adaptive-threshold", false, "relative error at which pixels stop being sampled, 0 for never",
+				[](C& c, S n, S v) { c.adaptive_threshold = parse_double(n, v); } },
+			{ "adaptive-min-passes", false, "passes before adaptive sampling stops pixels",
+				[](C& c, S n, S v) { c.adaptive_min_passes = parse_int(n, v); } },
+			{ "checkpoint", false, "file where the render is checkpointed, empty for none",
+				[](C& c, S, S v) { c.checkpoint_filename = v; } },
+			{ "checkpoint-interval", false, "seconds between checkpoints",
+				[](C& c, S n, S v) { c.checkpoint_interval = parse_double(n, v); } },
+			{ "resume", true, "resume the render of the checkpoint file",
+				[](C& c, S n, S v) { c.resume = parse_bool(n, v); } },
+			{ "width", false, "horizontal resolution",
+				[](C& c, S n, S v) { c.resolution_width = parse_int(n, v); } },
+			{ "window-width", false, "width of the camera window",
+				[](C& c, S n, S v) { c.window_width = parse_double(n, v); } },
+			{ "aspect-ratio", false, "width over height, such as 1.5 or 16:9",
+				[](C& c, S n, S v) { c.aspect_ratio = parse_ratio(n, v); } },
+			{ "gamma-coefficient", false, "gamma encoding coefficient",
+				[](C& c, S n, S v) { c.gamma_coefficient = parse_double(n, v); } },
+			{ "gamma-exponent", false, "gamma encoding exponent, such as 0.4 or 1:2.5",
+				[](C& c, S n, S v) { c.gamma_exponent = parse_ratio(n, v); } },
+			{ "tile-size", false, "side of the square tiles rendered by each task",
+				[](C& c, S n, S v) { c.tile_size = parse_int(n, v); } },
+			{ "max-bounces", false, "maximum length of paths",
+				[](C& c, S n, S v) { c.max_bounces = parse_int(n, v); } },
+			{ "roulette-min-bounces", false, "bounces before Russian roulette may end paths",
+				[](C& c, S n, S v) { c.roulette_min_bounces = parse_int(n, v); } },
+			{ "roulette-threshold", false, "throughput below which paths face Russian roulette, 0 for never",
+				[](C& c, S n, S v) { c.roulette_threshold = parse_double(n, v); } },
+			{ "light-selection", false, "area or hierarchy",
+				[](C& c, S n, S v) { c.light_selection = parse_enum<Path_Tracer::Light_Selection>(n, v, {
+					{ "area", Path_Tracer::AREA_WEIGHTED },
+					{ "hierarchy", Path_Tracer::LIGHT_HIERARCHY } }); } },
+			{ "seed", false, "seed of the random sequences, random if not given",
+				[](C& c, S n, S v) { c.seed = parse_uint64(n, v); c.has_seed = true; } },
+			{ "es-iterations", false, "evolution strategy iterations per pixel",
+				[](C& c, S n, S v) { c.max_iterations_per_pixel = parse_int(n, v); } },
+			{ "es-population", false, "evolution strategy population size",
+				[](C& c, S n, S v) { c.population_size = parse_int(n, v); } },
+			{ "es-children-ratio", false, "children per individual of the population",
+				[](C& c, S n, S v) { c.children_population_ratio = parse_double(n, v); } },
+			{ "es-heuristic", false, "histogram-mean, population-mean or ranked-colors",
+				[](C& c, S n, S v) { c.heuristic = parse_enum<Evolution_Strategy_Path_Tracer::Heuristic>(n, v, {
+					{ "histogram-mean", Evolution_Strategy_Path_Tracer::HISTOGRAM_MEAN_HEURISTIC },
+					{ "population-mean", Evolution_Strategy_Path_Tracer::POPULATION_MEAN_HEURISTIC },
+					{ "ranked-colors", Evolution_Strategy_Path_Tracer::RANKED_COLORS_HEURISTIC } }); } },
+			{ "es-histogram-radius", false, "radius of the color neighbourhoods of the fitness",
+				[](C& c, S n, S v) { c.histogram_radius = parse_int(n, v); } },
+			{ "es-fitness-radiance", false, "none, maximum, norm-maximum, mean, norm-mean or norm-mean-and-maximum",
+				[](C& c, S n, S v) { c.fitness_radiance_coefficient = parse_radiance_coefficient(n, v); } },
+			{ "es-fitness-frequency", false, "none, information or inverse-information",
+				[](C& c, S n, S v) { c.fitness_frequency_coefficient = parse_frequency_coefficient(n, v); } },
+			{ "es-ranking-radiance", false, "radiance coefficient of ranked-colors, as es-fitness-radiance",
+				[](C& c, S n, S v) { c.ranking_radiance_coefficient = parse_radiance_coefficient(n, v); } },
+			{ "es-ranking-frequency", false, "frequency coefficient of ranked-colors, as es-fitness-frequency",
+				[](C& c, S n, S v) { c.ranking_frequency_coefficient = parse_frequency_coefficient(n, v); } },
+			{ "spp", false, "samples per pixel and pass of mc and wavefront",
+				[](C& c, S n, S v) { c.samples_per_pixel = parse_int(n, v); } },
+			{ "sampler", false, "uniform, sobol or halton",
+				[](C& c, S n, S v) { c.sampler = parse_enum<Monte_Carlo_Path_Tracer::Sampler>(n, v, {
+					{ "uniform", Monte_Carlo_Path_Tracer::UNIFORM_SAMPLER },
+					{ "sobol", Monte_Carlo_Path_Tracer::SOBOL_SAMPLER },
+					{ "halton", Monte_Carlo_Path_Tracer::HALTON_SAMPLER } }); } },
+			{ "sort-secondary-rays", true, "trace the paths of a tile together, sorting their secondary rays",
+				[](C& c, S n, S v) { c.sort_secondary_rays = parse_bool(n, v); } },
+			{ "wavefront-size", false, "paths in flight of the wavefront integrator",
+				[](C& c, S n, S v) { c.wavefront_size = parse_int(n, v); } },
+			{ "output", false, "image file",
+				[](C& c, S, S v) { c.output_filename = v; } },
+			{ "stream", true, "render tile by tile, writing each tile once done",
+				[](C& c, S n, S v) { c.stream = parse_bool(n, v); } },
+			{ "display", true, "show the image in a window once rendered",
+				[](C& c, S n, S v) { c.display = parse_bool(n, v); } },
+			{ "stats", true, "print the render statistics",
+				[](C& c, S n, S v) { c.print_stats = parse_bool(n, v); } },
+			{ "stats-file", false, "file where the render statistics are written as JSON, empty for none",
+				[](C& c, S, S v) { c.stats_filename = v; } },
+			{ "trace-file", false, "file where a Chrome trace of the render threads is written, empty for none",
+				[](C& c, S, S v) { c.trace_filename = v; } }
+		};
+
+		return options;
+	}
+
+	static const Option& find_option(const std::string& name)
+	{
+		for (const Option& option : options())
+		{
+			if (option.name == name)
+				return option;
+		}
+
+		throw std::invalid_argument("Unknown option " + name);
+	}
+
+	// Removes the white space at both ends
+	static std::string trim(const std::string& text)
+	{
+		const size_t begin = text.find_first_not_of(" \t\r");
+		if (begin == std::string::npos)
+			return std::string();
+		return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// =============================== CONSTRUCTOR ================================
+	// ============================================================================
+
+	Render_Config::Render_Config() :
+		integrator(EVOLUTION_STRATEGY_INTEGRATOR),
+		mode(LOCAL_MODE),
+		help(false),
+		host("localhost"),
+		port(DEFAULT_PORT),
+		passes_per_job(0),
+		tiles_per_job(0),
+		job_timeout(distributed::Coordinator::DEFAULT_JOB_TIMEOUT),
+		num_threads(0),
+		pin_threads(false),
+		max_passes(1),
+		time_budget(0),
+		adaptive_threshold(0),
+		adaptive_min_passes(Path_Tracer::DEFAULT_ADAPTIVE_MIN_PASSES),
+		checkpoint_interval(Path_Tracer::DEFAULT_CHECKPOINT_INTERVAL),
+		resume(false),
+		resolution_width(600),
+		window_width(3.0),
+		aspect_ratio(16.0 / 9.0),
+		gamma_coefficient(6),
+		gamma_exponent(1.0 / 2.5),
+		tile_size(Path_Tracer::DEFAULT_TILE_SIZE),
+		max_bounces(Path_Tracer::DEFAULT_MAX_BOUNCES),
+		roulette_min_bounces(Path_Tracer::DEFAULT_ROULETTE_MIN_BOUNCES),
+		roulette_threshold(Path_Tracer::DEFAULT_ROULETTE_THRESHOLD),
+		light_selection(Path_Tracer::LIGHT_HIERARCHY),
+		has_seed(false),
+		seed(0),
+		max_iterations_per_pixel(10),
+		population_size(10),
+		children_population_ratio(2.0),
+		heuristic(Evolution_Strategy_Path_Tracer::HISTOGRAM_MEAN_HEURISTIC),
+		histogram_radius(Evolution_Strategy_Path_Tracer::DEFAULT_HISTOGRAM_RADIUS),
+		fitness_radiance_coefficient(es::Color_Histogram_Fitness::NORM_MEAN_RADIANCE),
+		fitness_frequency_coefficient(es::Color_Histogram_Fitness::INFORMATION_QUANTITY),
+		ranking_radiance_coefficient(es::Color_Histogram_Fitness::NORM_MEAN_AND_MAXIMUM_RADIANCE),
+		ranking_frequency_coefficient(es::Color_Histogram_Fitness::NO_FREQUENCY_COEFFICIENT),
+		samples_per_pixel(200),
+		sampler(Monte_Carlo_Path_Tracer::UNIFORM_SAMPLER),
+		sort_secondary_rays(false),
+		wavefront_size(Wavefront_Path_Tracer::DEFAULT_WAVEFRONT_SIZE),
+		output_filename("result_image.ppm"),
+		stream(false),
+		display(false),
+		print_stats(false) {}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ============================ PARSING FUNCTIONS =============================
+	// ============================================================================
+
+	void Render_Config::parse_command_line(int argc, char* argv[])
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+
+			if (argument.compare(0, 2, "--") != 0 || argument.size() == 2)
+				throw std::invalid_argument("Unexpected argument " + argument);
+
+			const size_t equals = argument.find('=');
+			const std::string name = argument.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+			const Option& option = find_option(name);
+
+			if (equals != std::string::npos)
+				option.apply(*this, name, argument.substr(equals + 1));
+			else if (option.is_flag)
+				option.apply(*this, name, "true");
+			else if (i + 1 < argc)
+				option.apply(*this, name, argv[++i]);
+			else
+				throw std::invalid_argument("Option " + name + " expects a value");
+		}
+	}
+
+	void Render_Config::load(const std::string& filename)
+	{
+		// Files are told apart by the name they are given with
+		if (std::find(m_loading_files.begin(), m_loading_files.end(), filename) != m_loading_files.end())
+			throw std::invalid_argument("Configuration file " + filename + " includes itself");
+
+		std::ifstream in(filename);
+
+		if (!in)
+			throw std::runtime_error("Cannot open configuration file " + filename);
+
+		std::string line;
+		int line_number = 0;
+		m_loading_files.push_back(filename);
+
+		try
+		{
+			while (std::getline(in, line))
+			{
+				++line_number;
+				line = trim(line.substr(0, line.find('#')));
+
+				if (line.empty())
+					continue;
+
+				const size_t equals = line.find('=');
+				if (equals == std::string::npos)
+					throw std::invalid_argument(filename + ":" + std::to_string(line_number) + ": expected name = value");
+
+				set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+			}
+		}
+		catch (...)
+		{
+			m_loading_files.pop_back();
+			throw;
+		}
+
+		m_loading_files.pop_back();
+	}
+
+	void Render_Config::set(const std::string& name, const std::string& value)
+	{
+		find_option(name).apply(*this, name, value);
+	}
+
+	std::string Render_Config::usage()
+	{
+		std::ostringstream out;
+		out << "Options, as --name=value or --name value:" << std::endl;
+
+		for (const Option& option : options())
+		{
+			const std::string name = "  --" + option.name + (option.is_flag ? "[=bool]" : "");
+			out << name << std::string(name.size() < 26 ? 26 - name.size() : 1, ' ') << option.description << std::endl;
+		}
+
+		return out.str();
+	}
+
+	// ============================================================================
+}
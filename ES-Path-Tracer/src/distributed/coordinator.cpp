@@ -0,0 +1,247 @@
+#define PRINT_PROGRESS true
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "distributed/coordinator.h"
+#include "distributed/protocol.h"
+#include "distributed/socket.h"
+#include "image/framebuffer.h"
+#include "path-tracer/path_tracer.h"
+#include "stats/trace.h"
+
+// Seconds between checks for the end of the render while waiting for connections
+const double ACCEPT_POLL_SECONDS = 0.1;
+
+/*	Seconds a peer may take to send HELLO once connected. Unlike the job timeout it is always 
+	finite, so that a silent connection cannot keep the render from finishing */
+const double HANDSHAKE_TIMEOUT_SECONDS = 10.0;
+
+namespace distributed
+{
+	// ============================================================================
+	// =============================== CONSTRUCTOR ================================
+	// ============================================================================
+
+	Coordinator::Coordinator(const Path_Tracer& path_tracer, int passes_per_job, int tiles_per_job) :
+		m_width(path_tracer.resolution_width()),
+		m_height(path_tracer.resolution_height()),
+		m_tile_size(path_tracer.tile_size()),
+		m_job_timeout(DEFAULT_JOB_TIMEOUT),
+		m_framebuffer(nullptr),
+		m_remaining_jobs(0),
+		m_reissued_jobs(0)
+	{
+		if (passes_per_job < 0)
+			throw std::invalid_argument("Number of passes per job must be non-negative");
+		if (tiles_per_job < 0)
+			throw std::invalid_argument("Number of tiles per job must be non-negative");
+
+		const int num_passes = path_tracer.max_passes();
+		const int job_passes = passes_per_job == 0 ? num_passes : std::min(passes_per_job, num_passes);
+		const int tiles_per_row = (m_width + m_tile_size - 1) / m_tile_size;
+		const int num_tile_rows = (m_height + m_tile_size - 1) / m_tile_size;
+		const int job_tiles = tiles_per_job == 0 ? tiles_per_row : std::min(tiles_per_job, tiles_per_row);
+
+		// Every tile gets its first passes before any tile gets more
+		for (int first_pass = 0; first_pass < num_passes; first_pass += job_passes)
+		{
+			for (int tile_row = 0; tile_row < num_tile_rows; ++tile_row)
+			{
+				for (int tile_col = 0; tile_col < tiles_per_row; tile_col += job_tiles)
+				{
+					Job job;
+					job.id = (std::int32_t) m_jobs.size();
+					job.tile = tile_row * tiles_per_row + tile_col;
+					job.num_tiles = std::min(job_tiles, tiles_per_row - tile_col);
+					job.first_pass = first_pass;
+					job.num_passes = std::min(job_passes, num_passes - first_pass);
+					job.seed = path_tracer.seed();
+					m_jobs.push_back(job);
+				}
+			}
+		}
+	}
+
+	void Coordinator::set_job_timeout(double seconds)
+	{
+		if (seconds < 0)
+			throw std::invalid_argument("Job timeout must be non-negative");
+		m_job_timeout = seconds;
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ============================ RENDER FUNCTIONS ==============================
+	// ============================================================================
+
+	void Coordinator::render(Socket& listener, Framebuffer& framebuffer)
+	{
+		framebuffer = Framebuffer(m_width, m_height, m_tile_size);
+
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_framebuffer = &framebuffer;
+			m_pending_jobs.clear();
+			for (const Job& job : m_jobs)
+				m_pending_jobs.push_back(job.id);
+			m_merged_jobs.assign(m_jobs.size(), 0);
+			m_remaining_jobs = (int) m_jobs.size();
+			m_reissued_jobs = 0;
+		}
+
+		std::vector<std::thread> workers;
+
+		while (true)
+		{
+			{
+				std::lock_guard<std::mutex> guard(m_lock);
+				if (m_remaining_jobs == 0)
+					break;
+			}
+
+			if (!listener.wait_readable(ACCEPT_POLL_SECONDS))
+				continue;
+
+			workers.push_back(std::thread(&Coordinator::serve, this, listener.accept()));
+		}
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		m_framebuffer = nullptr;
+
+		if (PRINT_PROGRESS)
+			std::cout << std::endl << "Distributed render: " << m_jobs.size() << " jobs, " 
+				<< workers.size() << " worker connections, " << m_reissued_jobs 
+				<< " jobs reissued" << std::endl;
+	}
+
+	void Coordinator::serve(Socket socket)
+	{
+		TRACE_THREAD_NAME("worker connection");
+		socket.set_receive_timeout(HANDSHAKE_TIMEOUT_SECONDS);
+
+		Message_Type type;
+		std::string payload;
+
+		if (!receive_message(socket, type, payload) || type != HELLO || payload.size() != sizeof(std::uint32_t)
+			|| *reinterpret_cast<const std::uint32_t*>(payload.data()) != PROTOCOL_VERSION)
+			return;
+
+		socket.set_receive_timeout(m_job_timeout);
+
+		Job job;
+
+		while (take_job(job))
+		{
+			TRACE_SPAN("job", "distributed");
+			const std::string job_payload(reinterpret_cast<const char*>(&job), sizeof(job));
+
+			if (!send_message(socket, JOB, job_payload) || !receive_message(socket, type, payload) 
+				|| type != RESULT || !merge_result(job, payload))
+			{
+				reissue_job(job);
+				return;
+			}
+		}
+
+		send_message(socket, SHUTDOWN, std::string());
+	}
+
+	bool Coordinator::take_job(Job& job)
+	{
+		TRACE_SPAN("job wait", "wait");
+		std::unique_lock<std::mutex> guard(m_lock);
+
+		// Jobs in flight may come back if their workers are dropped
+		m_job_available.wait(guard, [this]() { return !m_pending_jobs.empty() || m_remaining_jobs == 0; });
+
+		if (m_remaining_jobs == 0)
+			return false;
+
+		job = m_jobs[m_pending_jobs.front()];
+		m_pending_jobs.pop_front();
+		return true;
+	}
+
+	void Coordinator::reissue_job(const Job& job)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_pending_jobs.push_front(job.id);
+			++m_reissued_jobs;
+		}
+		m_job_available.notify_one();
+	}
+
+	bool Coordinator::merge_result(const Job& job, const std::string& payload)
+	{
+		std::istringstream in(payload, std::ios::binary);
+		std::int32_t job_id = -1;
+		in.read(reinterpret_cast<char*>(&job_id), sizeof(job_id));
+
+		if (!in || job_id != job.id)
+			return false;
+
+		Framebuffer result;
+
+		try
+		{
+			result.read(in);
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+
+		// The result must hold exactly the job's tiles
+		const int tiles_per_row = (m_width + m_tile_size - 1) / m_tile_size;
+		const int row_begin = (job.tile / tiles_per_row) * m_tile_size;
+		const int col_begin = (job.tile % tiles_per_row) * m_tile_size;
+
+		if (result.row_offset() != row_begin || result.col_offset() != col_begin
+			|| result.height() != std::min(m_tile_size, m_height - row_begin)
+			|| result.width() != std::min(job.num_tiles * m_tile_size, m_width - col_begin)
+			|| result.extra_channels() != m_framebuffer->extra_channels())
+			return false;
+
+		int remaining_jobs;
+		{
+			TRACE_SPAN("merge", "distributed");
+			std::lock_guard<std::mutex> guard(m_lock);
+
+			if (!m_merged_jobs[job.id])
+			{
+				m_framebuffer->merge_region(result);
+				m_merged_jobs[job.id] = 1;
+				--m_remaining_jobs;
+			}
+			remaining_jobs = m_remaining_jobs;
+
+			// Under the lock, so that the progress lines of the connections do not interleave
+			if (PRINT_PROGRESS)
+				std::cout << '\r' << "Jobs: " << m_jobs.size() - remaining_jobs << " / " << m_jobs.size()
+					<< std::flush;
+		}
+
+		// Idle workers wait for jobs in flight; they can stop once everything is merged
+		if (remaining_jobs == 0)
+			m_job_available.notify_all();
+
+		return true;
+	}
+
+	// ============================================================================
+}
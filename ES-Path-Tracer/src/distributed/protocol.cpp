@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <string>
+
+#include "distributed/protocol.h"
+#include "distributed/socket.h"
+
+namespace distributed
+{
+	struct Message_Header {
+		std::uint32_t type;
+		std::uint32_t padding;
+		std::uint64_t payload_size;
+	};
+
+	// ============================================================================
+	// ============================ MESSAGE FUNCTIONS =============================
+	// ============================================================================
+
+	bool send_message(Socket& socket, Message_Type type, const std::string& payload)
+	{
+		Message_Header header;
+		header.type = type;
+		header.padding = 0;
+		header.payload_size = payload.size();
+
+		return socket.send_all(&header, sizeof(header)) 
+			&& socket.send_all(payload.data(), payload.size());
+	}
+
+	bool receive_message(Socket& socket, Message_Type& type, std::string& payload)
+	{
+		Message_Header header;
+
+		if (!socket.receive_all(&header, sizeof(header)))
+			return false;
+
+		if (header.type < HELLO || header.type > SHUTDOWN || header.payload_size > MAX_PAYLOAD_SIZE)
+			return false;
+
+		type = (Message_Type) header.type;
+		payload.resize((size_t) header.payload_size);
+
+		return payload.empty() || socket.receive_all(&payload[0], payload.size());
+	}
+
+	// ============================================================================
+}
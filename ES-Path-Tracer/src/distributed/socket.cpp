@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET native_socket;
+typedef int socket_length;
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int native_socket;
+typedef socklen_t socket_length;
+#endif
+
+#include "distributed/socket.h"
+
+// Writing to a connection closed by the peer must fail instead of raising SIGPIPE
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// Winsock must be started once per process before any socket is created
+static void start_sockets()
+{
+#ifdef _WIN32
+	static const bool started = []() {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+
+	if (!started)
+		throw std::runtime_error("Cannot start Winsock");
+#endif
+}
+
+static void close_socket(native_socket handle)
+{
+#ifdef _WIN32
+	closesocket(handle);
+#else
+	::close(handle);
+#endif
+}
+
+namespace distributed
+{
+	// ============================================================================
+	// ============================= MOVE FUNCTIONS ===============================
+	// ============================================================================
+
+	Socket::Socket(Socket&& other) : m_handle(other.m_handle)
+	{
+		other.m_handle = INVALID_HANDLE;
+	}
+
+	Socket& Socket::operator=(Socket&& other)
+	{
+		if (this != &other)
+		{
+			close();
+			m_handle = other.m_handle;
+			other.m_handle = INVALID_HANDLE;
+		}
+		return *this;
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ========================== CONNECTION FUNCTIONS ============================
+	// ============================================================================
+
+	Socket Socket::connect(const std::string& host, int port)
+	{
+		start_sockets();
+
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* addresses = nullptr;
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+			throw std::runtime_error("Cannot resolve " + host);
+
+		Socket socket;
+
+		for (addrinfo* address = addresses; address && !socket.valid(); address = address->ai_next)
+		{
+			const native_socket handle = ::socket(address->ai_family, address->ai_socktype,
+				address->ai_protocol);
+
+			if ((std::intptr_t) handle == INVALID_HANDLE)
+				continue;
+
+			if (::connect(handle, address->ai_addr, (socket_length) address->ai_addrlen) != 0)
+			{
+				close_socket(handle);
+				continue;
+			}
+
+			socket = Socket((std::intptr_t) handle);
+		}
+
+		freeaddrinfo(addresses);
+
+		if (!socket.valid())
+			throw std::runtime_error("Cannot connect to " + host + ":" + std::to_string(port));
+
+		// Messages are written whole, so there is no point in delaying small ones
+		const int no_delay = 1;
+		setsockopt((native_socket) socket.m_handle, IPPROTO_TCP, TCP_NODELAY,
+			reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+		return socket;
+	}
+
+	Socket Socket::listen(int port, int backlog)
+	{
+		start_sockets();
+
+		const native_socket handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if ((std::intptr_t) handle == INVALID_HANDLE)
+			throw std::runtime_error("Cannot create socket");
+
+		Socket socket((std::intptr_t) handle);
+
+		const int reuse_address = 1;
+		setsockopt(handle, SOL_SOCKET, SO_REUSEADDR,
+			reinterpret_cast<const char*>(&reuse_address), sizeof(reuse_address));
+
+		sockaddr_in address;
+		std::memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons((unsigned short) port);
+
+		if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+			throw std::runtime_error("Cannot bind port " + std::to_string(port));
+		if (::listen(handle, backlog) != 0)
+			throw std::runtime_error("Cannot listen on port " + std::to_string(port));
+
+		return socket;
+	}
+
+	Socket Socket::accept()
+	{
+		const native_socket handle = ::accept((native_socket) m_handle, nullptr, nullptr);
+
+		if ((std::intptr_t) handle == INVALID_HANDLE)
+			throw std::runtime_error("Cannot accept connection");
+
+		return Socket((std::intptr_t) handle);
+	}
+
+	int Socket::local_port() const
+	{
+		sockaddr_in address;
+		socket_length length = sizeof(address);
+
+		if (getsockname((native_socket) m_handle, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+			throw std::runtime_error("Cannot get socket address");
+
+		return ntohs(address.sin_port);
+	}
+
+	void Socket::close()
+	{
+		if (valid())
+			close_socket((native_socket) m_handle);
+		m_handle = INVALID_HANDLE;
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// =========================== TRANSFER FUNCTIONS =============================
+	// ============================================================================
+
+	bool Socket::wait_readable(double seconds) const
+	{
+		const int milliseconds = (int) (seconds * 1000);
+
+#ifdef _WIN32
+		WSAPOLLFD descriptor;
+		descriptor.fd = (native_socket) m_handle;
+		descriptor.events = POLLRDNORM;
+		return WSAPoll(&descriptor, 1, milliseconds) > 0;
+#else
+		pollfd descriptor;
+		descriptor.fd = (native_socket) m_handle;
+		descriptor.events = POLLIN;
+		return poll(&descriptor, 1, milliseconds) > 0;
+#endif
+	}
+
+	void Socket::set_receive_timeout(double seconds)
+	{
+#ifdef _WIN32
+		const DWORD timeout = (DWORD) (seconds * 1000);
+#else
+		timeval timeout;
+		timeout.tv_sec = (long) seconds;
+		timeout.tv_usec = (long) ((seconds - (long) seconds) * 1e6);
+#endif
+		setsockopt((native_socket) m_handle, SOL_SOCKET, SO_RCVTIMEO,
+			reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+
+	bool Socket::send_all(const void* data, size_t size)
+	{
+		const char* bytes = static_cast<const char*>(data);
+
+		while (size > 0)
+		{
+			const int chunk = (int) std::min<size_t>(size, 1 << 20);
+			const int sent = (int) send((native_socket) m_handle, bytes, chunk, SEND_FLAGS);
+
+#ifndef _WIN32
+			if (sent < 0 && errno == EINTR)
+				continue;
+#endif
+			if (sent <= 0)
+				return false;
+
+			bytes += sent;
+			size -= sent;
+		}
+
+		return true;
+	}
+
+	bool Socket::receive_all(void* data, size_t size)
+	{
+		char* bytes = static_cast<char*>(data);
+
+		while (size > 0)
+		{
+			const int chunk = (int) std::min<size_t>(size, 1 << 20);
+			const int received = (int) recv((native_socket) m_handle, bytes, chunk, 0);
+
+#ifndef _WIN32
+			if (received < 0 && errno == EINTR)
+				continue;
+#endif
+			// 0 when the peer closed the connection
+			if (received <= 0)
+				return false;
+
+			bytes += received;
+			size -= received;
+		}
+
+		return true;
+	}
+
+	// ============================================================================
+}
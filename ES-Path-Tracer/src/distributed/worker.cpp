@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "distributed/protocol.h"
+#include "distributed/socket.h"
+#include "distributed/worker.h"
+#include "image/framebuffer.h"
+#include "path-tracer/path_tracer.h"
+#include "stats/trace.h"
+
+namespace distributed
+{
+	// ============================================================================
+	// ============================= WORKER FUNCTIONS =============================
+	// ============================================================================
+
+	int Worker::run(const std::string& host, int port)
+	{
+		Socket socket = Socket::connect(host, port);
+
+		const std::string hello(reinterpret_cast<const char*>(&PROTOCOL_VERSION), sizeof(PROTOCOL_VERSION));
+		if (!send_message(socket, HELLO, hello))
+			throw std::runtime_error("Connection to the coordinator lost");
+
+		// Each job is a run of tiles of the full image, rendered for all of its passes
+		m_path_tracer.reset_crop_window();
+		m_path_tracer.set_time_budget(0);
+		m_path_tracer.set_checkpoint_filename("");
+
+		Message_Type type;
+		std::string payload;
+		int num_jobs = 0;
+
+		while (true)
+		{
+			if (!receive_message(socket, type, payload))
+				throw std::runtime_error("Connection to the coordinator lost");
+
+			if (type == SHUTDOWN)
+				return num_jobs;
+
+			if (type != JOB || payload.size() != sizeof(Job))
+				throw std::runtime_error("Unexpected message from the coordinator");
+
+			const Job& job = *reinterpret_cast<const Job*>(payload.data());
+			TRACE_SPAN("job", "distributed");
+
+			if (job.num_tiles <= 0)
+				throw std::runtime_error("Unexpected message from the coordinator");
+
+			// The pool's threads share the tiles of the job
+			std::vector<int> tiles(job.num_tiles);
+			for (int i = 0; i < job.num_tiles; ++i)
+				tiles[i] = job.tile + i;
+
+			m_path_tracer.set_seed(job.seed);
+			m_path_tracer.set_tiles(tiles);
+			m_path_tracer.set_first_pass(job.first_pass);
+			m_path_tracer.set_max_passes(job.first_pass + job.num_passes);
+
+			Framebuffer framebuffer;
+			m_path_tracer.compute_image(framebuffer);
+
+			std::ostringstream out(std::ios::binary);
+			out.write(reinterpret_cast<const char*>(&job.id), sizeof(job.id));
+			framebuffer.write(out);
+
+			if (!send_message(socket, RESULT, out.str()))
+				throw std::runtime_error("Connection to the coordinator lost");
+
+			++num_jobs;
+		}
+	}
+
+	// ============================================================================
+}
@@ -9,17 +9,7 @@
 #include "random/es_individual_random_sequence.h"
 #include "random/random_sequence.h"
 #include "shading/color3.h"
-
-// "inf quantity"
-// "none"
-const std::string FREQUENCY_COEFFICIENT = "inf quantity";
-// "maximum"
-// "norm maximum"
-// "mean"
-// "norm mean"
-// "norm mean and maximum"
-// "none"
-const std::string RADIANCE_COEFFICIENT = "norm mean";
+#include "stats/render_stats.h"
 
 namespace es
 {
@@ -27,10 +17,16 @@ namespace es
 		const Path_Tracer& path_tracer,
 		Color_Histogram* color_histogram,
 		const Ray& ray,
-		int radius)
+		const Path_Tracer::Eye_Ray_Hit& eye_ray_hit,
+		int radius,
+		Radiance_Coefficient radiance_coefficient,
+		Frequency_Coefficient frequency_coefficient)
 		: m_path_tracer(&path_tracer),
 		m_color_histogram(color_histogram),
-		m_ray(ray)
+		m_ray(ray),
+		m_eye_ray_hit(eye_ray_hit),
+		m_radiance_coefficient(radiance_coefficient),
+		m_frequency_coefficient(frequency_coefficient)
 	{
 		set_radius(radius);
 	}
@@ -49,10 +45,12 @@ namespace es
 
 	double Color_Histogram_Fitness::operator()(Individual& individual)
 	{
+		STATS_ADD(stats::FITNESS_EVALUATIONS, 1);
+
 		random::Random_Sequence& random_sequence = 
 			random::ES_Individual_Random_Sequence(individual);
 		const Radiance3& path_tracer_radiance = 
-			m_path_tracer->path_trace(m_ray, random_sequence, true);
+			m_path_tracer->path_trace(m_ray, m_eye_ray_hit, random_sequence);
 		const Radiance3& gamma_corrected_radiance = 
 			m_path_tracer->gamma_correction(path_tracer_radiance);
 
@@ -61,77 +59,57 @@ namespace es
 			(int) gamma_corrected_radiance.g,
 			(int) gamma_corrected_radiance.b);
 
-		///////////////////////////////////////////////////
-		//// Radiance coefficient
-		///////////////////////////////////////////////////
-
-		double radiance_coefficient;
-
-		if (RADIANCE_COEFFICIENT == "none")
-		{
-			radiance_coefficient = 1.0;
-		}
-		else if (RADIANCE_COEFFICIENT == "maximum")
-		{
-			const double maximum_radiance = 
-				*std::max_element(gamma_corrected_radiance.begin(), gamma_corrected_radiance.end());
-			radiance_coefficient = maximum_radiance;
-		}
-		else if (RADIANCE_COEFFICIENT == "norm maximum")
-		{
-			const double maximum_radiance =
-				*std::max_element(gamma_corrected_radiance.begin(), gamma_corrected_radiance.end());
-			radiance_coefficient = maximum_radiance / 255.0;
-		}
-		else if (RADIANCE_COEFFICIENT == "mean")
-		{
-			const double mean_radiance =
-				(gamma_corrected_radiance.r + gamma_corrected_radiance.g + gamma_corrected_radiance.b) / 3.0;
-			radiance_coefficient = mean_radiance;
-		}
-		else if (RADIANCE_COEFFICIENT == "norm mean")
-		{
-			const double mean_radiance =
-				(gamma_corrected_radiance.r + gamma_corrected_radiance.g + gamma_corrected_radiance.b) / 3.0;
-			radiance_coefficient = mean_radiance / 255.0;
-		}
-		else if (RADIANCE_COEFFICIENT == "norm mean and maximum")
-		{
-			const double maximum_radiance =
-				*std::max_element(gamma_corrected_radiance.begin(), gamma_corrected_radiance.end());
-			const double mean_radiance =
-				(gamma_corrected_radiance.r + gamma_corrected_radiance.g + gamma_corrected_radiance.b) / 3.0;
-			radiance_coefficient = (mean_radiance / 255.0) * (maximum_radiance / 255.0);
-		}
-		else
-		{
-			throw std::runtime_error("Unknown configuration");
-		}
-		
-		///////////////////////////////////////////////////
-		//// Frequency coefficient
-		///////////////////////////////////////////////////
-
 		double frequency_coefficient;
 
-		if (FREQUENCY_COEFFICIENT == "none")
+		switch (m_frequency_coefficient)
 		{
+		case NO_FREQUENCY_COEFFICIENT:
 			frequency_coefficient = 1.0;
-		}
-		else if (FREQUENCY_COEFFICIENT == "inf quantity")
-		{
-			const double information_quantity = m_color_histogram->information_quantity(
+			break;
+		case INFORMATION_QUANTITY:
+			frequency_coefficient = m_color_histogram->information_quantity(
+				(int) gamma_corrected_radiance.r,
+				(int) gamma_corrected_radiance.g,
+				(int) gamma_corrected_radiance.b,
+				m_radius);
+			break;
+		case INVERSE_INFORMATION_QUANTITY:
+			frequency_coefficient = 1.0 / m_color_histogram->information_quantity(
 				(int) gamma_corrected_radiance.r,
 				(int) gamma_corrected_radiance.g,
 				(int) gamma_corrected_radiance.b,
 				m_radius);
-			frequency_coefficient = information_quantity;
+			break;
+		default:
+			throw std::runtime_error("Unknown configuration");
 		}
-		else
+
+		return radiance_coefficient(m_radiance_coefficient, gamma_corrected_radiance) * frequency_coefficient;
+	}
+
+	double Color_Histogram_Fitness::radiance_coefficient(
+		Radiance_Coefficient coefficient,
+		const Radiance3& display_value)
+	{
+		const double maximum = std::max(display_value.r, std::max(display_value.g, display_value.b));
+		const double mean = (display_value.r + display_value.g + display_value.b) / 3.0;
+
+		switch (coefficient)
 		{
+		case NO_RADIANCE_COEFFICIENT:
+			return 1.0;
+		case MAXIMUM_RADIANCE:
+			return maximum;
+		case NORM_MAXIMUM_RADIANCE:
+			return maximum / 255.0;
+		case MEAN_RADIANCE:
+			return mean;
+		case NORM_MEAN_RADIANCE:
+			return mean / 255.0;
+		case NORM_MEAN_AND_MAXIMUM_RADIANCE:
+			return (mean / 255.0) * (maximum / 255.0);
+		default:
 			throw std::runtime_error("Unknown configuration");
 		}
-
-		return radiance_coefficient * frequency_coefficient;
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "evolution-strategy/evolution_strategy.h"
 #include "evolution-strategy/individual.h"
+#include "stats/render_stats.h"
 
 using std::logic_error;
 using std::vector;
@@ -73,6 +74,8 @@ namespace es
 
 	void Evolution_Strategy::iterate()
 	{
+		STATS_ADD(stats::GENERATIONS, 1);
+
 		vector<Individual> children;
 		vector<Individual>::size_type n_children =
 			(vector<Individual>::size_type) m_children_population_ratio * m_population_size;
@@ -18,7 +18,6 @@ using std::exp;
 using std::function;
 using std::max;
 using std::min;
-using std::mt19937;
 using std::normal_distribution;
 using std::sqrt;
 using std::uniform_real_distribution;
@@ -37,16 +36,16 @@ namespace es
         : m_fitness_fn(fitness_fn), m_valid_fitness(false)
     {
         m_data.resize(num_obj_var + 1);
-		mt19937& mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
 		
 		// Initialize the object variables
 		uniform_real_distribution<double> uniform_distribution(0.0, 1.0);
 		for (Individual::iterator it = obj_var_begin(); it != obj_var_end(); ++it)
-			*it= uniform_distribution(mt_engine);
+			*it= uniform_distribution(engine);
 		
 		// Initialize the step size
 		uniform_distribution = uniform_real_distribution<double>(MIN_STEP_SIZE, MAX_STEP_SIZE);
-		*step_size_begin() = uniform_distribution(mt_engine);
+		*step_size_begin() = uniform_distribution(engine);
     }
 
 	Evolution_Strategy::fitness_function* Individual::fitness_function() const
@@ -85,12 +84,12 @@ namespace es
 
     void Individual::mutate()
     {
-		mt19937& mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
 		normal_distribution<double> step_size_normal_dist(0.0, 0.4);
 		normal_distribution<double> obj_var_normal_dist;
         // Mutate step size
         double& step_size = *step_size_begin();
-        step_size *= exp(step_size_normal_dist(mt_engine));
+        step_size *= exp(step_size_normal_dist(engine));
         step_size = min(MAX_STEP_SIZE, max(MIN_STEP_SIZE, step_size));
 
 		// Mutate object variables
@@ -99,7 +98,7 @@ namespace es
         {
             double& value = *it;
             // Mutate the value
-            value += step_size * obj_var_normal_dist(mt_engine);
+            value += step_size * obj_var_normal_dist(engine);
             
             // Keep the values in the [0, 1] range
             while (value > 1) value -= 1;
@@ -126,10 +125,10 @@ namespace es
 		vector<double> expansion_data;
 		expansion_data.reserve(amount);
 		
-		mt19937& mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
 		uniform_real_distribution<double> uniform_dist(0.0, 1.0);
 		for (int i = 0; i < amount; ++i)
-			expansion_data.push_back(uniform_dist(mt_engine));
+			expansion_data.push_back(uniform_dist(engine));
 
 		m_data.insert(obj_var_end(), expansion_data.begin(), expansion_data.end());
 		m_valid_fitness = false;
@@ -13,11 +13,9 @@ using std::copy;
 using std::function;
 using std::logic_error;
 using std::make_pair;
-using std::mt19937;
 using std::pair;
 using std::uniform_int_distribution;
 using std::vector;
-using std::mt19937;
 
 using es::Individual;
 
@@ -75,11 +73,11 @@ namespace es
         for (vector<double>::size_type i = 0; i < size; ++i)
         {
             vector<Individual>::size_type parent1_index, parent2_index;
-			mt19937& mt_engine = random::mt_engine_singleton();
+			random::PCG32& engine = random::thread_engine();
 			// Select a first parent
-            parent1_index = indiv_dist(mt_engine);
+            parent1_index = indiv_dist(engine);
             // Select a second parent different from the first
-            while ((parent2_index = indiv_dist(mt_engine)) == parent1_index);
+            while ((parent2_index = indiv_dist(engine)) == parent1_index);
 
             // Get the selected parents
             const Individual& parent1 = population[parent1_index];
@@ -115,12 +113,12 @@ namespace es
         uniform_int_distribution<vector<Individual>::size_type> indiv_dist(0,
             m_population.size() - 1);
 
-		mt19937 mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
         // Select a first parent
-        vector<Individual>::size_type parent1_index = indiv_dist(mt_engine);
+        vector<Individual>::size_type parent1_index = indiv_dist(engine);
         // Select a second parent different from the first
         vector<Individual>::size_type parent2_index;
-        while ((parent2_index = indiv_dist(mt_engine)) == parent1_index);
+        while ((parent2_index = indiv_dist(engine)) == parent1_index);
 
         return make_pair(m_population[parent1_index], m_population[parent2_index]);
     }
@@ -9,7 +9,6 @@
 
 using std::copy;
 using std::logic_error;
-using std::mt19937;
 using std::uniform_int_distribution;
 using std::uniform_real_distribution;
 using std::vector;
@@ -34,14 +33,14 @@ namespace es {
         Individual::const_iterator end1,
 		Individual::const_iterator begin2)
     {
-		mt19937& mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
 		uniform_int_distribution<int> coin(0, 1);
         vector<double> recomb_vec;
 		
         while (begin1 != end1)
         {
             
-			if (coin(mt_engine))
+			if (coin(engine))
                 recomb_vec.push_back(*begin1);
             else
                 recomb_vec.push_back(*begin2);
@@ -58,7 +57,7 @@ namespace es {
         Individual::const_iterator end1,
 		Individual::const_iterator begin2)
     {
-		mt19937& mt_engine = random::mt_engine_singleton();
+		random::PCG32& engine = random::thread_engine();
         uniform_int_distribution<int> coin(0, 1);
         vector<double> recomb_vec;
 
@@ -66,7 +65,7 @@ namespace es {
         {
             Individual::const_iterator chosen;
 
-            if (coin(mt_engine))
+            if (coin(engine))
                 chosen = begin1;
             else
                 chosen = begin2;
@@ -161,9 +160,9 @@ namespace es {
 
         if (Recombination::random_alpha)
         {
-			mt19937& mt_engine = random::mt_engine_singleton();
+			random::PCG32& engine = random::thread_engine();
 			uniform_real_distribution<double> dist(0, 1);
-            Recombination::alpha = dist(mt_engine);
+            Recombination::alpha = dist(engine);
         }
 
         Individual& child = recombination(parent1, parent2, interpolation_recombination,
@@ -183,9 +182,9 @@ namespace es {
 
         if (Recombination::random_alpha)
         {
-			mt19937& mt_engine = random::mt_engine_singleton();
+			random::PCG32& engine = random::thread_engine();
             uniform_real_distribution<double> dist(0, 1);
-			Recombination::alpha = dist(mt_engine);
+			Recombination::alpha = dist(engine);
         }
 
         Individual& child = recombination(parent1, parent2, discrete_recombination,
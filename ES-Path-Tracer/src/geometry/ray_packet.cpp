@@ -0,0 +1,191 @@
+#include "geometry/ray.h"
+#include "geometry/ray_packet.h"
+#include "geometry/triangle.h"
+#include "geometry/vector3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Ray_Packet::Ray_Packet(const Ray* rays, int num_rays) : m_size(num_rays)
+{
+	if (num_rays <= 0 || num_rays > SIZE)
+		throw std::invalid_argument("Invalid number of rays");
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		// Unused lanes replicate the first ray, so that they never produce NaNs
+		const Ray& ray = rays[i < num_rays ? i : 0];
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			origin[axis][i] = ray.origin[axis];
+			direction[axis][i] = ray.direction[axis];
+		}
+	}
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// =========================== AUXILIARY FUNCTIONS ============================
+// ============================================================================
+
+Ray Ray_Packet::ray(int i) const
+{
+	Ray ray(Point3(0.0), Vector3(1, 0, 0));
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		ray.origin[axis] = origin[axis][i];
+		ray.direction[axis] = direction[axis][i];
+	}
+
+	return ray;
+}
+
+bool Ray_Packet::coherent() const
+{
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const bool positive = direction[axis][0] >= 0;
+
+		for (int i = 1; i < m_size; ++i)
+			if ((direction[axis][i] >= 0) != positive)
+				return false;
+	}
+
+	return true;
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ========================== INTERSECTION FUNCTIONS ==========================
+// ============================================================================
+
+void Ray_Packet::intersect_plane(int axis, double position, double t[SIZE]) const
+{
+	const double* o = origin[axis];
+	const double* d = direction[axis];
+
+	for (int i = 0; i < SIZE; ++i)
+		t[i] = (position - o[i]) / d[i];
+}
+
+int Ray_Packet::intersect(const AAB& aabb, int mask, double t_near[SIZE], double t_far[SIZE]) const
+{
+	/*	Same slab test as Ray::intersect, with the NaN handling always enabled. All lanes
+		are computed and the result is filtered by the mask afterwards */
+	double tmin[SIZE], tmax[SIZE];
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		const double invdir_x = 1 / direction[0][i];
+		const double tx1 = (aabb.max_x - origin[0][i]) * invdir_x;
+		const double tx2 = (aabb.min_x - origin[0][i]) * invdir_x;
+
+		tmin[i] = std::min(tx1, tx2);
+		tmax[i] = std::max(tx1, tx2);
+	}
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		const double invdir_y = 1 / direction[1][i];
+		const double ty1 = (aabb.max_y - origin[1][i]) * invdir_y;
+		const double ty2 = (aabb.min_y - origin[1][i]) * invdir_y;
+
+		tmin[i] = std::max(tmin[i], std::min(std::min(ty1, ty2), tmax[i]));
+		tmax[i] = std::min(tmax[i], std::max(std::max(ty1, ty2), tmin[i]));
+	}
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		const double invdir_z = 1 / direction[2][i];
+		const double tz1 = (aabb.max_z - origin[2][i]) * invdir_z;
+		const double tz2 = (aabb.min_z - origin[2][i]) * invdir_z;
+
+		tmax[i] = std::min(tmax[i], std::max(std::max(tz1, tz2), tmin[i]));
+		tmin[i] = std::max(tmin[i], std::min(std::min(tz1, tz2), tmax[i]));
+	}
+
+	int hit_mask = 0;
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		if ((mask & (1 << i)) && tmax[i] >= std::max(tmin[i], 0.0))
+		{
+			t_near[i] = tmin[i];
+			t_far[i] = tmax[i];
+			hit_mask |= 1 << i;
+		}
+	}
+
+	return hit_mask;
+}
+
+int Ray_Packet::intersect(const Triangle& tri, int mask, double t[SIZE]) const
+{
+	/*	Same Moller-Trumbore test as Ray::intersect. The triangle edges are shared by all
+		lanes, and only the ray-dependent terms are computed per lane */
+	const Point3 &v0 = *tri.vertex(0);
+	const Vector3 e1(v0, *tri.vertex(1));
+	const Vector3 e2(v0, *tri.vertex(2));
+
+	static const double epsilon = 10e-7f;
+	static const double epsilon2 = 10e-10;
+
+	double dist[SIZE];
+	bool valid[SIZE];
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		// q = direction x e2
+		const double qx = (direction[1][i] * e2.z) - (direction[2][i] * e2.y);
+		const double qy = (direction[2][i] * e2.x) - (direction[0][i] * e2.z);
+		const double qz = (direction[0][i] * e2.y) - (direction[1][i] * e2.x);
+
+		const double a = (e1.x * qx) + (e1.y * qy) + (e1.z * qz);
+
+		// s = origin - v0, r = s x e1
+		const double sx = origin[0][i] - v0.x;
+		const double sy = origin[1][i] - v0.y;
+		const double sz = origin[2][i] - v0.z;
+
+		const double rx = (sy * e1.z) - (sz * e1.y);
+		const double ry = (sz * e1.x) - (sx * e1.z);
+		const double rz = (sx * e1.y) - (sy * e1.x);
+
+		// Barycentric vertex weights
+		const double w1 = ((sx * qx) + (sy * qy) + (sz * qz)) / a;
+		const double w2 = ((direction[0][i] * rx) + (direction[1][i] * ry) + (direction[2][i] * rz)) / a;
+		const double w0 = 1 - (w1 + w2);
+
+		dist[i] = ((e2.x * rx) + (e2.y * ry) + (e2.z * rz)) / a;
+		valid[i] = !(std::abs(a) <= epsilon || w0 < -epsilon2 || w1 < -epsilon2 ||
+			w2 < -epsilon2 || dist[i] <= 0);
+	}
+
+	int hit_mask = 0;
+
+	for (int i = 0; i < SIZE; ++i)
+	{
+		if ((mask & (1 << i)) && valid[i])
+		{
+			t[i] = dist[i];
+			hit_mask |= 1 << i;
+		}
+	}
+
+	return hit_mask;
+}
+
+// ============================================================================
@@ -0,0 +1,67 @@
+#include <algorithm>
+
+#include "geometry/aab.h"
+#include "geometry/ray.h"
+#include "geometry/ray_stream.h"
+
+// ============================================================================
+// ============================ STREAM FUNCTIONS ==============================
+// ============================================================================
+
+void Ray_Stream::push(const Ray& ray, int id)
+{
+	m_entries.push_back(Entry(key(ray), id, ray));
+}
+
+void Ray_Stream::sort()
+{
+	// Stable, so that rays with equal keys keep the order in which the paths pushed them
+	std::stable_sort(m_entries.begin(), m_entries.end(),
+		[](const Entry& a, const Entry& b) { return a.key < b.key; });
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// =========================== AUXILIARY FUNCTIONS ============================
+// ============================================================================
+
+unsigned long long Ray_Stream::key(const Ray& ray) const
+{
+	const unsigned long long octant =
+		(ray.direction.x < 0 ? 1 : 0) | (ray.direction.y < 0 ? 2 : 0) | (ray.direction.z < 0 ? 4 : 0);
+
+	const unsigned long long morton_code =
+		expand_bits(grid_cell(ray.origin.x, m_bounds.min_x, m_bounds.max_x))
+		| (expand_bits(grid_cell(ray.origin.y, m_bounds.min_y, m_bounds.max_y)) << 1)
+		| (expand_bits(grid_cell(ray.origin.z, m_bounds.min_z, m_bounds.max_z)) << 2);
+
+	return (octant << (3 * GRID_BITS)) | morton_code;
+}
+
+unsigned int Ray_Stream::grid_cell(double position, double min, double max) const
+{
+	static const unsigned int max_cell = (1u << GRID_BITS) - 1;
+
+	if (max <= min)
+		return 0;
+
+	// Origins outside the bounds (e.g. bumped off a bounding surface) are clamped to the border
+	const double ratio = std::min(1.0, std::max(0.0, (position - min) / (max - min)));
+	return std::min(max_cell, (unsigned int) (ratio * (max_cell + 1)));
+}
+
+unsigned long long Ray_Stream::expand_bits(unsigned int value)
+{
+	// Inserts two zero bits after each of the lower GRID_BITS bits of value
+	unsigned long long x = value & ((1u << GRID_BITS) - 1);
+	x = (x | (x << 16)) & 0x030000FFull;
+	x = (x | (x << 8)) & 0x0300F00Full;
+	x = (x | (x << 4)) & 0x030C30C3ull;
+	x = (x | (x << 2)) & 0x09249249ull;
+	return x;
+}
+
+// ============================================================================
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include "image/framebuffer.h"
+#include "shading/color3.h"
+
+// Relative luminance of linear Rec. 709 radiance
+static double luminance_of(const Radiance3& radiance)
+{
+	return 0.2126 * radiance.r + 0.7152 * radiance.g + 0.0722 * radiance.b;
+}
+
+template <typename Vector>
+static void write_values(std::ostream& out, const Vector& values)
+{
+	out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+}
+
+template <typename Vector>
+static void read_values(std::istream& in, Vector& values)
+{
+	in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(values[0]));
+}
+
+// ============================================================================
+// =============================== CONSTRUCTORS ===============================
+// ============================================================================
+
+Framebuffer::Framebuffer() : 
+	m_width(0), 
+	m_height(0), 
+	m_tile_size(DEFAULT_TILE_SIZE), 
+	m_extra_channels(0),
+	m_tiles_per_row(0),
+	m_row_offset(0),
+	m_col_offset(0)
+{
+}
+
+Framebuffer::Framebuffer(int width, int height, int tile_size, int extra_channels) :
+	m_width(width),
+	m_height(height),
+	m_tile_size(tile_size),
+	m_extra_channels(extra_channels),
+	m_row_offset(0),
+	m_col_offset(0)
+{
+	if (width <= 0 || height <= 0)
+		throw std::invalid_argument("Image dimensions must be positive");
+	if (tile_size <= 0)
+		throw std::invalid_argument("Tile size must be positive");
+	if (extra_channels < 0)
+		throw std::invalid_argument("Number of extra channels must be non-negative");
+
+	m_tiles_per_row = (width + tile_size - 1) / tile_size;
+	const int tiles_per_column = (height + tile_size - 1) / tile_size;
+	const int num_pixels = m_tiles_per_row * tiles_per_column * tile_size * tile_size;
+
+	m_data.assign(num_pixels * channels(), 0.0f);
+	m_num_samples.assign(num_pixels, 0);
+	m_num_estimates.assign(num_pixels, 0);
+	m_luminance_mean.assign(num_pixels, 0.0f);
+	m_luminance_m2.assign(num_pixels, 0.0f);
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================= PIXEL FUNCTIONS ==============================
+// ============================================================================
+
+void Framebuffer::accumulate(int row, int col, const Radiance3& radiance_sum, int num_samples)
+{
+	float* values = pixel(row, col);
+
+	for (int i = 0; i < RADIANCE_CHANNELS; ++i)
+		values[i] += (float) radiance_sum[i];
+
+	m_num_samples[index(row, col)] += num_samples;
+}
+
+void Framebuffer::add_estimate(int row, int col, const Radiance3& mean_radiance, int num_samples)
+{
+	accumulate(row, col, mean_radiance * num_samples, num_samples);
+
+	const int i = index(row, col);
+	const double luminance = luminance_of(mean_radiance);
+	const unsigned int num_estimates = ++m_num_estimates[i];
+
+	const double delta = luminance - m_luminance_mean[i];
+	m_luminance_mean[i] += (float) (delta / num_estimates);
+	m_luminance_m2[i] += (float) (delta * (luminance - m_luminance_mean[i]));
+}
+
+void Framebuffer::set(int row, int col, const Radiance3& mean_radiance, int num_samples)
+{
+	float* values = pixel(row, col);
+
+	for (int i = 0; i < RADIANCE_CHANNELS; ++i)
+		values[i] = (float) (mean_radiance[i] * num_samples);
+
+	const int i = index(row, col);
+	m_num_samples[i] = num_samples;
+	m_num_estimates[i] = 1;
+	m_luminance_mean[i] = (float) luminance_of(mean_radiance);
+	m_luminance_m2[i] = 0.0f;
+}
+
+Radiance3 Framebuffer::radiance(int row, int col) const
+{
+	const unsigned int num_samples = m_num_samples[index(row, col)];
+
+	if (num_samples == 0)
+		return Radiance3(0.0);
+
+	const float* values = pixel(row, col);
+	return Radiance3(values[0], values[1], values[2]) / num_samples;
+}
+
+double Framebuffer::luminance_variance(int row, int col) const
+{
+	const int i = index(row, col);
+
+	if (m_num_estimates[i] < 2)
+		return 0.0;
+
+	return std::max(0.0f, m_luminance_m2[i]) / (m_num_estimates[i] - 1);
+}
+
+double Framebuffer::luminance_error(int row, int col, double standard_errors) const
+{
+	const int num_estimates = m_num_estimates[index(row, col)];
+
+	if (num_estimates == 0)
+		return 0.0;
+
+	return standard_errors * std::sqrt(luminance_variance(row, col) / num_estimates);
+}
+
+float& Framebuffer::extra_channel(int row, int col, int channel)
+{
+	if (channel < 0 || channel >= m_extra_channels)
+		throw std::out_of_range("Invalid channel");
+	return pixel(row, col)[RADIANCE_CHANNELS + channel];
+}
+
+float Framebuffer::extra_channel(int row, int col, int channel) const
+{
+	if (channel < 0 || channel >= m_extra_channels)
+		throw std::out_of_range("Invalid channel");
+	return pixel(row, col)[RADIANCE_CHANNELS + channel];
+}
+
+void Framebuffer::set_offset(int row_offset, int col_offset)
+{
+	if (row_offset < 0 || col_offset < 0)
+		throw std::invalid_argument("Offsets must be non-negative");
+	m_row_offset = row_offset;
+	m_col_offset = col_offset;
+}
+
+int Framebuffer::index(int row, int col) const
+{
+	const int tile_index = (row / m_tile_size) * m_tiles_per_row + (col / m_tile_size);
+	return tile_index * m_tile_size * m_tile_size + (row % m_tile_size) * m_tile_size + (col % m_tile_size);
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================= BUFFER FUNCTIONS =============================
+// ============================================================================
+
+void Framebuffer::merge(const Framebuffer& other)
+{
+	if (other.m_width != m_width || other.m_height != m_height || 
+		other.m_tile_size != m_tile_size || other.m_extra_channels != m_extra_channels)
+		throw std::invalid_argument("Framebuffers have different layouts");
+
+	for (size_t i = 0; i < m_num_samples.size(); ++i)
+		merge_pixel((int) i, other, (int) i);
+}
+
+void Framebuffer::merge_region(const Framebuffer& region)
+{
+	if (region.m_extra_channels != m_extra_channels)
+		throw std::invalid_argument("Framebuffers have different channels");
+
+	// Overlap of both windows, in image coordinates
+	const int row_begin = std::max(m_row_offset, region.m_row_offset);
+	const int row_end = std::min(m_row_offset + m_height, region.m_row_offset + region.m_height);
+	const int col_begin = std::max(m_col_offset, region.m_col_offset);
+	const int col_end = std::min(m_col_offset + m_width, region.m_col_offset + region.m_width);
+
+	for (int row = row_begin; row < row_end; ++row)
+		for (int col = col_begin; col < col_end; ++col)
+			merge_pixel(index(row - m_row_offset, col - m_col_offset),
+				region, region.index(row - region.m_row_offset, col - region.m_col_offset));
+}
+
+void Framebuffer::merge_pixel(int i, const Framebuffer& other, int j)
+{
+	for (int channel = 0; channel < channels(); ++channel)
+		m_data[i * channels() + channel] += other.m_data[j * channels() + channel];
+
+	m_num_samples[i] += other.m_num_samples[j];
+
+	// Chan et al.'s combination of Welford accumulators
+	const double count_a = m_num_estimates[i];
+	const double count_b = other.m_num_estimates[j];
+	const double count = count_a + count_b;
+
+	if (count_b == 0)
+		return;
+
+	const double delta = other.m_luminance_mean[j] - m_luminance_mean[i];
+	m_luminance_mean[i] += (float) (delta * count_b / count);
+	m_luminance_m2[i] += (float) (other.m_luminance_m2[j] + delta * delta * count_a * count_b / count);
+	m_num_estimates[i] += other.m_num_estimates[j];
+}
+
+void Framebuffer::clear()
+{
+	std::fill(m_data.begin(), m_data.end(), 0.0f);
+	std::fill(m_num_samples.begin(), m_num_samples.end(), 0);
+	std::fill(m_num_estimates.begin(), m_num_estimates.end(), 0);
+	std::fill(m_luminance_mean.begin(), m_luminance_mean.end(), 0.0f);
+	std::fill(m_luminance_m2.begin(), m_luminance_m2.end(), 0.0f);
+}
+
+void Framebuffer::write(std::ostream& out) const
+{
+	const std::int32_t layout[6] = 
+		{ m_width, m_height, m_tile_size, m_extra_channels, m_row_offset, m_col_offset };
+	out.write(reinterpret_cast<const char*>(layout), sizeof(layout));
+
+	write_values(out, m_data);
+	write_values(out, m_num_samples);
+	write_values(out, m_num_estimates);
+	write_values(out, m_luminance_mean);
+	write_values(out, m_luminance_m2);
+}
+
+void Framebuffer::read(std::istream& in)
+{
+	std::int32_t layout[6];
+	in.read(reinterpret_cast<char*>(layout), sizeof(layout));
+
+	if (!in || layout[0] <= 0 || layout[1] <= 0 || layout[2] <= 0 || layout[3] < 0
+		|| layout[4] < 0 || layout[5] < 0)
+		throw std::runtime_error("Invalid framebuffer layout");
+
+	Framebuffer framebuffer(layout[0], layout[1], layout[2], layout[3]);
+	framebuffer.set_offset(layout[4], layout[5]);
+
+	read_values(in, framebuffer.m_data);
+	read_values(in, framebuffer.m_num_samples);
+	read_values(in, framebuffer.m_num_estimates);
+	read_values(in, framebuffer.m_luminance_mean);
+	read_values(in, framebuffer.m_luminance_m2);
+
+	if (!in)
+		throw std::runtime_error("Truncated framebuffer");
+
+	*this = std::move(framebuffer);
+}
+
+// ============================================================================
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "concurrency/thread_pool.h"
+#include "image/framebuffer.h"
+#include "image/image_writer.h"
+#include "image/tiled_exr_writer.h"
+#include "image/tone_mapper.h"
+#include "shading/color3.h"
+#include "stats/trace.h"
+
+static std::ofstream open_file(const std::string& filename)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error("Cannot write " + filename);
+	return out;
+}
+
+static void close_file(std::ofstream& out, const std::string& filename)
+{
+	out.close();
+	if (!out)
+		throw std::runtime_error("Cannot write " + filename);
+}
+
+static bool is_little_endian()
+{
+	const std::uint16_t value = 1;
+	return *reinterpret_cast<const unsigned char*>(&value) == 1;
+}
+
+namespace image_writer
+{
+	// ============================================================================
+	// ============================ WRITING FUNCTIONS =============================
+	// ============================================================================
+
+	std::string ppm_header(int width, int height)
+	{
+		return "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+	}
+
+	std::string pfm_header(int width, int height)
+	{
+		// The sign of the scale tells the byte order
+		return "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + '\n' 
+			+ (is_little_endian() ? "-1.0" : "1.0") + '\n';
+	}
+
+	void write_ppm(
+		const std::string& filename,
+		const Framebuffer& framebuffer,
+		const Tone_Mapper& tone_mapper,
+		concurrency::Thread_Pool* thread_pool)
+	{
+		std::vector<unsigned char> bytes;
+		tone_mapper.quantize_image(framebuffer, bytes, thread_pool);
+
+		std::ofstream out = open_file(filename);
+		out << ppm_header(framebuffer.width(), framebuffer.height());
+		out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		close_file(out, filename);
+	}
+
+	void write_pfm(const std::string& filename, const Framebuffer& framebuffer)
+	{
+		std::ofstream out = open_file(filename);
+		const int width = framebuffer.width();
+		const int height = framebuffer.height();
+
+		out << pfm_header(width, height);
+
+		std::vector<float> row_values(3 * width);
+
+		// Rows go from the bottom of the image to the top
+		for (int row = height - 1; row >= 0; --row)
+		{
+			for (int col = 0; col < width; ++col)
+			{
+				const Radiance3 radiance = framebuffer.radiance(row, col);
+				row_values[3 * col] = (float) radiance.r;
+				row_values[3 * col + 1] = (float) radiance.g;
+				row_values[3 * col + 2] = (float) radiance.b;
+			}
+
+			out.write(reinterpret_cast<const char*>(row_values.data()), row_values.size() * sizeof(float));
+		}
+
+		close_file(out, filename);
+	}
+
+	void write_exr(const std::string& filename, const Framebuffer& framebuffer)
+	{
+		const int tile_size = framebuffer.tile_size();
+
+		Tiled_EXR_Writer writer(filename, framebuffer.width(), framebuffer.height(), tile_size,
+			framebuffer.row_offset(), framebuffer.col_offset());
+
+		std::vector<float> tile_values(3 * tile_size * tile_size);
+
+		for (int tile_row = 0; tile_row < writer.tiles_per_column(); ++tile_row)
+		{
+			for (int tile_col = 0; tile_col < writer.tiles_per_row(); ++tile_col)
+			{
+				const int width = writer.tile_width(tile_col);
+				const int height = writer.tile_height(tile_row);
+				float* value = tile_values.data();
+
+				for (int row = tile_row * tile_size; row < tile_row * tile_size + height; ++row)
+				{
+					for (int col = tile_col * tile_size; col < tile_col * tile_size + width; ++col)
+					{
+						const Radiance3 radiance = framebuffer.radiance(row, col);
+						*value++ = (float) radiance.r;
+						*value++ = (float) radiance.g;
+						*value++ = (float) radiance.b;
+					}
+				}
+
+				writer.write_tile(tile_row, tile_col, tile_values.data());
+			}
+		}
+
+		writer.close();
+	}
+
+	std::string extension(const std::string& filename)
+	{
+		const size_t dot = filename.find_last_of('.');
+		if (dot == std::string::npos || filename.find_first_of("/\\", dot) != std::string::npos)
+			return std::string();
+
+		std::string extension = filename.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), 
+			[](char c) { return (char) std::tolower((unsigned char) c); });
+		return extension;
+	}
+
+	void write_image(
+		const std::string& filename,
+		const Framebuffer& framebuffer,
+		const Tone_Mapper& tone_mapper,
+		concurrency::Thread_Pool* thread_pool)
+	{
+		TRACE_SPAN("write image", "output");
+		const std::string format = extension(filename);
+
+		if (format == "pfm")
+			write_pfm(filename, framebuffer);
+		else if (format == "exr")
+			write_exr(filename, framebuffer);
+		else
+			write_ppm(filename, framebuffer, tone_mapper, thread_pool);
+	}
+
+	// ============================================================================
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "image/framebuffer.h"
+#include "image/image_writer.h"
+#include "image/tile_writer.h"
+#include "image/tiled_exr_writer.h"
+#include "image/tone_mapper.h"
+#include "shading/color3.h"
+#include "stats/trace.h"
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Tile_Writer::Tile_Writer(
+	const std::string& filename,
+	int width,
+	int height,
+	int tile_size,
+	int row_offset,
+	int col_offset,
+	const Tone_Mapper& tone_mapper,
+	int max_queued_tiles) :
+	m_width(width),
+	m_height(height),
+	m_tile_size(tile_size),
+	m_row_offset(row_offset),
+	m_col_offset(col_offset),
+	m_tone_mapper(tone_mapper),
+	m_max_queued_tiles(max_queued_tiles),
+	m_header_size(0),
+	m_finishing(false)
+{
+	if (max_queued_tiles <= 0)
+		throw std::invalid_argument("Maximum number of queued tiles must be positive");
+
+	const std::string extension = image_writer::extension(filename);
+
+	if (extension == "exr")
+	{
+		m_format = EXR_FORMAT;
+		m_exr_writer.reset(new Tiled_EXR_Writer(filename, width, height, tile_size, row_offset, col_offset));
+	}
+	else
+	{
+		m_format = extension == "pfm" ? PFM_FORMAT : PPM_FORMAT;
+
+		const std::string header = m_format == PFM_FORMAT 
+			? image_writer::pfm_header(width, height)
+			: image_writer::ppm_header(width, height);
+		const std::streamoff pixel_size = m_format == PFM_FORMAT ? 3 * sizeof(float) : 3;
+		m_header_size = header.size();
+
+		// The file gets its full size up front, with black pixels
+		m_out.open(filename, std::ios::binary | std::ios::trunc);
+		m_out << header;
+		m_out.seekp(m_header_size + pixel_size * width * height - 1);
+		m_out.put(0);
+
+		if (!m_out)
+			throw std::runtime_error("Cannot write " + filename);
+	}
+
+	m_thread = std::thread(&Tile_Writer::thread_code, this);
+}
+
+Tile_Writer::~Tile_Writer()
+{
+	try
+	{
+		if (m_thread.joinable())
+			finish();
+	}
+	catch (const std::exception&) {}
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================ WRITING FUNCTIONS =============================
+// ============================================================================
+
+void Tile_Writer::push(std::unique_ptr<Framebuffer> tile)
+{
+	// Pushing only takes long while the queue is full
+	TRACE_SPAN("tile queue wait", "wait");
+	std::unique_lock<std::mutex> guard(m_lock);
+
+	m_queue_changed.wait(guard, [this]() { return m_queue.size() < m_max_queued_tiles || m_error; });
+
+	if (m_error)
+		throw std::runtime_error("Tile output failed");
+
+	m_queue.push_back(std::move(tile));
+	m_queue_changed.notify_all();
+}
+
+void Tile_Writer::finish()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_finishing = true;
+	}
+	m_queue_changed.notify_all();
+	m_thread.join();
+
+	if (!m_error)
+	{
+		try
+		{
+			close();
+		}
+		catch (const std::exception&)
+		{
+			m_error = std::current_exception();
+		}
+	}
+
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+void Tile_Writer::thread_code()
+{
+	TRACE_THREAD_NAME("tile writer");
+
+	while (true)
+	{
+		std::unique_ptr<Framebuffer> tile;
+
+		{
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_queue_changed.wait(guard, [this]() { return !m_queue.empty() || m_finishing; });
+
+			if (m_queue.empty())
+				return;
+
+			tile = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		// Room for another tile
+		m_queue_changed.notify_all();
+
+		try
+		{
+			write_tile(*tile);
+		}
+		catch (const std::exception&)
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_error = std::current_exception();
+			m_queue.clear();
+			m_queue_changed.notify_all();
+			return;
+		}
+	}
+}
+
+void Tile_Writer::write_tile(const Framebuffer& tile)
+{
+	TRACE_TILE_SPAN("write tile", "output", tile.row_offset(), tile.col_offset());
+
+	// Position of the tile in the window
+	const int row_begin = tile.row_offset() - m_row_offset;
+	const int col_begin = tile.col_offset() - m_col_offset;
+
+	if (row_begin < 0 || col_begin < 0 || row_begin + tile.height() > m_height 
+		|| col_begin + tile.width() > m_width)
+		throw std::invalid_argument("Tile outside the image");
+
+	if (m_format == EXR_FORMAT)
+	{
+		if (row_begin % m_tile_size != 0 || col_begin % m_tile_size != 0
+			|| tile.width() != m_exr_writer->tile_width(col_begin / m_tile_size)
+			|| tile.height() != m_exr_writer->tile_height(row_begin / m_tile_size))
+			throw std::invalid_argument("Tile not aligned with the tiles of the file");
+
+		std::vector<float> values;
+		values.reserve(3 * tile.width() * tile.height());
+
+		for (int row = 0; row < tile.height(); ++row)
+		{
+			for (int col = 0; col < tile.width(); ++col)
+			{
+				const Radiance3 radiance = tile.radiance(row, col);
+				values.push_back((float) radiance.r);
+				values.push_back((float) radiance.g);
+				values.push_back((float) radiance.b);
+			}
+		}
+
+		m_exr_writer->write_tile(row_begin / m_tile_size, col_begin / m_tile_size, values.data());
+		return;
+	}
+
+	// One write per row of the tile, at its place in the file
+	std::vector<char> row_data;
+
+	for (int row = 0; row < tile.height(); ++row)
+	{
+		std::streamoff file_row;
+
+		if (m_format == PFM_FORMAT)
+		{
+			row_data.resize(3 * sizeof(float) * tile.width());
+			float* values = reinterpret_cast<float*>(row_data.data());
+
+			for (int col = 0; col < tile.width(); ++col)
+			{
+				const Radiance3 radiance = tile.radiance(row, col);
+				values[3 * col] = (float) radiance.r;
+				values[3 * col + 1] = (float) radiance.g;
+				values[3 * col + 2] = (float) radiance.b;
+			}
+
+			// Rows go from the bottom of the image to the top
+			file_row = m_height - 1 - (row_begin + row);
+			m_out.seekp(m_header_size + (file_row * m_width + col_begin) * (std::streamoff) (3 * sizeof(float)));
+		}
+		else
+		{
+			row_data.resize(3 * tile.width());
+			m_tone_mapper.quantize_row(tile, row, reinterpret_cast<unsigned char*>(row_data.data()));
+
+			file_row = row_begin + row;
+			m_out.seekp(m_header_size + (file_row * m_width + col_begin) * 3);
+		}
+
+		if (!m_out.write(row_data.data(), row_data.size()))
+			throw std::runtime_error("Cannot write tile");
+	}
+}
+
+void Tile_Writer::close()
+{
+	if (m_format != EXR_FORMAT)
+	{
+		m_out.close();
+		if (!m_out)
+			throw std::runtime_error("Cannot write image");
+		return;
+	}
+
+	// Tiles that were not rendered are left black
+	std::vector<float> black(3 * m_tile_size * m_tile_size, 0.0f);
+
+	for (int tile_row = 0; tile_row < m_exr_writer->tiles_per_column(); ++tile_row)
+	{
+		for (int tile_col = 0; tile_col < m_exr_writer->tiles_per_row(); ++tile_col)
+		{
+			if (!m_exr_writer->has_tile(tile_row, tile_col))
+				m_exr_writer->write_tile(tile_row, tile_col, black.data());
+		}
+	}
+
+	m_exr_writer->close();
+}
+
+// ============================================================================
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "image/tiled_exr_writer.h"
+
+// OpenEXR stores every value in little-endian byte order
+const std::uint32_t EXR_MAGIC_NUMBER = 20000630;
+// Version 2, with the flag of single-part tiled files
+const std::uint32_t EXR_VERSION = 2 | 0x200;
+const std::int32_t EXR_FLOAT_PIXELS = 2;
+const unsigned char EXR_NO_COMPRESSION = 0;
+// Tiles are stored in the order they are written, which the offset table accounts for
+const unsigned char EXR_RANDOM_Y_LINE_ORDER = 2;
+// Channels are stored in alphabetical order
+const char* const EXR_CHANNELS[] = { "B", "G", "R" };
+
+static void put_uint32(std::vector<unsigned char>& bytes, std::uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		bytes.push_back((unsigned char) (value >> (8 * i)));
+}
+
+static void put_uint64(std::vector<unsigned char>& bytes, std::uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		bytes.push_back((unsigned char) (value >> (8 * i)));
+}
+
+static void put_float(std::vector<unsigned char>& bytes, float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	put_uint32(bytes, bits);
+}
+
+static void put_string(std::vector<unsigned char>& bytes, const std::string& text)
+{
+	bytes.insert(bytes.end(), text.begin(), text.end());
+	bytes.push_back(0);
+}
+
+// Attribute header: name, type name and size of the value that follows
+static void put_attribute(
+	std::vector<unsigned char>& bytes,
+	const std::string& name,
+	const std::string& type,
+	std::uint32_t size)
+{
+	put_string(bytes, name);
+	put_string(bytes, type);
+	put_uint32(bytes, size);
+}
+
+static void put_box(std::vector<unsigned char>& bytes, int x_min, int y_min, int x_max, int y_max)
+{
+	put_uint32(bytes, (std::uint32_t) x_min);
+	put_uint32(bytes, (std::uint32_t) y_min);
+	put_uint32(bytes, (std::uint32_t) x_max);
+	put_uint32(bytes, (std::uint32_t) y_max);
+}
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Tiled_EXR_Writer::Tiled_EXR_Writer(
+	const std::string& filename,
+	int width,
+	int height,
+	int tile_size,
+	int row_offset,
+	int col_offset) :
+	m_width(width),
+	m_height(height),
+	m_tile_size(tile_size)
+{
+	if (width <= 0 || height <= 0)
+		throw std::invalid_argument("Image dimensions must be positive");
+	if (tile_size <= 0)
+		throw std::invalid_argument("Tile size must be positive");
+
+	m_tile_offsets.assign(tiles_per_row() * tiles_per_column(), 0);
+
+	std::vector<unsigned char> header;
+	put_uint32(header, EXR_MAGIC_NUMBER);
+	put_uint32(header, EXR_VERSION);
+
+	put_attribute(header, "channels", "chlist", 3 * (2 + 16) + 1);
+	for (const char* channel : EXR_CHANNELS)
+	{
+		put_string(header, channel);
+		put_uint32(header, EXR_FLOAT_PIXELS);
+		// Perceptually linear flag and reserved bytes
+		header.insert(header.end(), 4, 0);
+		// Sampling rates
+		put_uint32(header, 1);
+		put_uint32(header, 1);
+	}
+	header.push_back(0);
+
+	put_attribute(header, "compression", "compression", 1);
+	header.push_back(EXR_NO_COMPRESSION);
+
+	put_attribute(header, "dataWindow", "box2i", 16);
+	put_box(header, col_offset, row_offset, col_offset + width - 1, row_offset + height - 1);
+
+	put_attribute(header, "displayWindow", "box2i", 16);
+	put_box(header, col_offset, row_offset, col_offset + width - 1, row_offset + height - 1);
+
+	put_attribute(header, "lineOrder", "lineOrder", 1);
+	header.push_back(EXR_RANDOM_Y_LINE_ORDER);
+
+	put_attribute(header, "pixelAspectRatio", "float", 4);
+	put_float(header, 1.0f);
+
+	put_attribute(header, "screenWindowCenter", "v2f", 8);
+	put_float(header, 0.0f);
+	put_float(header, 0.0f);
+
+	put_attribute(header, "screenWindowWidth", "float", 4);
+	put_float(header, 1.0f);
+
+	// One level, rounded down
+	put_attribute(header, "tiles", "tiledesc", 9);
+	put_uint32(header, (std::uint32_t) tile_size);
+	put_uint32(header, (std::uint32_t) tile_size);
+	header.push_back(0);
+
+	header.push_back(0);
+
+	m_table_position = header.size();
+
+	// Placeholder offset table
+	header.insert(header.end(), m_tile_offsets.size() * sizeof(std::uint64_t), 0);
+
+	m_out.open(filename, std::ios::binary | std::ios::trunc);
+
+	if (!m_out.write(reinterpret_cast<const char*>(header.data()), header.size()))
+		throw std::runtime_error("Cannot write " + filename);
+}
+
+Tiled_EXR_Writer::~Tiled_EXR_Writer()
+{
+	try
+	{
+		if (m_out.is_open())
+			close();
+	}
+	catch (const std::exception&)
+	{
+		m_out.close();
+	}
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================ WRITING FUNCTIONS =============================
+// ============================================================================
+
+int Tiled_EXR_Writer::tile_width(int tile_col) const
+{
+	return std::min(m_tile_size, m_width - tile_col * m_tile_size);
+}
+
+int Tiled_EXR_Writer::tile_height(int tile_row) const
+{
+	return std::min(m_tile_size, m_height - tile_row * m_tile_size);
+}
+
+void Tiled_EXR_Writer::write_tile(int tile_row, int tile_col, const float* rgb)
+{
+	if (tile_row < 0 || tile_row >= tiles_per_column() || tile_col < 0 || tile_col >= tiles_per_row())
+		throw std::invalid_argument("Tile outside the image");
+
+	std::uint64_t& offset = m_tile_offsets[tile_row * tiles_per_row() + tile_col];
+	if (offset != 0)
+		throw std::invalid_argument("Tile already written");
+
+	const int width = tile_width(tile_col);
+	const int height = tile_height(tile_row);
+
+	m_chunk.clear();
+	put_uint32(m_chunk, (std::uint32_t) tile_col);
+	put_uint32(m_chunk, (std::uint32_t) tile_row);
+	// Level
+	put_uint32(m_chunk, 0);
+	put_uint32(m_chunk, 0);
+	put_uint32(m_chunk, (std::uint32_t) (width * height * 3 * sizeof(float)));
+
+	// Each row of the tile holds all its B values, then G, then R
+	for (int row = 0; row < height; ++row)
+	{
+		for (int channel = 2; channel >= 0; --channel)
+		{
+			for (int col = 0; col < width; ++col)
+				put_float(m_chunk, rgb[3 * (row * width + col) + channel]);
+		}
+	}
+
+	offset = (std::uint64_t) m_out.tellp();
+
+	if (!m_out.write(reinterpret_cast<const char*>(m_chunk.data()), m_chunk.size()))
+		throw std::runtime_error("Cannot write tile");
+}
+
+void Tiled_EXR_Writer::close()
+{
+	if (std::find(m_tile_offsets.begin(), m_tile_offsets.end(), 0) != m_tile_offsets.end())
+	{
+		m_out.close();
+		throw std::runtime_error("Tiles missing from the image");
+	}
+
+	std::vector<unsigned char> table;
+	for (std::uint64_t offset : m_tile_offsets)
+		put_uint64(table, offset);
+
+	m_out.seekp(m_table_position);
+	m_out.write(reinterpret_cast<const char*>(table.data()), table.size());
+	m_out.close();
+
+	if (!m_out)
+		throw std::runtime_error("Cannot write offset table");
+}
+
+// ============================================================================
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "concurrency/thread_pool.h"
+#include "image/framebuffer.h"
+#include "image/tone_mapper.h"
+#include "shading/color3.h"
+
+// Bits of the mantissa of a float below those that index the segment of its octave
+const int FRACTION_BITS = 23 - Tone_Mapper::SEGMENT_BITS;
+const std::uint32_t FRACTION_MASK = (1u << FRACTION_BITS) - 1;
+// Index, in the table, of the bits of the float 2^-MIN_EXPONENT shifted by FRACTION_BITS
+const std::uint32_t FIRST_INDEX = (std::uint32_t) (127 - Tone_Mapper::MIN_EXPONENT) << Tone_Mapper::SEGMENT_BITS;
+const int TABLE_SIZE = Tone_Mapper::MIN_EXPONENT * Tone_Mapper::SEGMENTS_PER_OCTAVE + 2;
+
+// Smallest value read from the table
+static float min_table_value()
+{
+	return std::ldexp(1.0f, -Tone_Mapper::MIN_EXPONENT);
+}
+
+/*	Display value of a radiance already scaled by the exposure. Both sides of the select are
+	computed, so that the compiler can turn loops of it into vector code */
+static inline float lookup(const float* table, float low_slope, float min_value, float scaled_radiance)
+{
+	const float value = std::min(1.0f, std::max(0.0f, scaled_radiance));
+	const float table_value = std::max(value, min_value);
+
+	std::uint32_t bits;
+	std::memcpy(&bits, &table_value, sizeof(bits));
+
+	const std::uint32_t index = (bits >> FRACTION_BITS) - FIRST_INDEX;
+	const float fraction = (float) (bits & FRACTION_MASK) * (1.0f / (FRACTION_MASK + 1));
+	const float interpolated = table[index] + fraction * (table[index + 1] - table[index]);
+
+	return value < min_value ? value * low_slope : interpolated;
+}
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Tone_Mapper::Tone_Mapper(double exposure, double gamma_exponent) :
+	m_exposure(1.0),
+	m_gamma_exponent(1.0 / 2.2)
+{
+	set_exposure(exposure);
+	set_gamma_exponent(gamma_exponent);
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================= SETTER FUNCTIONS =============================
+// ============================================================================
+
+void Tone_Mapper::set_exposure(double exposure)
+{
+	if (exposure <= 0)
+		throw std::invalid_argument("Exposure must be positive");
+	m_exposure = exposure;
+}
+
+void Tone_Mapper::set_gamma_exponent(double gamma_exponent)
+{
+	if (gamma_exponent <= 0)
+		throw std::invalid_argument("Gamma exponent must be positive");
+	m_gamma_exponent = gamma_exponent;
+	build_table();
+}
+
+void Tone_Mapper::build_table()
+{
+	m_table.resize(TABLE_SIZE);
+
+	for (int i = 0; i < TABLE_SIZE - 1; ++i)
+	{
+		const int octave = i / SEGMENTS_PER_OCTAVE;
+		const int segment = i % SEGMENTS_PER_OCTAVE;
+		const double value = std::ldexp(1.0 + (double) segment / SEGMENTS_PER_OCTAVE, octave - MIN_EXPONENT);
+		m_table[i] = (float) (255.0 * std::pow(value, m_gamma_exponent));
+	}
+
+	m_table[TABLE_SIZE - 1] = m_table[TABLE_SIZE - 2];
+	m_low_slope = m_table[0] / min_table_value();
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ============================ MAPPING FUNCTIONS =============================
+// ============================================================================
+
+float Tone_Mapper::display_value(float radiance) const
+{
+	return lookup(m_table.data(), m_low_slope, min_table_value(), radiance * (float) m_exposure);
+}
+
+Radiance3 Tone_Mapper::quantize(const Radiance3& radiance) const
+{
+	return Radiance3(
+		(int) display_value((float) radiance.r),
+		(int) display_value((float) radiance.g),
+		(int) display_value((float) radiance.b));
+}
+
+void Tone_Mapper::quantize(
+	const float* radiance_sums,
+	const unsigned int* num_samples,
+	int stride,
+	int num_pixels,
+	unsigned char* bytes) const
+{
+	const float* table = m_table.data();
+	const float low_slope = m_low_slope;
+	const float min_value = min_table_value();
+	const float exposure = (float) m_exposure;
+
+	for (int i = 0; i < num_pixels; ++i)
+	{
+		// Sums of pixels without samples are 0, whatever they are divided by
+		const float scale = exposure / (float) std::max(1u, num_samples[i]);
+		const float* sums = radiance_sums + i * stride;
+
+		for (int channel = 0; channel < 3; ++channel)
+			bytes[3 * i + channel] = (unsigned char) lookup(table, low_slope, min_value, sums[channel] * scale);
+	}
+}
+
+void Tone_Mapper::quantize_row(const Framebuffer& framebuffer, int row, unsigned char* bytes) const
+{
+	// Within a tile, the pixels of a row are contiguous
+	for (int col = 0; col < framebuffer.width(); col += framebuffer.tile_size())
+	{
+		const int index = framebuffer.index(row, col);
+		const int num_pixels = std::min(framebuffer.tile_size(), framebuffer.width() - col);
+
+		quantize(framebuffer.data() + (size_t) index * framebuffer.channels(),
+			framebuffer.sample_counts() + index, framebuffer.channels(), num_pixels, bytes + 3 * col);
+	}
+}
+
+void Tone_Mapper::quantize_image(
+	const Framebuffer& framebuffer,
+	std::vector<unsigned char>& bytes,
+	concurrency::Thread_Pool* thread_pool) const
+{
+	const size_t row_size = 3 * (size_t) framebuffer.width();
+	bytes.resize(row_size * framebuffer.height());
+
+	auto quantize_image_row = [&](int row) { quantize_row(framebuffer, row, &bytes[row * row_size]); };
+
+	if (thread_pool)
+		thread_pool->parallel_for(0, framebuffer.height(), quantize_image_row);
+	else
+	{
+		for (int row = 0; row < framebuffer.height(); ++row)
+			quantize_image_row(row);
+	}
+}
+
+// ============================================================================
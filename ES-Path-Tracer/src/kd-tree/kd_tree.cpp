@@ -1,9 +1,12 @@
 #include "geometry/ray.h"
+#include "geometry/ray_packet.h"
 #include "geometry/plane.h"
 #include "geometry/point3.h"
 #include "geometry/triangle.h"
 #include "geometry/vector3.h"
 #include "kd-tree/kd_tree.h"
+#include "stats/render_stats.h"
+#include "stats/trace.h"
 
 #include <algorithm>
 #include <cmath>
@@ -16,6 +19,15 @@ namespace kd_tree
 {    
     static const double epsilon = 10e-6;
 
+    // Number of rays in a packet mask
+    static int count_lanes(int mask)
+    {
+        int lanes = 0;
+        for (; mask; mask &= mask - 1)
+            ++lanes;
+        return lanes;
+    }
+
 
     KD_Node::~KD_Node() {}
 
@@ -46,6 +58,10 @@ namespace kd_tree
         std::stack<Stack_Element> traversal_stack;
         traversal_stack.push( Stack_Element(root, entry_t, exit_t) );
 
+        // Counted locally and added to the statistics once per ray
+        int nodes_visited = 0;
+        int triangle_tests = 0;
+
         while ( !traversal_stack.empty() )
         {
             const Stack_Element &elem = traversal_stack.top();
@@ -61,6 +77,8 @@ namespace kd_tree
 
             while ( current_middle_node = dynamic_cast<const KD_Middle_Node*>(current_node) )
             {
+                ++nodes_visited;
+
                 /*  The tree is build with splitting plane's normal being 
                     either [1, 0, 0], [0, 1, 0] or [0, 0, 1] */
                 int axis = (int) dot_prod(current_middle_node->split_plane.normal, Vector3(0, 1, 2));
@@ -100,6 +118,8 @@ namespace kd_tree
             }
 
             const std::vector<const Triangle*> &triangles = ((const KD_Leaf*)current_node)->triangles;
+            ++nodes_visited;
+            triangle_tests += (int) triangles.size();
 
             double intersection_t = INFINITY;
             const Triangle *intersection_tri = nullptr;
@@ -123,12 +143,182 @@ namespace kd_tree
 
             // Return an intersection, if found
             if (intersection_t < INFINITY)
+            {
+                STATS_ADD(stats::KD_TREE_NODES, nodes_visited);
+                STATS_ADD(stats::TRIANGLE_TESTS, triangle_tests);
                 return intersection_tri;
+            }
         }
 
+        STATS_ADD(stats::KD_TREE_NODES, nodes_visited);
+        STATS_ADD(stats::TRIANGLE_TESTS, triangle_tests);
         return nullptr;
     }
 
+    struct Packet_Stack_Element {
+        KD_Node const *node;
+        int mask;
+        double entry_t[Ray_Packet::SIZE], exit_t[Ray_Packet::SIZE];
+    };
+
+    void KD_Tree::intersect(Ray_Packet packet, int mask,
+        const Triangle* triangles[Ray_Packet::SIZE]) const
+    {
+        for (int i = 0; i < Ray_Packet::SIZE; ++i)
+            triangles[i] = nullptr;
+
+        // Add a small epsilon to zero coordinates in the ray directions, as for single rays
+        for (int axis = 0; axis < 3; ++axis)
+            for (int i = 0; i < Ray_Packet::SIZE; ++i)
+                if (packet.direction[axis][i] == 0)
+                    packet.direction[axis][i] += 1e-8;
+
+        // Rays that would visit children in different orders are traversed one by one
+        if ( !packet.coherent() )
+        {
+            for (int i = 0; i < packet.size(); ++i)
+                if (mask & (1 << i))
+                    triangles[i] = intersect(packet.ray(i));
+            return;
+        }
+
+        Packet_Stack_Element root_element;
+        root_element.node = root;
+        root_element.mask = packet.intersect(bounding_box, mask & packet.mask(),
+            root_element.entry_t, root_element.exit_t);
+
+        // Lanes whose intersection has not been found yet
+        int active_mask = root_element.mask;
+
+        std::stack<Packet_Stack_Element> traversal_stack;
+        traversal_stack.push(root_element);
+
+        // Nodes and triangles are counted once for every ray of the packet that visits them
+        long long nodes_visited = 0;
+        long long triangle_tests = 0;
+
+        while ( !traversal_stack.empty() && active_mask )
+        {
+            Packet_Stack_Element elem = traversal_stack.top();
+            traversal_stack.pop();
+
+            const KD_Node *current_node = elem.node;
+            const KD_Middle_Node *current_middle_node;
+            int current_mask = elem.mask & active_mask;
+
+            while ( current_mask && (current_middle_node = dynamic_cast<const KD_Middle_Node*>(current_node)) )
+            {
+                nodes_visited += count_lanes(current_mask);
+
+                int axis = (int) dot_prod(current_middle_node->split_plane.normal, Vector3(0, 1, 2));
+                double plane_pos = current_middle_node->split_plane.point[axis];
+
+                double t[Ray_Packet::SIZE];
+                packet.intersect_plane(axis, plane_pos, t);
+
+                // All rays share the direction sign, so any lane classifies the children
+                const KD_Node *near, *far;
+                if (packet.direction[axis][0] >= 0)
+                {
+                    near = current_middle_node->left;
+                    far = current_middle_node->right;
+                }
+                else
+                {
+                    near = current_middle_node->right;
+                    far = current_middle_node->left;
+                }
+
+                // ===== Handle t for each lane, as in the single ray traversal =====
+                Packet_Stack_Element far_elem = elem;
+                far_elem.node = far;
+                far_elem.mask = 0;
+                int near_mask = 0;
+
+                for (int i = 0; i < Ray_Packet::SIZE; ++i)
+                {
+                    const int lane = 1 << i;
+
+                    if ( !(current_mask & lane) )
+                        continue;
+
+                    if ( t[i] >= elem.exit_t[i] )
+                        near_mask |= lane;    // Skip the far node for this ray
+                    else if ( t[i] <= elem.entry_t[i] )
+                        far_elem.mask |= lane;    // Skip the near node for this ray
+                    else    // Both nodes need to be visited by this ray
+                    {
+                        near_mask |= lane;
+                        far_elem.mask |= lane;
+                        far_elem.entry_t[i] = t[i];
+                        elem.exit_t[i] = t[i];
+                    }
+                }
+
+                if ( near_mask && far_elem.mask )
+                    traversal_stack.push(far_elem);
+
+                if ( near_mask )
+                {
+                    current_node = near;
+                    current_mask = near_mask;
+                }
+                else
+                {
+                    current_node = far;
+                    current_mask = far_elem.mask;
+                }
+                // ==================================================================
+            }
+
+            if ( !current_mask )
+                continue;
+
+            const std::vector<const Triangle*> &leaf_triangles = ((const KD_Leaf*)current_node)->triangles;
+            const int num_lanes = count_lanes(current_mask);
+            nodes_visited += num_lanes;
+            triangle_tests += (long long) num_lanes * leaf_triangles.size();
+
+            double intersection_t[Ray_Packet::SIZE];
+            const Triangle *intersection_tri[Ray_Packet::SIZE];
+            for (int i = 0; i < Ray_Packet::SIZE; ++i)
+            {
+                intersection_t[i] = INFINITY;
+                intersection_tri[i] = nullptr;
+            }
+
+            // Intersect the rays with each object, keeping the closest one for each ray
+            for (std::vector<const Triangle*>::const_iterator it = leaf_triangles.begin();
+                it != leaf_triangles.end(); ++it)
+            {
+                double current_tri_t[Ray_Packet::SIZE];
+                int hit_mask = packet.intersect(**it, current_mask, current_tri_t);
+
+                for (int i = 0; i < Ray_Packet::SIZE; ++i)
+                {
+                    if ( (hit_mask & (1 << i)) && current_tri_t[i] < intersection_t[i] )
+                    {
+                        intersection_t[i] = current_tri_t[i];
+                        intersection_tri[i] = *it;
+                    }
+                }
+            }
+
+            // Rays that found an intersection are done
+            for (int i = 0; i < Ray_Packet::SIZE; ++i)
+            {
+                if ( (current_mask & (1 << i)) && intersection_t[i] < INFINITY )
+                {
+                    triangles[i] = intersection_tri[i];
+                    active_mask &= ~(1 << i);
+                }
+            }
+        }
+
+        STATS_ADD(stats::KD_TREE_NODES, nodes_visited);
+        STATS_ADD(stats::TRIANGLE_TESTS, triangle_tests);
+    }
+
     // ============================================================================================
 
 
@@ -272,6 +462,13 @@ namespace kd_tree
         return region;
     }
 
+    KD_Node* KD_Tree::build_tree(const std::vector<const Triangle*>& triangles)
+    {
+        STATS_PHASE_TIMER(stats::ACCELERATOR_BUILD_PHASE);
+        TRACE_SPAN("kd-tree build", "build");
+        return rec_build_tree(triangles, bounding_box);
+    }
+
     KD_Node* KD_Tree::rec_build_tree(const std::vector<const Triangle*>& triangles, AAB region)
     {
         if ( triangles.empty() )
@@ -1,21 +1,28 @@
 #define _USE_MATH_DEFINES
 
-#define ES_PATH_TRACER
-
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <vector>
-#include <sstream>
 #include <string>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+#include "concurrency/thread_pool.h"
+#include "config/render_config.h"
+#include "distributed/coordinator.h"
+#include "distributed/socket.h"
+#include "distributed/worker.h"
 #include "geometry/point3.h"
 #include "geometry/ray.h"
 #include "geometry/triangle.h"
 #include "geometry/vector3.h"
+#include "image/framebuffer.h"
+#include "image/image_writer.h"
+#include "image/tile_writer.h"
 #include "scene/mesh_object.h"
 #include "scene/scene.h"
 #include "scene/sphere.h"
@@ -24,59 +31,193 @@
 #include "path-tracer/path_tracer.h"
 #include "path-tracer/monte_carlo_path_tracer.h"
 #include "path-tracer/evolution_strategy_path_tracer.h"
-#include "random/uniform_random_sequence.h"
-
-///////////////////////////////////////////////////////////////////////////////
-//// General parameters
-///////////////////////////////////////////////////////////////////////////////
-const int N_THREADS = 6;
-const int WIDTH_RESOLUTION = 600;
-const double WINDOW_WIDTH = 3.0;
-const double ASPECT_RATIO = 16.0 / 9.0;
-const double GAMMA_ENCODING_COEFFICIENT = 6;
-const double GAMMA_ENCODING_EXPONENT = 1.0 / 2.5;
-
-///////////////////////////////////////////////////////////////////////////////
-//// Evolution Strategy parameters
-///////////////////////////////////////////////////////////////////////////////
-const int MAX_ITERATIONS_PER_PIXEL = 10;
-const int POPULATION_SIZE = 10;
-const double CHILDREN_POPULATION_RATIO = 2.0;
-
-///////////////////////////////////////////////////////////////////////////////
-//// Vanilla Path Tracer parameters
-///////////////////////////////////////////////////////////////////////////////
-const int SAMPLES_PER_PIXEL = 200;
-
-void save_image(const std::string& filename, const std::vector<std::vector<Radiance3>>& image)
+#include "path-tracer/wavefront_path_tracer.h"
+#include "stats/render_stats.h"
+#include "stats/trace.h"
+
+// Writes the image in the format of the file's extension (.ppm, .pfm or .exr)
+void save_image(
+	const std::string& filename,
+	const Framebuffer& framebuffer,
+	const Path_Tracer& path_tracer)
+{
+	try
+	{
+		image_writer::write_image(filename, framebuffer, path_tracer.tone_mapper(), path_tracer.thread_pool());
+	}
+	catch (const std::runtime_error& exception)
+	{
+		std::cout << "ERROR: " << exception.what() << std::endl;
+	}
+}
+
+// Renders the image tile by tile, writing every tile to the file as soon as it is done
+void stream_image(const std::string& filename, Path_Tracer& path_tracer)
+{
+	try
+	{
+		Tile_Writer writer(filename, path_tracer.resolution_width(), path_tracer.resolution_height(),
+			path_tracer.tile_size(), 0, 0, path_tracer.tone_mapper());
+
+		path_tracer.stream_image([&](std::unique_ptr<Framebuffer> tile) {
+			// A failed write is reported by finish; rendering goes on meanwhile
+			try
+			{
+				writer.push(std::move(tile));
+			}
+			catch (const std::runtime_error&)
+			{
+			}
+		});
+
+		writer.finish();
+	}
+	catch (const std::runtime_error& exception)
+	{
+		std::cout << "ERROR: " << exception.what() << std::endl;
+	}
+}
+
+// Prints the render statistics and writes them to the statistics file, if any
+void report_stats(const config::Render_Config& config, const Path_Tracer& path_tracer)
 {
-	std::stringstream ss;
+	stats::Render_Stats render_stats = stats::Render_Stats::collect();
+	render_stats.set_num_pixels((long long) path_tracer.resolution_width() * path_tracer.resolution_height());
+
+	if (config.print_stats)
+		render_stats.write_table(std::cout);
 
-	int height = (int) image.size();
-	int width = (int) image.front().size();
+	if (config.stats_filename.empty())
+		return;
 
-	ss << "P3 " << width << ' ' << height << ' ' << 255 << std::endl;
+	std::ofstream out(config.stats_filename);
+	render_stats.write_json(out);
 
-	for (int y = 0; y < height; ++y)
+	if (!out)
+		std::cout << "ERROR: Cannot write " << config.stats_filename << std::endl;
+}
+
+// Writes the timeline of the threads to the trace file, if any
+void save_trace(const config::Render_Config& config)
+{
+	if (!RENDER_STATS || config.trace_filename.empty())
+		return;
+
+	try
 	{
-		ss << std::endl << "# y = " << y << std::endl;
-		for (int x = 0; x < width; ++x)
-		{
-			const Radiance3& color(image[y][x]);
-			ss << (int) color.r << ' ' << (int) color.g << ' ' << (int) color.b << std::endl;
-		}
+		stats::Trace::save(config.trace_filename);
 	}
+	catch (const std::runtime_error& exception)
+	{
+		std::cout << "ERROR: " << exception.what() << std::endl;
+	}
+}
 
-	std::ofstream ofs(filename);
+// Integrator chosen by the configuration, set up with its options
+std::unique_ptr<Path_Tracer> create_path_tracer(
+	const config::Render_Config& config,
+	const Camera* camera,
+	const scene::Scene* scene,
+	int num_threads)
+{
+	switch (config.integrator)
+	{
+	case config::Render_Config::EVOLUTION_STRATEGY_INTEGRATOR:
+	{
+		std::unique_ptr<Evolution_Strategy_Path_Tracer> path_tracer(new Evolution_Strategy_Path_Tracer(
+			camera,
+			scene,
+			config.window_width,
+			config.aspect_ratio,
+			config.resolution_width,
+			config.max_iterations_per_pixel,
+			config.children_population_ratio,
+			config.population_size,
+			config.gamma_coefficient,
+			config.gamma_exponent,
+			num_threads));
+		path_tracer->set_heuristic(config.heuristic);
+		path_tracer->set_histogram_radius(config.histogram_radius);
+		path_tracer->set_fitness_coefficients(config.fitness_radiance_coefficient, config.fitness_frequency_coefficient);
+		path_tracer->set_ranking_coefficients(config.ranking_radiance_coefficient, config.ranking_frequency_coefficient);
+		return path_tracer;
+	}
+	case config::Render_Config::MONTE_CARLO_INTEGRATOR:
+	case config::Render_Config::WAVEFRONT_INTEGRATOR:
+	{
+		std::unique_ptr<Monte_Carlo_Path_Tracer> path_tracer;
 
-	if (!(ofs << ss.str()))
-		std::cout << "ERROR: Could not write to file" << std::endl;
+		if (config.integrator == config::Render_Config::WAVEFRONT_INTEGRATOR)
+		{
+			Wavefront_Path_Tracer* wavefront_path_tracer = new Wavefront_Path_Tracer(
+				camera,
+				scene,
+				config.window_width,
+				config.aspect_ratio,
+				config.resolution_width,
+				config.samples_per_pixel,
+				config.gamma_coefficient,
+				config.gamma_exponent,
+				num_threads);
+			path_tracer.reset(wavefront_path_tracer);
+			wavefront_path_tracer->set_wavefront_size(config.wavefront_size);
+		}
+		else
+		{
+			path_tracer.reset(new Monte_Carlo_Path_Tracer(
+				camera,
+				scene,
+				config.window_width,
+				config.aspect_ratio,
+				config.resolution_width,
+				config.samples_per_pixel,
+				config.gamma_coefficient,
+				config.gamma_exponent,
+				num_threads));
+		}
 
-	ofs.close();
+		path_tracer->set_sampler(config.sampler);
+		path_tracer->set_sort_secondary_rays(config.sort_secondary_rays);
+		return path_tracer;
+	}
+	default:
+		throw std::invalid_argument("Unknown integrator");
+	}
 }
 
-int main()
+/*	Renders the scene with the options of the command line (see config::Render_Config::usage). 
+	Distributed renders run one process with --mode=coordinator and any number of processes with
+	--mode=worker, which must get the same scene and options. The last line of the output holds
+	the timings of the run, for benchmark scripts */
+int main(int argc, char* argv[])
 {
+	std::chrono::time_point<std::chrono::steady_clock> start_instant = std::chrono::steady_clock::now();
+
+	config::Render_Config config;
+
+	try
+	{
+		config.parse_command_line(argc, argv);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "Error: " << exception.what() << std::endl << std::endl << config::Render_Config::usage();
+		return -1;
+	}
+
+	if (config.help)
+	{
+		std::cout << config::Render_Config::usage();
+		return 0;
+	}
+
+	TRACE_THREAD_NAME("main");
+	if (RENDER_STATS && !config.trace_filename.empty())
+		stats::Trace::enable();
+
+	concurrency::Thread_Pool thread_pool(config.num_threads, config.pin_threads);
+
+	std::chrono::time_point<std::chrono::steady_clock> scene_instant = std::chrono::steady_clock::now();
 	const float ground_y = -1.f;
 	scene::Scene scene;
 	std::vector<Point3> points = {
@@ -210,46 +351,130 @@ int main()
 	for (scene::Object* obj : objects)
 		scene.add_object(obj);
 
-	random::Uniform_Random_Sequence random_seq;
+	scene.finalize();
+
+	STATS_PHASE_TIME(stats::SCENE_BUILD_PHASE, 
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - scene_instant).count());
 
 	Camera camera(Point3(0, 1, 6), Vector3(0, -0.1, -1), Vector3(0, 1, 0), 3);
 	
-#ifdef ES_PATH_TRACER
-	Path_Tracer& path_tracer = Evolution_Strategy_Path_Tracer(
-		&camera,
-		&scene,
-		WINDOW_WIDTH,
-		ASPECT_RATIO,
-		WIDTH_RESOLUTION,
-		MAX_ITERATIONS_PER_PIXEL,
-		CHILDREN_POPULATION_RATIO,
-		POPULATION_SIZE,
-		GAMMA_ENCODING_COEFFICIENT,
-		GAMMA_ENCODING_EXPONENT,
-		N_THREADS);
-#else
-	Path_Tracer& path_tracer = Monte_Carlo_Path_Tracer(
-		&camera,
-		&scene,
-		WINDOW_WIDTH,
-		ASPECT_RATIO,
-		WIDTH_RESOLUTION,
-		SAMPLES_PER_PIXEL,
-		GAMMA_ENCODING_COEFFICIENT,
-		GAMMA_ENCODING_EXPONENT,
-		N_THREADS);
-#endif
+	std::unique_ptr<Path_Tracer> path_tracer_pointer;
+
+	try
+	{
+		path_tracer_pointer = create_path_tracer(config, &camera, &scene, thread_pool.num_threads());
+	}
+	catch (const std::invalid_argument& exception)
+	{
+		std::cerr << "Error: " << exception.what() << std::endl;
+		return -1;
+	}
+
+	Path_Tracer& path_tracer = *path_tracer_pointer;
+
+	try
+	{
+		path_tracer.set_thread_pool(&thread_pool);
+		path_tracer.set_tile_size(config.tile_size);
+		path_tracer.set_max_bounces(config.max_bounces);
+		path_tracer.set_roulette_min_bounces(config.roulette_min_bounces);
+		path_tracer.set_roulette_threshold(config.roulette_threshold);
+		path_tracer.set_light_selection(config.light_selection);
+		path_tracer.set_max_passes(config.max_passes);
+		path_tracer.set_time_budget(config.time_budget);
+		path_tracer.set_adaptive_threshold(config.adaptive_threshold);
+		path_tracer.set_adaptive_min_passes(config.adaptive_min_passes);
+		path_tracer.set_checkpoint_filename(config.checkpoint_filename);
+		path_tracer.set_checkpoint_interval(config.checkpoint_interval);
+		if (config.has_seed)
+			path_tracer.set_seed(config.seed);
+	}
+	catch (const std::invalid_argument& exception)
+	{
+		std::cerr << "Error: " << exception.what() << std::endl;
+		return -1;
+	}
+
+	if (config.mode == config::Render_Config::WORKER_MODE)
+	{
+		distributed::Worker worker(path_tracer);
+		int num_jobs = 0;
+
+		try
+		{
+			num_jobs = worker.run(config.host, config.port);
+		}
+		catch (const std::runtime_error& exception)
+		{
+			std::cerr << "Error: " << exception.what() << std::endl;
+			return -1;
+		}
+
+		std::cout << "Jobs rendered: " << num_jobs << std::endl;
+		save_trace(config);
+		return 0;
+	}
+
+	const std::string& filename = config.output_filename;
+	const bool streamed = config.stream && !config.resume
+		&& config.mode == config::Render_Config::LOCAL_MODE;
+
+	// Intermediate images can be looked at while the render goes on
+	if (config.max_passes > 1 && config.mode == config::Render_Config::LOCAL_MODE && !streamed)
+		path_tracer.set_pass_callback([&](const Framebuffer& framebuffer, int) {
+			save_image(filename, framebuffer, path_tracer);
+		});
 
 	std::chrono::time_point<std::chrono::steady_clock> begin_instant = std::chrono::steady_clock::now();
-	std::vector<std::vector<Radiance3>> image;
-	path_tracer.compute_image(image);
+	Framebuffer framebuffer;
+	if (config.mode == config::Render_Config::COORDINATOR_MODE)
+	{
+		try
+		{
+			distributed::Socket listener = distributed::Socket::listen(config.port);
+			distributed::Coordinator coordinator(path_tracer, config.passes_per_job, config.tiles_per_job);
+			coordinator.set_job_timeout(config.job_timeout);
+			coordinator.render(listener, framebuffer);
+		}
+		catch (const std::exception& exception)
+		{
+			std::cerr << "Error: " << exception.what() << std::endl;
+			return -1;
+		}
+	}
+	else if (config.resume)
+		path_tracer.resume_image(framebuffer, config.checkpoint_filename);
+	// Streamed tiles are already in the file once the render ends
+	else if (streamed)
+		stream_image(filename, path_tracer);
+	else
+		path_tracer.compute_image(framebuffer);
 	std::chrono::time_point<std::chrono::steady_clock> end_instant = std::chrono::steady_clock::now();
 
 	long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_instant - begin_instant).count();
 	std::cout << "Elapsed run time: " << elapsed << std::endl;
 
-	std::string filename = "result_image.ppm";
-	save_image(filename, image);
+	if (!streamed)
+		save_image(filename, framebuffer, path_tracer);
+	std::chrono::time_point<std::chrono::steady_clock> saved_instant = std::chrono::steady_clock::now();
+
+	STATS_PHASE_TIME(stats::RENDER_PHASE, std::chrono::duration<double>(end_instant - begin_instant).count());
+	STATS_PHASE_TIME(stats::OUTPUT_PHASE, std::chrono::duration<double>(saved_instant - end_instant).count());
+
+	if (RENDER_STATS && (config.print_stats || !config.stats_filename.empty()))
+		report_stats(config, path_tracer);
+	save_trace(config);
+
+	// One line of name=value pairs, in milliseconds
+	std::cout << "timing"
+		<< " setup_ms=" << std::chrono::duration_cast<std::chrono::milliseconds>(begin_instant - start_instant).count()
+		<< " render_ms=" << elapsed
+		<< " save_ms=" << std::chrono::duration_cast<std::chrono::milliseconds>(saved_instant - end_instant).count()
+		<< " total_ms=" << std::chrono::duration_cast<std::chrono::milliseconds>(saved_instant - start_instant).count()
+		<< std::endl;
+
+	if (!config.display)
+		return 0;
 
 	cv::Mat img_file = cv::imread(filename);
 
@@ -263,4 +488,4 @@ int main()
 	cv::waitKey(0);
 
 	return 0;
-}
\ No newline at end of file
+}
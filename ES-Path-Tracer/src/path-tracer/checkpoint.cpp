@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include "image/framebuffer.h"
+#include "path-tracer/checkpoint.h"
+
+// Identifies checkpoint files, followed by the version of their layout
+static const char MAGIC[8] = { 'E', 'S', 'P', 'T', 'C', 'K', 'P', 'T' };
+static const std::uint32_t VERSION = 3;
+
+// Moves source over destination, which is replaced in a single step if it exists
+static bool replace_file(const std::string& source, const std::string& destination)
+{
+#ifdef _WIN32
+	return MoveFileExA(source.c_str(), destination.c_str(),
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+}
+
+template <typename T>
+static void write_value(std::ostream& out, const T& value)
+{
+	out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static void read_value(std::istream& in, T& value)
+{
+	in.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+// ============================================================================
+// ============================== FILE FUNCTIONS ==============================
+// ============================================================================
+
+long long Checkpoint::save(const std::string& filename) const
+{
+	const std::string temporary_filename = filename + ".tmp";
+	long long size = 0;
+
+	{
+		std::ofstream out(temporary_filename, std::ios::binary | std::ios::trunc);
+
+		if (!out)
+			throw std::runtime_error("Cannot create " + temporary_filename);
+
+		out.write(MAGIC, sizeof(MAGIC));
+		write_value(out, VERSION);
+		write_value(out, seed);
+		write_value(out, (std::int32_t) samples_per_estimate);
+		write_value(out, (std::int32_t) next_pass);
+		write_value(out, (std::int32_t) next_tile);
+		write_value(out, elapsed_seconds);
+		framebuffer.write(out);
+		write_value(out, (std::uint64_t) converged.size());
+		out.write(reinterpret_cast<const char*>(converged.data()), converged.size());
+
+		out.flush();
+		size = (long long) out.tellp();
+
+		if (!out)
+			throw std::runtime_error("Cannot write " + temporary_filename);
+	}
+
+	if (!replace_file(temporary_filename, filename))
+	{
+		std::remove(temporary_filename.c_str());
+		throw std::runtime_error("Cannot replace " + filename);
+	}
+
+	return size;
+}
+
+void Checkpoint::load(const std::string& filename)
+{
+	std::ifstream in(filename, std::ios::binary);
+
+	if (!in)
+		throw std::runtime_error("Cannot open " + filename);
+
+	char magic[sizeof(MAGIC)];
+	std::uint32_t version = 0;
+	in.read(magic, sizeof(magic));
+	read_value(in, version);
+
+	if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+		throw std::runtime_error(filename + " is not a checkpoint");
+
+	std::int32_t samples = 0;
+	std::int32_t pass = 0;
+	std::int32_t tile = 0;
+	std::uint64_t num_pixels = 0;
+
+	read_value(in, seed);
+	read_value(in, samples);
+	read_value(in, pass);
+	read_value(in, tile);
+	read_value(in, elapsed_seconds);
+	framebuffer.read(in);
+	read_value(in, num_pixels);
+
+	if (!in || num_pixels != (std::uint64_t) framebuffer.width() * framebuffer.height())
+		throw std::runtime_error("Invalid checkpoint " + filename);
+
+	converged.resize((size_t) num_pixels);
+	in.read(reinterpret_cast<char*>(converged.data()), converged.size());
+
+	if (!in)
+		throw std::runtime_error("Truncated checkpoint " + filename);
+
+	samples_per_estimate = samples;
+	next_pass = pass;
+	next_tile = tile;
+}
+
+// ============================================================================
@@ -1,5 +1,6 @@
 #include <algorithm>  // test
 #include <iostream> // test
+#include <unordered_map>
 #include <utility>  // test
 #include <string>
 #include <stdexcept>
@@ -19,19 +20,7 @@
 #include "scene/scene.h"
 #include "shading/color3.h"
 
-#define HEURISTIC 1
-
-const int RADIUS_SIZE = 4;
-// "inv inf quantity"
-// "none"
-const std::string FREQUENCY_COEFFICIENT = "none";
-// "maximum"
-// "norm maximum"
-// "mean"
-// "norm mean"
-// "norm mean and maximum"
-// "none"
-const std::string RADIANCE_COEFFICIENT = "norm mean and maximum";
+// Colors are ranked from the highest coefficient to the lowest
 const bool DECREASING_ORDER = true;
 
 Evolution_Strategy_Path_Tracer::Evolution_Strategy_Path_Tracer(
@@ -54,7 +43,13 @@ Evolution_Strategy_Path_Tracer::Evolution_Strategy_Path_Tracer(
 		resolution_width,
 		gamma_coefficient,
 		gamma_exponent,
-		num_threads)
+		num_threads),
+	m_heuristic(HISTOGRAM_MEAN_HEURISTIC),
+	m_histogram_radius(DEFAULT_HISTOGRAM_RADIUS),
+	m_fitness_radiance_coefficient(es::Color_Histogram_Fitness::NORM_MEAN_RADIANCE),
+	m_fitness_frequency_coefficient(es::Color_Histogram_Fitness::INFORMATION_QUANTITY),
+	m_ranking_radiance_coefficient(es::Color_Histogram_Fitness::NORM_MEAN_AND_MAXIMUM_RADIANCE),
+	m_ranking_frequency_coefficient(es::Color_Histogram_Fitness::NO_FREQUENCY_COEFFICIENT)
 {
 	set_max_iterations_per_pixel(max_iterations_per_pixel);
 	set_children_population_ratio(children_population_ratio);
@@ -83,11 +78,40 @@ void Evolution_Strategy_Path_Tracer::set_population_size(int population_size)
 	m_population_size = population_size;
 }
 
-Radiance3 Evolution_Strategy_Path_Tracer::estimate_pixel_color(const Ray& ray) const
+void Evolution_Strategy_Path_Tracer::set_histogram_radius(int radius)
+{
+	if (radius <= 0)
+		throw std::invalid_argument("Histogram radius must be positive");
+	m_histogram_radius = radius;
+}
+
+void Evolution_Strategy_Path_Tracer::set_fitness_coefficients(
+	Radiance_Coefficient radiance,
+	Frequency_Coefficient frequency)
+{
+	m_fitness_radiance_coefficient = radiance;
+	m_fitness_frequency_coefficient = frequency;
+}
+
+void Evolution_Strategy_Path_Tracer::set_ranking_coefficients(
+	Radiance_Coefficient radiance,
+	Frequency_Coefficient frequency)
+{
+	m_ranking_radiance_coefficient = radiance;
+	m_ranking_frequency_coefficient = frequency;
+}
+
+Radiance3 Evolution_Strategy_Path_Tracer::estimate_pixel_color(
+	const Ray& ray,
+	const Eye_Ray_Hit& eye_ray_hit,
+	int,
+	int) const
 {
+	// Individuals carry their own random numbers, so the sample indices are not used
 	Color_Histogram color_histogram;
 	es::Evolution_Strategy::fitness_function color_histogram_fitness_function =
-		es::Color_Histogram_Fitness(*this, &color_histogram, ray, RADIUS_SIZE);
+		es::Color_Histogram_Fitness(*this, &color_histogram, ray, eye_ray_hit,
+			m_histogram_radius, m_fitness_radiance_coefficient, m_fitness_frequency_coefficient);
 	es::Evolution_Strategy::parent_selection_function global_uniform_parent_selection_function =
 		es::Parent_Selection::global_uniform_selection;
 	es::Evolution_Strategy::recombination_function hibrid_recombination_function =
@@ -112,30 +136,34 @@ Radiance3 Evolution_Strategy_Path_Tracer::estimate_pixel_color(const Ray& ray) c
 
 	evolution_strategy.evolve();
 
+	// The histogram holds gamma corrected colors, which heuristics #1 and #3 convert back to
+	// linear radiance
+	switch (m_heuristic)
+	{
 	// Heuristic #1:
 	// Return the weighted mean of all radiances gathered in the histogram
-	if (HEURISTIC == 1)
+	case HISTOGRAM_MEAN_HEURISTIC:
 	{
-		return color_histogram.weighted_mean_color();
+		return inverse_gamma_correction(color_histogram.weighted_mean_color());
 	}
 
 	// Heuristic #2:
 	// Return the mean radiance of individuals in the final population
-	if (HEURISTIC == 2)
+	case POPULATION_MEAN_HEURISTIC:
 	{
 		Radiance3 accumulator(0.0);
 		for (es::Individual individual : evolution_strategy.population())
 		{
 			random::ES_Individual_Random_Sequence individual_random_sequence(individual);
-			const Radiance3& path_tracer_radiance = path_trace(ray, individual_random_sequence, true);
+			const Radiance3& path_tracer_radiance = path_trace(ray, eye_ray_hit, individual_random_sequence);
 			accumulator += path_tracer_radiance;
 		}
-		return gamma_correction(accumulator / evolution_strategy.population_size());
+		return accumulator / evolution_strategy.population_size();
 	}
 
 	// Heuristic #3:
 	// Return the weighted mean of the most frequent colors
-	if (HEURISTIC == 3)
+	case RANKED_COLORS_HEURISTIC:
 	{
 		std::vector<int> colors;
 
@@ -145,10 +173,18 @@ Radiance3 Evolution_Strategy_Path_Tracer::estimate_pixel_color(const Ray& ray) c
 				colors.push_back(element.first);
 		}
 
+		// Coefficients are computed once per color rather than once per comparison
+		std::unordered_map<int, double> coefficients;
+		for (int color : colors)
+			coefficients[color] = ranking_coefficient(color, color_histogram);
+
 		std::sort(
 			colors.begin(),
 			colors.end(),
-			[&](int color0, int color1) { return color_compare_predicate(color0, color1, color_histogram); });
+			[&](int color0, int color1) { 
+				return DECREASING_ORDER ? coefficients[color0] > coefficients[color1] 
+					: coefficients[color0] < coefficients[color1]; 
+			});
 
 		const int reduced_size = std::max(1, int(0.99 * colors.size()));
 		colors.erase(colors.begin() + reduced_size, colors.end());
@@ -162,96 +198,43 @@ Radiance3 Evolution_Strategy_Path_Tracer::estimate_pixel_color(const Ray& ray) c
 			n_samples += occurrences;
 		}
 
-		return accumulator / n_samples;
+		return inverse_gamma_correction(accumulator / n_samples);
+	}
+
+	default:
+		throw std::runtime_error("Unknown configuration");
 	}
 }
 
-bool Evolution_Strategy_Path_Tracer::color_compare_predicate(
-	int color0,
-	int color1,
-	const Color_Histogram& color_histogram)
+double Evolution_Strategy_Path_Tracer::ranking_coefficient(
+	int color,
+	const Color_Histogram& color_histogram) const
 {
-	const Radiance3 radiance0 = color_histogram.from_hash_key(color0);
-	const Radiance3 radiance1 = color_histogram.from_hash_key(color1);
+	const Radiance3 radiance = color_histogram.from_hash_key(color);
 
-	double frequency_coefficient0;
-	double frequency_coefficient1;
+	double frequency_coefficient;
 
-	if (FREQUENCY_COEFFICIENT == "none")
-	{
-		frequency_coefficient0 = 1.0;
-		frequency_coefficient1 = 1.0;
-	}
-	else if (FREQUENCY_COEFFICIENT == "inv inf quantity")
-	{
-		const double information_quantity0 = color_histogram.information_quantity(
-			(int) radiance0.r,
-			(int) radiance0.g,
-			(int) radiance0.b);
-		const double information_quantity1 = color_histogram.information_quantity(
-			(int) radiance1.r,
-			(int) radiance1.g,
-			(int) radiance1.b);
-		frequency_coefficient0 = 1.0 / information_quantity0;
-		frequency_coefficient1 = 1.0 / information_quantity1;
-	}
-	else
-	{
-		throw std::runtime_error("Unknown configuration");
-	}
-	
-	double radiance_coefficient0;
-	double radiance_coefficient1;
-
-	if (RADIANCE_COEFFICIENT == "none")
-	{
-		radiance_coefficient0 = 1.0;
-		radiance_coefficient1 = 1.0;
-	}
-	else if (RADIANCE_COEFFICIENT == "mean")
-	{
-		const double mean_radiance0 = (radiance0.r + radiance0.g + radiance0.b) / 3.0;
-		const double mean_radiance1 = (radiance1.r + radiance1.g + radiance1.b) / 3.0;
-		radiance_coefficient0 = mean_radiance0;
-		radiance_coefficient1 = mean_radiance1;
-	}
-	else if (RADIANCE_COEFFICIENT == "norm mean")
-	{
-		const double mean_radiance0 = (radiance0.r + radiance0.g + radiance0.b) / 3.0;
-		const double mean_radiance1 = (radiance1.r + radiance1.g + radiance1.b) / 3.0;
-		radiance_coefficient0 = mean_radiance0 / 255.0;
-		radiance_coefficient1 = mean_radiance1 / 255.0;
-	}
-	else if (RADIANCE_COEFFICIENT == "maximum")
-	{
-		const double max_radiance0 = std::max(radiance0.r, std::max(radiance0.g, radiance0.b));
-		const double max_radiance1 = std::max(radiance1.r, std::max(radiance1.g, radiance1.b));
-		radiance_coefficient0 = max_radiance0;
-		radiance_coefficient1 = max_radiance1;
-	}
-	else if (RADIANCE_COEFFICIENT == "norm maximum")
-	{
-		const double max_radiance0 = std::max(radiance0.r, std::max(radiance0.g, radiance0.b));
-		const double max_radiance1 = std::max(radiance1.r, std::max(radiance1.g, radiance1.b));
-		radiance_coefficient0 = max_radiance0 / 255.0;
-		radiance_coefficient1 = max_radiance1 / 255.0;
-	}
-	else if (RADIANCE_COEFFICIENT == "norm mean and maximum")
-	{
-		const double mean_radiance0 = (radiance0.r + radiance0.g + radiance0.b) / 3.0;
-		const double mean_radiance1 = (radiance1.r + radiance1.g + radiance1.b) / 3.0;
-		const double max_radiance0 = std::max(radiance0.r, std::max(radiance0.g, radiance0.b));
-		const double max_radiance1 = std::max(radiance1.r, std::max(radiance1.g, radiance1.b));
-		radiance_coefficient0 = (mean_radiance0 / 255.0) * (max_radiance0 / 255.0);
-		radiance_coefficient1 = (mean_radiance1 / 255.0) * (max_radiance1 / 255.0);
-	}
-	else
+	switch (m_ranking_frequency_coefficient)
 	{
+	case es::Color_Histogram_Fitness::NO_FREQUENCY_COEFFICIENT:
+		frequency_coefficient = 1.0;
+		break;
+	case es::Color_Histogram_Fitness::INFORMATION_QUANTITY:
+		frequency_coefficient = color_histogram.information_quantity(
+			(int) radiance.r,
+			(int) radiance.g,
+			(int) radiance.b);
+		break;
+	case es::Color_Histogram_Fitness::INVERSE_INFORMATION_QUANTITY:
+		frequency_coefficient = 1.0 / color_histogram.information_quantity(
+			(int) radiance.r,
+			(int) radiance.g,
+			(int) radiance.b);
+		break;
+	default:
 		throw std::runtime_error("Unknown configuration");
 	}
-	
-	bool increasing_order_result = 
-		radiance_coefficient0 * frequency_coefficient0 < radiance_coefficient1 * frequency_coefficient1;
 
-	return DECREASING_ORDER ? !increasing_order_result : increasing_order_result;
-}
\ No newline at end of file
+	return es::Color_Histogram_Fitness::radiance_coefficient(m_ranking_radiance_coefficient, radiance)
+		* frequency_coefficient;
+}
@@ -1,13 +1,23 @@
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "geometry/ray.h"
 #include "path-tracer/camera.h"
 #include "path-tracer/path_tracer.h"
 #include "path-tracer/monte_carlo_path_tracer.h"
+#include "path-tracer/tile_scheduler.h"
+#include "random/halton_random_sequence.h"
+#include "random/random_sequence.h"
+#include "random/sobol_random_sequence.h"
 #include "random/uniform_random_sequence.h"
 #include "scene/scene.h"
 #include "shading/color3.h"
 
+// Largest number of paths traced together by sorted tracing, which bounds its memory
+const int MAX_SORTED_PATHS = 1 << 14;
 
 Monte_Carlo_Path_Tracer::Monte_Carlo_Path_Tracer(
 	const Camera* camera,
@@ -27,7 +37,9 @@ Monte_Carlo_Path_Tracer::Monte_Carlo_Path_Tracer(
 		resolution_width,
 		gamma_coefficient,
 		gamma_exponent,
-		num_threads)
+		num_threads),
+	m_sort_secondary_rays(false),
+	m_sampler(UNIFORM_SAMPLER)
 	{
 		set_samples_per_pixel(samples_per_pixel);
 	}
@@ -39,11 +51,77 @@ void Monte_Carlo_Path_Tracer::set_samples_per_pixel(int samples_per_pixel)
 	m_samples_per_pixel = samples_per_pixel;
 }
 
-Radiance3 Monte_Carlo_Path_Tracer::estimate_pixel_color(const Ray& ray) const
+Radiance3 Monte_Carlo_Path_Tracer::estimate_pixel_color(
+	const Ray& ray,
+	const Eye_Ray_Hit& eye_ray_hit,
+	int pixel_index,
+	int first_sample) const
 {
-	random::Uniform_Random_Sequence random_seq;
+	const std::unique_ptr<random::Random_Sequence> random_seq = create_random_sequence(pixel_index);
 	Radiance3 sample_estimate_sum = 0;
+
 	for (int i = 0; i < m_samples_per_pixel; ++i)
-		sample_estimate_sum += path_trace(ray, random_seq, true);
-	return gamma_correction(sample_estimate_sum / m_samples_per_pixel);
+	{
+		random_seq->start_sample(first_sample + i);
+		sample_estimate_sum += path_trace(ray, eye_ray_hit, *random_seq);
+	}
+	return sample_estimate_sum / m_samples_per_pixel;
+}
+
+void Monte_Carlo_Path_Tracer::render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const
+{
+	if (!m_sort_secondary_rays)
+	{
+		Path_Tracer::render_tile(tile, pass);
+		return;
+	}
+
+	std::vector<std::pair<int, int>> pixels;
+	std::vector<Ray> eye_rays;
+	std::vector<Eye_Ray_Hit> eye_ray_hits;
+	trace_eye_rays(tile, pass, pixels, eye_rays, eye_ray_hits);
+
+	const int num_pixels = (int) pixels.size();
+	const int width = resolution_width();
+
+	// Paths are interleaved, each one drawing from its own sample of its pixel's sequence
+	std::vector<std::unique_ptr<random::Random_Sequence>> random_seqs;
+	std::vector<random::Random_Sequence*> random_seq_pointers;
+	for (int i = 0; i < num_pixels; ++i)
+	{
+		random_seqs.push_back(create_random_sequence(pixels[i].first * width + pixels[i].second));
+		random_seqs.back()->start_sample(pass->first_sample);
+		random_seq_pointers.push_back(random_seqs.back().get());
+	}
+
+	// The rays of as many pixels as fit in a batch are sorted together
+	const int batch_pixels = std::max(1, MAX_SORTED_PATHS / m_samples_per_pixel);
+	std::vector<Radiance3> radiance_sums(num_pixels, Radiance3(0.0));
+
+	for (int first = 0; first < num_pixels; first += batch_pixels)
+		trace_sorted_paths(&eye_rays[first], &eye_ray_hits[first], &random_seq_pointers[first],
+			std::min(batch_pixels, num_pixels - first), m_samples_per_pixel, pass->first_sample,
+			&radiance_sums[first]);
+
+	// No other thread writes these pixels, so no lock is needed
+	for (int i = 0; i < num_pixels; ++i)
+		pass->add_estimate(pixels[i].first, pixels[i].second,
+			radiance_sums[i] / m_samples_per_pixel, m_samples_per_pixel);
+}
+
+std::unique_ptr<random::Random_Sequence> Monte_Carlo_Path_Tracer::create_random_sequence(
+	int pixel_index) const
+{
+	switch (m_sampler)
+	{
+	case SOBOL_SAMPLER:
+		return std::unique_ptr<random::Random_Sequence>(
+			new random::Sobol_Random_Sequence(seed(), pixel_index));
+	case HALTON_SAMPLER:
+		return std::unique_ptr<random::Random_Sequence>(
+			new random::Halton_Random_Sequence(seed(), pixel_index));
+	default:
+		return std::unique_ptr<random::Random_Sequence>(
+			new random::Uniform_Random_Sequence(seed(), pixel_index));
+	}
 }
@@ -3,28 +3,70 @@
 #define PRINT_PROGRESS true
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <random>
 #include <stdexcept>
 #include <string>
-#include <thread>
+#include <utility>
 #include <vector>
 
+#include "concurrency/thread_pool.h"
 #include "geometry/ray.h"
+#include "geometry/ray_packet.h"
+#include "geometry/ray_stream.h"
 #include "geometry/vector3.h"
+#include "image/framebuffer.h"
 #include "path-tracer/camera.h"
+#include "path-tracer/checkpoint.h"
 #include "path-tracer/path_tracer.h"
+#include "path-tracer/tile_scheduler.h"
 #include "random/random_number_engine.h"
 #include "random/random_sequence.h"
 #include "scene/area_light.h"
 #include "scene/scene.h"
 #include "shading/color3.h"
 #include "shading/surface_element.h"
+#include "stats/render_stats.h"
+#include "stats/trace.h"
 
-int depth = 0;
+/*	Power heuristic (exponent 2) weight of a sample taken with density pdf, when other_pdf is the
+	density of the other strategy that could have produced it */
+static double power_heuristic(double pdf, double other_pdf)
+{
+	if (pdf <= 0.0)
+		return 0.0;
+
+	return (pdf * pdf) / (pdf * pdf + other_pdf * other_pdf);
+}
+
+/*	Dimensions of the random sequence used by every vertex of a path: two to choose the light
+	triangle, two for the point on it, three to scatter (lobe and direction) and one for Russian
+	roulette. Each decision reads the same dimensions in every sample, which lets the 
+	low-discrepancy sequences stratify it */
+enum Vertex_Dimension {
+	LIGHT_SELECTION_DIMENSION = 0,
+	LIGHT_POINT_DIMENSION = 2,
+	SCATTER_DIMENSION = 4,
+	ROULETTE_DIMENSION = 7,
+	DIMENSIONS_PER_VERTEX = 8
+};
+
+const double Path_Tracer::DEFAULT_ROULETTE_THRESHOLD = 1.0;
+
+// Side of the pixel blocks into which tiles are split. Each block is traced as one ray packet
+const int BLOCK_SIDE = 2;
+static_assert(BLOCK_SIDE * BLOCK_SIDE <= Ray_Packet::SIZE, "Pixel block does not fit in a ray packet");
+
+// Largest fraction of the time between two checkpoints that may be spent writing them
+const double MAX_CHECKPOINT_OVERHEAD = 0.05;
 
 Path_Tracer::Path_Tracer(
 	const Camera* camera,
@@ -35,8 +77,20 @@ Path_Tracer::Path_Tracer(
 	double gamma_coefficient,
 	double gamma_exponent,
 	int num_threads)
-	: m_current_row(0),
-	m_current_col(0)
+	: m_max_bounces(DEFAULT_MAX_BOUNCES),
+	m_roulette_min_bounces(DEFAULT_ROULETTE_MIN_BOUNCES),
+	m_roulette_threshold(DEFAULT_ROULETTE_THRESHOLD),
+	m_seed((std::uint64_t(std::random_device()()) << 32) | std::random_device()()),
+	m_light_selection(LIGHT_HIERARCHY),
+	m_max_passes(DEFAULT_MAX_PASSES),
+	m_first_pass(0),
+	m_time_budget(0.0),
+	m_adaptive_threshold(0.0),
+	m_adaptive_min_passes(DEFAULT_ADAPTIVE_MIN_PASSES),
+	m_checkpoint_interval(DEFAULT_CHECKPOINT_INTERVAL),
+	m_tile_size(DEFAULT_TILE_SIZE),
+	m_thread_pool(nullptr),
+	m_has_crop_window(false)
 {
 	set_camera(camera);
 	set_scene(scene);
@@ -48,7 +102,7 @@ Path_Tracer::Path_Tracer(
 	set_num_threads(num_threads);
 }
 
-Path_Tracer::Path_Tracer(const Path_Tracer& other) : m_pixel_lock(), m_image_lock()
+Path_Tracer::Path_Tracer(const Path_Tracer& other) : m_tone_mapper(other.m_tone_mapper), m_progress_lock()
 {
 	set_camera(other.m_camera);
 	set_scene(other.m_scene);
@@ -56,6 +110,24 @@ Path_Tracer::Path_Tracer(const Path_Tracer& other) : m_pixel_lock(), m_image_loc
 	set_aspect_ratio(other.m_aspect_ratio);
 	set_resolution_width(other.m_resolution_width);
 	set_num_threads(other.m_num_threads);
+	set_thread_pool(other.m_thread_pool);
+	set_tile_size(other.m_tile_size);
+	set_max_bounces(other.m_max_bounces);
+	set_roulette_min_bounces(other.m_roulette_min_bounces);
+	set_roulette_threshold(other.m_roulette_threshold);
+	set_seed(other.m_seed);
+	set_light_selection(other.m_light_selection);
+	set_max_passes(other.m_max_passes);
+	set_first_pass(other.m_first_pass);
+	set_time_budget(other.m_time_budget);
+	set_pass_callback(other.m_pass_callback);
+	set_adaptive_threshold(other.m_adaptive_threshold);
+	set_adaptive_min_passes(other.m_adaptive_min_passes);
+	set_checkpoint_filename(other.m_checkpoint_filename);
+	set_checkpoint_interval(other.m_checkpoint_interval);
+	m_has_crop_window = other.m_has_crop_window;
+	m_crop_window = other.m_crop_window;
+	set_tiles(other.m_tiles);
 }
 
 void Path_Tracer::set_camera(const Camera* camera)
@@ -69,6 +141,8 @@ void Path_Tracer::set_scene(const scene::Scene* scene)
 {
 	if (!scene)
 		throw std::invalid_argument("Null pointer");
+	if (!scene->is_finalized())
+		throw std::invalid_argument("Scene lights must be finalized before rendering");
 	m_scene = scene;
 }
 
@@ -97,14 +171,14 @@ void Path_Tracer::set_gamma_coefficient(double coefficient)
 {
 	if (coefficient <= 0)
 		throw std::invalid_argument("Coefficient must be positive");
-	m_gamma_coefficient = coefficient;
+	m_tone_mapper.set_exposure(coefficient);
 }
 
 void Path_Tracer::set_gamma_exponent(double gamma_exponent)
 {
 	if (gamma_exponent <= 0)
 		throw std::invalid_argument("Exponent must be greater than 0");
-	m_gamma_exponent = gamma_exponent;
+	m_tone_mapper.set_gamma_exponent(gamma_exponent);
 }
 
 void Path_Tracer::set_num_threads(int num_threads)
@@ -112,25 +186,372 @@ void Path_Tracer::set_num_threads(int num_threads)
 	if (num_threads <= 0)
 		throw std::invalid_argument("Number of threads must be positive");
 	m_num_threads = num_threads;
+	m_own_thread_pool.reset();
+}
+
+void Path_Tracer::set_tile_size(int tile_size)
+{
+	if (tile_size <= 0)
+		throw std::invalid_argument("Tile size must be positive");
+	m_tile_size = tile_size;
+}
+
+void Path_Tracer::set_first_pass(int first_pass)
+{
+	if (first_pass < 0)
+		throw std::invalid_argument("First pass must be non-negative");
+	m_first_pass = first_pass;
+}
+
+void Path_Tracer::set_crop_window(int row_begin, int row_end, int col_begin, int col_end)
+{
+	if (row_begin < 0 || col_begin < 0 || row_end <= row_begin || col_end <= col_begin)
+		throw std::invalid_argument("Crop window must be a non-empty rectangle of the image");
+	m_crop_window.row_begin = row_begin;
+	m_crop_window.row_end = row_end;
+	m_crop_window.col_begin = col_begin;
+	m_crop_window.col_end = col_end;
+	m_has_crop_window = true;
+}
+
+void Path_Tracer::set_max_passes(int max_passes)
+{
+	if (max_passes <= 0)
+		throw std::invalid_argument("Number of passes must be positive");
+	m_max_passes = max_passes;
+}
+
+void Path_Tracer::set_time_budget(double seconds)
+{
+	if (seconds < 0)
+		throw std::invalid_argument("Time budget must be non-negative");
+	m_time_budget = seconds;
+}
+
+void Path_Tracer::set_adaptive_threshold(double threshold)
+{
+	if (!(threshold >= 0) || std::isinf(threshold))
+		throw std::invalid_argument("Roulette threshold must be finite and non-negative");
+	m_adaptive_threshold = threshold;
+}
+
+void Path_Tracer::set_adaptive_min_passes(int min_passes)
+{
+	if (min_passes < 2)
+		throw std::invalid_argument("Adaptive sampling needs at least two passes");
+	m_adaptive_min_passes = min_passes;
+}
+
+void Path_Tracer::set_checkpoint_interval(double seconds)
+{
+	if (seconds < 0)
+		throw std::invalid_argument("Checkpoint interval must be non-negative");
+	m_checkpoint_interval = seconds;
+}
+
+void Path_Tracer::set_max_bounces(int max_bounces)
+{
+	if (max_bounces < 0)
+		throw std::invalid_argument("Maximum number of bounces must be non-negative");
+	m_max_bounces = max_bounces;
+}
+
+void Path_Tracer::set_roulette_min_bounces(int min_bounces)
+{
+	if (min_bounces < 0)
+		throw std::invalid_argument("Minimum number of roulette bounces must be non-negative");
+	m_roulette_min_bounces = min_bounces;
+}
+
+void Path_Tracer::set_roulette_threshold(double threshold)
+{
+	if (!(threshold >= 0) || std::isinf(threshold))
+		throw std::invalid_argument("Roulette threshold must be finite and non-negative");
+	m_roulette_threshold = threshold;
+}
+
+void Path_Tracer::compute_image(Framebuffer& framebuffer)
+{
+	Tile_Scheduler scheduler(render_window(), m_tile_size, m_tiles);
+	const Tile_Scheduler::Tile& bounds = scheduler.bounds();
+
+	// Same tile size and origin as the scheduler, so that each tile is a contiguous block of the buffer
+	framebuffer = Framebuffer(bounds.col_end - bounds.col_begin, bounds.row_end - bounds.row_begin,
+		m_tile_size);
+	framebuffer.set_offset(bounds.row_begin, bounds.col_begin);
+
+	std::vector<unsigned char> converged(framebuffer.width() * framebuffer.height(), 0);
+	render_passes(framebuffer, scheduler, converged, m_first_pass, 0, 0.0);
+}
+
+void Path_Tracer::resume_image(Framebuffer& framebuffer, const std::string& checkpoint_filename)
+{
+	Tile_Scheduler scheduler(render_window(), m_tile_size, m_tiles);
+	const Tile_Scheduler::Tile& bounds = scheduler.bounds();
+
+	Checkpoint checkpoint;
+	checkpoint.load(checkpoint_filename);
+
+	if (checkpoint.framebuffer.width() != bounds.col_end - bounds.col_begin 
+		|| checkpoint.framebuffer.height() != bounds.row_end - bounds.row_begin
+		|| checkpoint.framebuffer.row_offset() != bounds.row_begin
+		|| checkpoint.framebuffer.col_offset() != bounds.col_begin)
+		throw std::invalid_argument("Checkpoint of another image window");
+	if (checkpoint.samples_per_estimate != samples_per_estimate())
+		throw std::invalid_argument("Checkpoint of a render with another number of samples per pass");
+	if (checkpoint.next_tile < 0 || checkpoint.next_tile >= scheduler.num_tiles())
+		throw std::invalid_argument("Checkpoint of a render with other tiles");
+
+	// The random number streams of the remaining passes follow from the seed
+	m_seed = checkpoint.seed;
+	framebuffer = std::move(checkpoint.framebuffer);
+
+	render_passes(framebuffer, scheduler, checkpoint.converged, checkpoint.next_pass, 
+		checkpoint.next_tile, checkpoint.elapsed_seconds);
+}
+
+void Path_Tracer::stream_image(const tile_callback& output)
+{
+	// Lights may have been added after set_scene
+	if (!m_scene->is_finalized())
+		throw std::invalid_argument("Scene lights must be finalized before rendering");
+
+	Tile_Scheduler scheduler(render_window(), m_tile_size, m_tiles);
+	std::atomic<long long> completed_pixels(0);
+
+	// Shared by every tile; each thread copies it to point it to its own tile
+	Pass shared_pass;
+	shared_pass.scheduler = &scheduler;
+	shared_pass.has_deadline = false;
+	shared_pass.completed_pixels = &completed_pixels;
+	shared_pass.total_pixels = (long long) std::max(0, m_max_passes - m_first_pass) * scheduler.num_pixels();
+	shared_pass.elapsed_ratio = 0.0;
+
+	concurrency::Thread_Pool* thread_pool = m_thread_pool;
+
+	if (!thread_pool)
+	{
+		if (!m_own_thread_pool)
+			m_own_thread_pool.reset(new concurrency::Thread_Pool(m_num_threads));
+		thread_pool = m_own_thread_pool.get();
+	}
+
+	thread_pool->run([&](int) {
+		Tile_Scheduler::Tile tile;
+		Pass pass = shared_pass;
+		std::vector<unsigned char> converged;
+
+		while (scheduler.next(tile))
+		{
+			TRACE_TILE_SPAN("tile", "render", tile.row_begin, tile.col_begin);
+			std::unique_ptr<Framebuffer> framebuffer(new Framebuffer(
+				tile.col_end - tile.col_begin, tile.row_end - tile.row_begin, m_tile_size));
+			framebuffer->set_offset(tile.row_begin, tile.col_begin);
+			converged.assign(tile.num_pixels(), 0);
+
+			pass.framebuffer = framebuffer.get();
+			pass.converged = nullptr;
+
+			for (int pass_index = m_first_pass; pass_index < m_max_passes; ++pass_index)
+			{
+				// Pixels are only left out after the minimum number of passes
+				if (m_adaptive_threshold > 0 && pass_index >= m_adaptive_min_passes)
+					pass.converged = &converged;
+
+				pass.first_sample = pass_index * samples_per_estimate();
+				render_tile(tile, &pass);
+				report_progress(&pass, tile.num_pixels());
+
+				if (m_adaptive_threshold > 0 && pass_index + 1 >= m_adaptive_min_passes)
+				{
+					int active_pixels = 0;
+					for (int row = 0; row < framebuffer->height(); ++row)
+						active_pixels += update_converged(*framebuffer, converged, row);
+
+					if (active_pixels == 0)
+						break;
+				}
+			}
+
+			output(std::move(framebuffer));
+		}
+	});
+
+	if (PRINT_PROGRESS)
+		std::cout << std::endl;
 }
 
-void Path_Tracer::compute_image(std::vector<std::vector<Radiance3>>& image)
+void Path_Tracer::render_passes(
+	Framebuffer& framebuffer,
+	Tile_Scheduler& scheduler,
+	std::vector<unsigned char>& converged,
+	int first_pass,
+	int first_tile,
+	double elapsed_seconds)
 {
-	const int resolution_height = (int) round(m_resolution_width / m_aspect_ratio);
-	const std::vector<Radiance3> empty_row(m_resolution_width, Radiance3(0.0));
-	image = std::vector<std::vector<Radiance3>>(resolution_height, empty_row);
+	// Lights may have been added after set_scene
+	if (!m_scene->is_finalized())
+		throw std::invalid_argument("Scene lights must be finalized before rendering");
+
+	const long long num_pixels = scheduler.num_pixels();
+	std::atomic<long long> completed_pixels((long long) std::min(first_pass, m_max_passes) * num_pixels);
+
+	// Time is counted from the start of the interrupted render, if any
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now()
+		- std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(elapsed_seconds));
+
+	Pass pass;
+	pass.framebuffer = &framebuffer;
+	pass.scheduler = &scheduler;
+	pass.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(m_time_budget));
+	pass.completed_pixels = &completed_pixels;
+	pass.converged = nullptr;
+	pass.total_pixels = (long long) m_max_passes * num_pixels;
+
+	concurrency::Thread_Pool* thread_pool = m_thread_pool;
+
+	if (!thread_pool)
+	{
+		if (!m_own_thread_pool)
+			m_own_thread_pool.reset(new concurrency::Thread_Pool(m_num_threads));
+		thread_pool = m_own_thread_pool.get();
+	}
 
-	std::vector<std::thread> threads;
-	while (threads.size() < m_num_threads)
-		threads.push_back(std::thread(&Path_Tracer::thread_code, this, &image));
+	Checkpoint checkpoint;
+	checkpoint.seed = m_seed;
+	checkpoint.samples_per_estimate = samples_per_estimate();
+
+	std::chrono::steady_clock::time_point last_checkpoint = std::chrono::steady_clock::now();
+	double checkpoint_interval = m_checkpoint_interval;
+	double checkpoint_seconds = 0.0;
+	int num_checkpoints = 0;
+	int checkpointed_passes = first_pass;
+	int checkpointed_tiles = first_tile;
+
+	/*	Writes the state after num_passes passes and num_tiles tiles of the next one, and 
+		stretches the interval to bound its cost */
+	auto save_checkpoint = [&](int num_passes, int num_tiles) {
+		TRACE_SPAN("checkpoint", "output");
+		const std::chrono::steady_clock::time_point checkpoint_start = std::chrono::steady_clock::now();
+
+		checkpoint.next_pass = num_passes;
+		checkpoint.next_tile = num_tiles;
+		checkpoint.elapsed_seconds = std::chrono::duration<double>(checkpoint_start - start).count();
+
+		// Lent to the checkpoint rather than copied
+		std::swap(checkpoint.framebuffer, framebuffer);
+		std::swap(checkpoint.converged, converged);
+
+		// A failed checkpoint does not stop the render; the previous one is left in place
+		bool saved = true;
+		try
+		{
+			checkpoint.save(m_checkpoint_filename);
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << std::endl << "Checkpoint not saved: " << error.what() << std::endl;
+			saved = false;
+		}
 
-	for (std::thread& thread : threads)
-		thread.join();
+		std::swap(checkpoint.framebuffer, framebuffer);
+		std::swap(checkpoint.converged, converged);
+
+		last_checkpoint = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(last_checkpoint - checkpoint_start).count();
+		checkpoint_interval = std::max(m_checkpoint_interval, seconds / MAX_CHECKPOINT_OVERHEAD);
+		checkpoint_seconds += seconds;
+		checkpointed_passes = num_passes;
+		checkpointed_tiles = num_tiles;
+		num_checkpoints += saved ? 1 : 0;
+	};
+
+	int num_passes = first_pass;
+	// Tiles of pass num_passes already rendered
+	int num_tiles = first_tile;
+
+	for (int pass_index = first_pass; pass_index < m_max_passes; ++pass_index)
+	{
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		if (m_time_budget > 0 && pass_index > first_pass && now >= pass.deadline)
+			break;
+
+		// Pixels are only left out after the minimum number of passes
+		if (m_adaptive_threshold > 0 && pass_index >= m_adaptive_min_passes)
+			pass.converged = &converged;
+
+		pass.first_sample = pass_index * samples_per_estimate();
+		pass.has_deadline = m_time_budget > 0 && pass_index > first_pass;
+		pass.elapsed_ratio = m_time_budget > 0
+			? std::chrono::duration<double>(now - start).count() / m_time_budget
+			: 0.0;
+		scheduler.reset(pass_index == first_pass ? first_tile : 0);
+
+		thread_pool->run([&](int) { thread_code(&pass); });
+
+		if (m_pass_callback)
+			m_pass_callback(framebuffer, pass_index + 1);
+
+		// Tiles taken before the deadline are rendered, so an interrupted pass did a prefix of them
+		const bool interrupted = scheduler.num_handed_out() < scheduler.num_tiles();
+		num_passes = interrupted ? pass_index : pass_index + 1;
+		num_tiles = interrupted ? scheduler.num_handed_out() : 0;
+		bool all_converged = false;
+
+		// After an interrupted pass, pixels are left to be checked once the pass is resumed
+		if (!interrupted && m_adaptive_threshold > 0 && num_passes >= m_adaptive_min_passes)
+		{
+			std::atomic<int> active_pixels(0);
+
+			// Pixels outside the scheduled tiles have no samples, hence count as converged
+			thread_pool->parallel_for(0, framebuffer.height(), [&](int row) {
+				active_pixels += update_converged(framebuffer, converged, row);
+			});
+
+			all_converged = active_pixels == 0;
+		}
+
+		if (all_converged || interrupted)
+			break;
+
+		if (!m_checkpoint_filename.empty() && num_passes < m_max_passes
+			&& std::chrono::duration<double>(std::chrono::steady_clock::now() - last_checkpoint).count()
+				>= checkpoint_interval)
+			save_checkpoint(num_passes, num_tiles);
+	}
 
-	m_current_row = 0;
+	// The last state is always saved, so that a finished render can be given more passes
+	if (!m_checkpoint_filename.empty() 
+		&& (num_passes > checkpointed_passes || num_tiles != checkpointed_tiles))
+		save_checkpoint(num_passes, num_tiles);
 
 	if (PRINT_PROGRESS)
 		std::cout << std::endl;
+
+	if (PRINT_PROGRESS && m_adaptive_threshold > 0)
+	{
+		long long num_samples = 0;
+		for (int row = 0; row < framebuffer.height(); ++row)
+			for (int col = 0; col < framebuffer.width(); ++col)
+				num_samples += framebuffer.num_samples(row, col);
+
+		const double uniform_samples = (double) num_passes * samples_per_estimate() * num_pixels;
+		std::cout << "Adaptive sampling: " << num_samples << " samples, " 
+			<< 100.0 * num_samples / uniform_samples << "% of uniform sampling with " 
+			<< num_passes << " passes" << std::endl;
+	}
+
+	if (PRINT_PROGRESS && num_checkpoints > 0)
+	{
+		const double render_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count() - elapsed_seconds;
+		std::cout << "Checkpoints: " << num_checkpoints << " written in " << checkpoint_seconds 
+			<< " s, " << 100.0 * checkpoint_seconds / render_seconds << "% of the render time" 
+			<< std::endl;
+	}
 }
 
 Radiance3 Path_Tracer::path_trace(
@@ -139,226 +560,634 @@ Radiance3 Path_Tracer::path_trace(
 	bool is_eye_ray,
 	double refractive_index) const
 {
-	/*  Compute the radiance BACK along the given ray. In the event that the ray is an eye-ray, 
-        include light emitted by the first surface encountered. For subsequent rays, such light 
-        has already been counted in the computation of direct lighting at prior hits */
-    
-	Radiance3 l_o(0.0);
+	Path_State path(ray);
+	path.is_eye_ray = is_eye_ray;
+	path.refractive_index = refractive_index;
+	path.sample = random_seq.sample();
 
-    scene::Surface_Element surfel;
-
-    double dist = std::numeric_limits<double>::infinity();
+	trace_path(path, random_seq);
+	STATS_PATH_LENGTH(path.bounces);
+	return path.radiance;
+}
 
-	if (!m_scene->intersect(ray, dist, surfel, refractive_index))
+Radiance3 Path_Tracer::path_trace(
+	const Ray& eye_ray,
+	const Eye_Ray_Hit& eye_ray_hit,
+	random::Random_Sequence& random_seq) const
+{
+	if (!eye_ray_hit.found)
 		return Radiance3(0.0);
-    	
-	depth += 1;
 
-	const Vector3& w_o = -1 * ray.direction;
+	Path_State path(eye_ray);
+	path.sample = random_seq.sample();
 
-    // This point could be an emitter
-    if (is_eye_ray && m_emit)
-        l_o += surfel.material.emit;
-    
-    // Shade this point (direct illumination)
-    if (!is_eye_ray || m_direct)
-        l_o += estimate_direct_light_from_area_lights(random_seq, surfel, w_o,
-			refractive_index);
-    
-    if (!is_eye_ray || m_indirect)
-		l_o += estimate_indirect_light(random_seq, surfel, w_o, is_eye_ray);
-    
-	depth -= 1;
+	if (extend_path(path, eye_ray_hit.surfel, random_seq))
+		trace_path(path, random_seq);
 
-	return l_o;
+	STATS_PATH_LENGTH(path.bounces);
+	return path.radiance;
+}
+
+void Path_Tracer::trace_path(Path_State& path, random::Random_Sequence& random_seq) const
+{
+	// Follows the path's ray until it leaves the scene or is terminated at a vertex
+	scene::Surface_Element surfel;
+
+	do
+	{
+		double dist = std::numeric_limits<double>::infinity();
+		STATS_ADD(path.is_eye_ray ? stats::EYE_RAYS : stats::INDIRECT_RAYS, 1);
+
+		if (!m_scene->intersect(path.ray, dist, surfel, path.refractive_index))
+			return;
+	} while (extend_path(path, surfel, random_seq));
 }
 
 Radiance3 Path_Tracer::estimate_direct_light_from_area_lights(
 	random::Random_Sequence& random_seq,
 	const scene::Surface_Element& surfel,
-	const Vector3& w_o,
-	double current_refractive_index) const
+	const Path_State& path) const
 {
-	if (surfel.material.lambertian_reflect.r == 0 && depth >= 2 && dot_prod(w_o, surfel.geometric.normal) < 0)
-		int a = 0;
+	// Estimate radiance back along ray due to direct illumination from area lights
+	Light_Connection connection;
+	sample_light_connection(path, surfel, random_seq, connection);
 
-    Radiance3 l_o(0.0);
+	double distance = connection.distance;
+	scene::Surface_Element shadow_ray_surfel;
+	STATS_ADD(stats::SHADOW_RAYS, 1);
+	const bool occluded = m_scene->intersect(
+		connection.shadow_ray, distance, shadow_ray_surfel, path.refractive_index);
 
-    // Estimate radiance back along ray due to direct illumination from area lights
-    const scene::Area_Light& light = pick_random_light();
+	return connect_light(connection, occluded, shadow_ray_surfel);
+}
+
+void Path_Tracer::sample_light_connection(
+	const Path_State& path,
+	const scene::Surface_Element& surfel,
+	random::Random_Sequence& random_seq,
+	Light_Connection& connection) const
+{
+	const Vector3& w_o = -1 * path.ray.direction;
+	const scene::Area_Light* light = nullptr;
+	double selection_probability = 0;
+	const Triangle& triangle = pick_light_triangle(random_seq, surfel.geometric.position, light,
+		selection_probability);
 
-	Radiance3 sample_power = light.m_power;
-	Point3 sample_position(0.0);
-	Vector3 sample_normal(0.0);
-	light.sample_point(sample_position, sample_normal);
+	const double u = random_seq.next_light_sample();
+	const double v = random_seq.next_light_sample();
+	light->sample_point(triangle, u, v, connection.light_position, connection.light_normal);
+	connection.power = light->m_power;
+	connection.light_triangle = &triangle;
+
+	// Density of the sampled point, per unit area
+	const double sample_pdf = selection_probability / triangle.area();
 
     // Displace surface points slightly along the triangle normals
     const Point3& surface_point_position = surfel.geometric.position + 
         surfel.geometric.normal * 1e-4;
-    const Point3& light_surfel_position = sample_position + 
-        sample_normal * 1e-4;
+    const Point3& light_surfel_position = connection.light_position + 
+        connection.light_normal * 1e-4;
 
 	// Points outwards
-    Vector3& w_i = Vector3(surfel.geometric.position, light_surfel_position);
-    double distance = w_i.magnitude();
-    w_i /= distance;
+    Vector3 w_i = Vector3(surfel.geometric.position, light_surfel_position);
+    connection.distance = w_i.magnitude();
+    w_i /= connection.distance;
+
+	connection.shadow_ray = Ray(surface_point_position, w_i);
+	connection.shading_position = surfel.geometric.position;
 
-    const Ray shadow_ray(surface_point_position, w_i);
+	// Integration domain and the surface's side of the change of variables term
+	const double cosine_over_pdf = std::max(0.0, dot_prod(w_i, surfel.shading.normal)) / sample_pdf;
+	connection.weight = surfel.evaluate_bsdf(w_i, w_o) * cosine_over_pdf;
+	connection.scattered_weight = surfel.evaluate_lambertian_bsdf(w_i, w_o) * cosine_over_pdf;
+
+	/*	The same direction could have been reached by scattering from this point. If the path 
+		ends here, no scattered ray will reach the light, and the light sample takes the whole 
+		weight */
+	connection.scatter_pdf = can_scatter(path) ? surfel.scatter_pdf(-1 * w_o, w_i) : 0.0;
+}
 
-    scene::Surface_Element shadow_ray_surfel;
-	bool in_shadow = m_scene->intersect(
-		shadow_ray, distance, shadow_ray_surfel, current_refractive_index);
+Radiance3 Path_Tracer::connect_light(
+	const Light_Connection& connection,
+	bool occluded,
+	const scene::Surface_Element& shadow_ray_surfel) const
+{
+	Radiance3 power = connection.power;
+	Point3 light_position = connection.light_position;
+	Vector3 light_normal = connection.light_normal;
+	const Triangle* light_triangle = connection.light_triangle;
 
-	if (in_shadow && shadow_ray_surfel.material.emit != Irradiance3(0.0))
+	if (occluded)
 	{
-		sample_power = shadow_ray_surfel.material.emit;
-		sample_position = shadow_ray_surfel.geometric.position;
-		sample_normal = shadow_ray_surfel.geometric.normal;
-		distance = Vector3(surfel.geometric.position, sample_position).magnitude();
-		in_shadow = false;
+		if (shadow_ray_surfel.material.emit == Irradiance3(0.0))
+			return Radiance3(0.0);
+
+		power = shadow_ray_surfel.material.emit;
+		light_position = shadow_ray_surfel.geometric.position;
+		light_normal = shadow_ray_surfel.geometric.normal;
+		light_triangle = shadow_ray_surfel.geometric.triangle;
 	}
 
-    if (!in_shadow)
-    {
-        double geometric_term = 
-			std::max(0.0, dot_prod(w_i, surfel.shading.normal)) 
-			* std::max(0.0, dot_prod(-1 * w_i, sample_normal) / (distance * distance));
+	static const double inv_pi = 1.0 / M_PI;
 
-		static const double inv_pi = 1.0 / M_PI;
+	const Vector3& w_i = connection.shadow_ray.direction;
+	const double distance = Vector3(connection.shading_position, light_position).magnitude();
+	const double light_cosine = std::max(0.0, dot_prod(-1 * w_i, light_normal) / (distance * distance));
+
+	const double mis_weight = power_heuristic(
+		light_sampling_pdf(connection.shading_position, light_triangle, light_position, light_normal),
+		connection.scatter_pdf);
+
+	// The glossy highlight is only estimated by light sampling, since scattering takes the mirror
+	const Color3& weight = connection.weight - connection.scattered_weight * (1.0 - mis_weight);
+
+	return weight * power * (inv_pi * light_cosine);
+}
+
+double Path_Tracer::light_sampling_pdf(
+	const Point3& position,
+	const Triangle* light_triangle,
+	const Point3& light_position,
+	const Vector3& light_normal) const
+{
+	if (!light_triangle || !m_scene->m_light_bvh.contains(*light_triangle))
+		return 0.0;
 
-		const Radiance3& emitted_radiance = sample_power * inv_pi;
-		const Radiance3& bsdf_evaluation = surfel.evaluate_bsdf(w_i, w_o);
-		
-		// Add surface color
-		l_o += 
-			m_scene->m_total_light_area    // Integration domain
-			* emitted_radiance
-			* bsdf_evaluation
-			* geometric_term;    // Change of variables term
-    }
+	// Points are sampled uniformly on the chosen triangle; convert to solid angle
+	const Vector3& to_light = Vector3(position, light_position);
+	const double distance = to_light.magnitude();
+	const double cosine = -dot_prod(to_light, light_normal) / distance;
 
-    return l_o;
+	if (cosine <= 0.0)
+		return 0.0;
+
+	const double area_pdf = light_triangle_probability(position, *light_triangle)
+		/ light_triangle->area();
+
+	return area_pdf * (distance * distance) / cosine;
 }
 
-Radiance3 Path_Tracer::estimate_indirect_light(
+bool Path_Tracer::scatter_ray(
 	random::Random_Sequence& random_seq,
-    const scene::Surface_Element& surfel,
+	const scene::Surface_Element& surfel,
 	const Vector3& w_o,
-	bool is_eye_ray) const
+	Ray& outgoing_ray,
+	Color3& coefficient,
+	double& outgoing_refractive_index,
+	bool& delta) const
 {
-    /*  Use recursion to estimate light running back along ray from surfel, but ONLY light that
-        arrives from INDIRECT sources, by making a single-sample estimate of the arriving light */
+	Vector3 scattered_direction(0);
 
-    Radiance3 l_o(0.0);
-    Vector3 scattered_direction(0);
-    Color3 coeff(0);
-    
 	/*	Scatter "backwards", finding the direction of incoming light (scattered_direction) given the direction
 		of outgoing light (ray.direction) */
-	if (surfel.scatter(-1 * w_o, scattered_direction, coeff, random_seq))
-	{
-		double dot_product_val = dot_prod(surfel.geometric.normal, scattered_direction);
-		double sign = (0.0 < dot_product_val) - (dot_product_val < 0.0);
-		
-		double outgoing_refractive_index = (sign > 0)
-			? surfel.material.refractive_index_exterior
-			: surfel.material.refractive_index_interior;
-		
-		const Point3& bumped_position = surfel.geometric.position + 
-            (sign * 1e-4) * surfel.geometric.normal;
-		
-		Ray outgoing_ray(bumped_position, scattered_direction);
-		l_o += coeff * path_trace(outgoing_ray, random_seq, false, outgoing_refractive_index);
-    }
+	if (!surfel.scatter(-1 * w_o, scattered_direction, coefficient, random_seq, delta))
+		return false;
+
+	double dot_product_val = dot_prod(surfel.geometric.normal, scattered_direction);
+	double sign = (0.0 < dot_product_val) - (dot_product_val < 0.0);
 	
-	return l_o;
+	outgoing_refractive_index = (sign > 0)
+		? surfel.material.refractive_index_exterior
+		: surfel.material.refractive_index_interior;
+	
+	const Point3& bumped_position = surfel.geometric.position + 
+		(sign * 1e-4) * surfel.geometric.normal;
+	
+	outgoing_ray = Ray(bumped_position, scattered_direction);
+	return true;
 }
 
-const scene::Area_Light& Path_Tracer::pick_random_light() const
+bool Path_Tracer::extend_path(
+	Path_State& path,
+	const scene::Surface_Element& surfel,
+	random::Random_Sequence& random_seq) const
 {
-	double inv_total_light_area = 1.0 / m_scene->m_total_light_area;
+	/*  Add the radiance coming BACK along the path's ray from surfel, weighted by the path 
+		throughput. Light emitted by the surface is only counted for eye rays, since for later 
+		vertices it has already been counted in the direct lighting of the previous vertex. 
+		Indirect light is accounted for by scattering the path into its next ray */
+	const bool direct_light_sampled = begin_vertex(path, surfel, random_seq);
 
-	std::uniform_real_distribution<double> dist(0.0, 1.0);
-	double random_number = dist(random::mt_engine_singleton());
+	// Shade this point (direct illumination)
+	if (direct_light_sampled)
+		path.radiance += path.throughput * estimate_direct_light_from_area_lights(random_seq,
+			surfel, path);
+
+	return scatter_path(path, surfel, direct_light_sampled, random_seq);
+}
 
-	for (const scene::Area_Light* area_light : m_scene->m_area_lights)
+bool Path_Tracer::begin_vertex(
+	Path_State& path,
+	const scene::Surface_Element& surfel,
+	random::Random_Sequence& random_seq) const
+{
+	const Vector3& w_o = -1 * path.ray.direction;
+
+	// Interleaved paths share the sequence, each with its own sample
+	if (random_seq.sample() != path.sample)
+		random_seq.start_sample(path.sample);
+
+	// This point could be an emitter
+	if (path.is_eye_ray && m_emit)
+		path.radiance += path.throughput * surfel.material.emit;
+
+	/*	Emitters reached by scattering from a Lambertian lobe are combined with the 
+		direct lighting estimate of the previous vertex, which sampled the same light */
+	if (!path.is_eye_ray && path.scatter_pdf > 0.0 && surfel.material.emit != Irradiance3(0.0)
+		&& dot_prod(w_o, surfel.geometric.normal) > 0.0)
 	{
-		random_number -= area_light->area() * inv_total_light_area;
-		if (random_number <= 0)
-			return *area_light;
+		static const double inv_pi = 1.0 / M_PI;
+
+		const double light_pdf = path.direct_light_sampled
+			? light_sampling_pdf(path.shading_position, surfel.geometric.triangle, 
+				surfel.geometric.position, surfel.geometric.normal)
+			: 0.0;
+
+		path.radiance += path.emission_throughput * surfel.material.emit
+			* (inv_pi * power_heuristic(path.scatter_pdf, light_pdf));
 	}
 
-	return *m_scene->m_area_lights.back();
+	random_seq.set_dimension(path.bounces * DIMENSIONS_PER_VERTEX + LIGHT_SELECTION_DIMENSION);
+
+	return !path.is_eye_ray || m_direct;
 }
 
-void Path_Tracer::thread_code(std::vector<std::vector<Radiance3>>* image)
+bool Path_Tracer::scatter_path(
+	Path_State& path,
+	const scene::Surface_Element& surfel,
+	bool direct_light_sampled,
+	random::Random_Sequence& random_seq) const
 {
-	const int resolution_height = (int) round(m_resolution_width / m_aspect_ratio);
-	const double window_height = round(m_window_width / m_aspect_ratio);
-	const double pixel_side = m_window_width / m_resolution_width;
-	const Point3& near_center = m_camera->position() + (m_camera->near() * m_camera->look_at());
-	const Point3& top_left_pixel_center = near_center
-		+ 0.5 * (window_height - pixel_side) * m_camera->up()
-		+ 0.5 * (m_window_width - pixel_side) * m_camera->left();
-	const Vector3& right_increment = pixel_side * -1 * m_camera->left();
-	const Vector3& down_increment = pixel_side * -1 * m_camera->up();
-	m_pixel_lock.lock();
+	const Vector3& w_o = -1 * path.ray.direction;
+	const size_t first_dimension = path.bounces * DIMENSIONS_PER_VERTEX;
+
+	if (!can_scatter(path))
+		return false;
+
+	Ray outgoing_ray(path.ray);
+	Color3 coeff(0);
+	double outgoing_refractive_index;
+	bool delta;
 
-	while (m_current_row < resolution_height)
+	random_seq.set_dimension(first_dimension + SCATTER_DIMENSION);
+
+	if (!scatter_ray(random_seq, surfel, w_o, outgoing_ray, coeff, outgoing_refractive_index, delta))
+		return false;
+
+	// Emitters reached through a delta lobe are left to the direct lighting of this vertex
+	path.scatter_pdf = delta ? 0.0 : surfel.scatter_pdf(path.ray.direction, outgoing_ray.direction);
+	path.direct_light_sampled = direct_light_sampled;
+	path.shading_position = surfel.geometric.position;
+
+	if (path.scatter_pdf > 0.0)
 	{
-		while (m_current_col < m_resolution_width && m_current_row < resolution_height)
+		// Lambertian part of the direct lighting integrand, divided by the scattering density
+		path.emission_throughput = path.throughput
+			* surfel.evaluate_lambertian_bsdf(outgoing_ray.direction, w_o)
+			* (std::max(0.0, dot_prod(outgoing_ray.direction, surfel.shading.normal)) / path.scatter_pdf);
+	}
+
+	path.ray = outgoing_ray;
+	path.throughput = path.throughput * coeff;
+	path.refractive_index = outgoing_refractive_index;
+	path.is_eye_ray = false;
+	++path.bounces;
+
+	random_seq.set_dimension(first_dimension + ROULETTE_DIMENSION);
+
+	return survives_roulette(path, random_seq);
+}
+
+bool Path_Tracer::can_scatter(const Path_State& path) const
+{
+	return !(path.is_eye_ray && !m_indirect) && path.bounces < m_max_bounces;
+}
+
+bool Path_Tracer::survives_roulette(Path_State& path, random::Random_Sequence& random_seq) const
+{
+	/*	Scattering does not absorb paths, so the throughput is the product of the reflectances 
+		met along the path. After the minimum number of bounces, paths whose throughput has 
+		fallen below the threshold survive with probability proportional to it, and the 
+		survivors' throughput is divided by that probability so that the estimate stays 
+		unbiased. A zero threshold disables the roulette, leaving only the bounce limit */
+	if (path.bounces < m_roulette_min_bounces || m_roulette_threshold == 0)
+		return true;
+
+	const double max_throughput = *std::max_element(path.throughput.begin(), path.throughput.end());
+	const double survival_probability = std::min(1.0, max_throughput / m_roulette_threshold);
+
+	if (survival_probability >= 1.0)
+		return true;
+
+	if (random_seq.next() >= survival_probability)
+		return false;
+
+	path.throughput = path.throughput / survival_probability;
+	path.emission_throughput = path.emission_throughput / survival_probability;
+	return true;
+}
+
+void Path_Tracer::trace_sorted_paths(
+	const Ray* eye_rays,
+	const Eye_Ray_Hit* eye_ray_hits,
+	random::Random_Sequence* const* random_seqs,
+	int num_pixels,
+	int num_paths,
+	std::uint64_t first_sample,
+	Radiance3* radiance_sums) const
+{
+	std::vector<Path_State> paths;
+	std::vector<int> path_pixels;
+	paths.reserve((size_t) num_pixels * num_paths);
+	path_pixels.reserve((size_t) num_pixels * num_paths);
+	Ray_Stream stream(m_scene->aabb());
+
+	for (int pixel = 0; pixel < num_pixels; ++pixel)
+	{
+		// Pixels whose eye ray leaves the scene get no radiance
+		if (!eye_ray_hits[pixel].found)
+			continue;
+
+		for (int i = 0; i < num_paths; ++i)
 		{
-			int row = m_current_row;
-			int col = m_current_col++;
+			const int id = (int) paths.size();
+			paths.push_back(Path_State(eye_rays[pixel]));
+			paths.back().sample = first_sample + i;
+			path_pixels.push_back(pixel);
+
+			if (extend_path(paths[id], eye_ray_hits[pixel].surfel, *random_seqs[pixel]))
+				stream.push(paths[id].ray, id);
+		}
+	}
+
+	std::vector<Ray> packet_rays;
+	packet_rays.reserve(Ray_Packet::SIZE);
 
-			m_pixel_lock.unlock();
+	while (!stream.empty())
+	{
+		stream.sort();
+		Ray_Stream next_stream(m_scene->aabb());
+
+		// Consecutive rays of the sorted stream are traced together as packets
+		for (size_t first = 0; first < stream.size(); first += Ray_Packet::SIZE)
+		{
+			const int num_rays = (int) std::min<size_t>(Ray_Packet::SIZE, stream.size() - first);
 
-			Point3& pixel_center = top_left_pixel_center
-				+ row * down_increment
-				+ col * right_increment;
-			const Ray ray(m_camera->position(), Vector3(m_camera->position(), pixel_center));
-			
-			const Radiance3& estimate = estimate_pixel_color(ray);
+			// Paths in a packet may travel through media with different refractive indices
+			double refractive_indices[Ray_Packet::SIZE];
+			packet_rays.clear();
+			for (int i = 0; i < num_rays; ++i)
+			{
+				packet_rays.push_back(stream.ray(first + i));
+				refractive_indices[i] = paths[stream.id(first + i)].refractive_index;
+			}
 
-			m_image_lock.lock();
-			(*image)[row][col] = estimate;
-			m_image_lock.unlock();
+			const Ray_Packet packet(packet_rays.data(), num_rays);
+			double distances[Ray_Packet::SIZE];
+			scene::Surface_Element surfels[Ray_Packet::SIZE];
+			std::fill(distances, distances + Ray_Packet::SIZE, std::numeric_limits<double>::infinity());
 
-			m_pixel_lock.lock();
+			STATS_ADD(stats::INDIRECT_RAYS, num_rays);
+			int hit_mask = m_scene->intersect(packet, packet.mask(), distances, surfels, refractive_indices);
 
-			if (PRINT_PROGRESS
-				&& col == m_resolution_width - 1
-				&& resolution_height > 20
-				&& (row % (resolution_height / 20) == 0 || row == resolution_height-1))
+			for (int i = 0; i < num_rays; ++i)
 			{
-				int completed_pixels = (row + 1) * m_resolution_width;
-				double progress_ratio = (double) completed_pixels / (resolution_height * m_resolution_width);
-				std::cout << '\r' << build_progress_bar(progress_ratio);
+				if (!(hit_mask & (1 << i)))
+					continue;
+
+				const int id = stream.id(first + i);
+				Path_State& path = paths[id];
+
+				if (extend_path(path, surfels[i], *random_seqs[path_pixels[id]]))
+					next_stream.push(path.ray, id);
 			}
 		}
 
-		++m_current_row;
-		m_current_col = 0;
+		std::swap(stream, next_stream);
+	}
+
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		radiance_sums[path_pixels[i]] += paths[i].radiance;
+		STATS_PATH_LENGTH(paths[i].bounces);
+	}
+}
+
+const scene::Area_Light& Path_Tracer::pick_random_light(double u) const
+{
+	return *m_scene->m_area_lights[m_scene->m_light_selection.sample(u)];
+}
+
+const Triangle& Path_Tracer::pick_light_triangle(
+	random::Random_Sequence& random_seq,
+	const Point3& position,
+	const scene::Area_Light*& light,
+	double& probability) const
+{
+	const double u_light = random_seq.next_light_sample();
+	const double u_triangle = random_seq.next_light_sample();
+
+	if (m_light_selection == LIGHT_HIERARCHY)
+		return m_scene->m_light_bvh.sample(position, u_light, light, probability);
+
+	light = &pick_random_light(u_light);
+	const Triangle& triangle = light->sample_triangle(u_triangle);
+	probability = triangle.area() / m_scene->m_total_light_area;
+	return triangle;
+}
+
+double Path_Tracer::light_triangle_probability(const Point3& position, const Triangle& triangle) const
+{
+	if (m_light_selection == LIGHT_HIERARCHY)
+		return m_scene->m_light_bvh.probability(position, triangle);
+
+	return triangle.area() / m_scene->m_total_light_area;
+}
+
+void Path_Tracer::thread_code(Pass* pass)
+{
+	Tile_Scheduler::Tile tile;
+
+	// The deadline is checked before taking a tile, so that every tile taken is rendered
+	while (!(pass->has_deadline && std::chrono::steady_clock::now() >= pass->deadline)
+		&& pass->scheduler->next(tile))
+	{
+		TRACE_TILE_SPAN("tile", "render", tile.row_begin, tile.col_begin);
+		render_tile(tile, pass);
+		report_progress(pass, tile.num_pixels());
+	}
+}
+
+void Path_Tracer::report_progress(Pass* pass, long long num_pixels)
+{
+	const long long completed = pass->completed_pixels->fetch_add(num_pixels) + num_pixels;
+
+	// Progress is printed by whichever thread gets the lock; the others go on rendering
+	if (PRINT_PROGRESS && m_progress_lock.try_lock())
+	{
+		// With a time budget, the render may end before all passes are done
+		const double progress_ratio = std::min(1.0,
+			std::max((double) completed / pass->total_pixels, pass->elapsed_ratio));
+		std::cout << '\r' << build_progress_bar(progress_ratio);
+		m_progress_lock.unlock();
+	}
+}
+
+int Path_Tracer::update_converged(
+	const Framebuffer& framebuffer,
+	std::vector<unsigned char>& converged,
+	int row) const
+{
+	int active_pixels = 0;
+
+	for (int col = 0; col < framebuffer.width(); ++col)
+	{
+		unsigned char& pixel_converged = converged[row * framebuffer.width() + col];
+
+		if (!pixel_converged)
+			pixel_converged = framebuffer.luminance_error(row, col)
+				<= m_adaptive_threshold * framebuffer.luminance(row, col);
+
+		active_pixels += pixel_converged ? 0 : 1;
+	}
+
+	return active_pixels;
+}
+
+void Path_Tracer::render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const
+{
+	std::vector<std::pair<int, int>> pixels;
+	std::vector<Ray> eye_rays;
+	std::vector<Eye_Ray_Hit> eye_ray_hits;
+	trace_eye_rays(tile, pass, pixels, eye_rays, eye_ray_hits);
+
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		// No other thread writes this pixel, so no lock is needed
+		if (!eye_ray_hits[i].found)
+		{
+			// Every sample of a pixel whose eye ray leaves the scene is black
+			pass->add_estimate(pixels[i].first, pixels[i].second, Radiance3(0.0),
+				samples_per_estimate());
+			continue;
+		}
+
+		const Radiance3& estimate = estimate_pixel_color(eye_rays[i], eye_ray_hits[i],
+			pixels[i].first * m_resolution_width + pixels[i].second, pass->first_sample);
+		pass->add_estimate(pixels[i].first, pixels[i].second, estimate,
+			samples_per_estimate());
 	}
+}
+
+void Path_Tracer::trace_eye_rays(
+	const Tile_Scheduler::Tile& tile,
+	const Pass* pass,
+	std::vector<std::pair<int, int>>& pixels,
+	std::vector<Ray>& eye_rays,
+	std::vector<Eye_Ray_Hit>& eye_ray_hits) const
+{
+	const size_t num_pixels = (size_t) (tile.row_end - tile.row_begin) * (tile.col_end - tile.col_begin);
+	pixels.clear();
+	eye_rays.clear();
+	eye_ray_hits.clear();
+	pixels.reserve(num_pixels);
+	eye_rays.reserve(num_pixels);
+	eye_ray_hits.reserve(num_pixels);
+
+	// Tiles are split in blocks of BLOCK_SIDE x BLOCK_SIDE pixels, whose eye rays form a packet
+	for (int row = tile.row_begin; row < tile.row_end; row += BLOCK_SIDE)
+	{
+		for (int col = tile.col_begin; col < tile.col_end; col += BLOCK_SIDE)
+		{
+			const size_t first = eye_rays.size();
+
+			for (int block_row = row; block_row < std::min(row + BLOCK_SIDE, tile.row_end); ++block_row)
+			{
+				for (int block_col = col; block_col < std::min(col + BLOCK_SIDE, tile.col_end); ++block_col)
+				{
+					if (pass->pixel_converged(block_row, block_col))
+						continue;
+
+					eye_rays.push_back(eye_ray(block_row, block_col));
+					pixels.push_back(std::make_pair(block_row, block_col));
+				}
+			}
+
+			const int num_rays = (int) (eye_rays.size() - first);
+			if (num_rays == 0)
+				continue;
+
+			const Ray_Packet packet(&eye_rays[first], num_rays);
+			double distances[Ray_Packet::SIZE];
+			scene::Surface_Element surfels[Ray_Packet::SIZE];
+			std::fill(distances, distances + Ray_Packet::SIZE, std::numeric_limits<double>::infinity());
+
+			STATS_ADD(stats::EYE_RAYS, packet.size());
+			int hit_mask = m_scene->intersect(packet, packet.mask(), distances, surfels, 1.0);
+
+			for (int i = 0; i < num_rays; ++i)
+			{
+				eye_ray_hits.push_back(Eye_Ray_Hit());
+				eye_ray_hits.back().found = (hit_mask & (1 << i)) != 0;
+				if (eye_ray_hits.back().found)
+					eye_ray_hits.back().surfel = surfels[i];
+			}
+		}
+	}
+}
+
+int Path_Tracer::resolution_height() const
+{
+	return (int) round(m_resolution_width / m_aspect_ratio);
+}
+
+Tile_Scheduler::Tile Path_Tracer::render_window() const
+{
+	const int resolution_height = this->resolution_height();
+
+	Tile_Scheduler::Tile window;
+	window.row_begin = 0;
+	window.row_end = resolution_height;
+	window.col_begin = 0;
+	window.col_end = m_resolution_width;
+
+	if (!m_has_crop_window)
+		return window;
+
+	if (m_crop_window.row_end > resolution_height || m_crop_window.col_end > m_resolution_width)
+		throw std::invalid_argument("Crop window outside the image");
+
+	return m_crop_window;
+}
+
+Ray Path_Tracer::eye_ray(int row, int col) const
+{
+	const double window_height = round(m_window_width / m_aspect_ratio);
+	const double pixel_side = m_window_width / m_resolution_width;
+	const Point3& near_center = m_camera->position() + (m_camera->near() * m_camera->look_at());
+	const Point3& top_left_pixel_center = near_center
+		+ 0.5 * (window_height - pixel_side) * m_camera->up()
+		+ 0.5 * (m_window_width - pixel_side) * m_camera->left();
+
+	const Point3 pixel_center = top_left_pixel_center
+		+ (row * pixel_side) * (-1 * m_camera->up())
+		+ (col * pixel_side) * (-1 * m_camera->left());
 
-	m_pixel_lock.unlock();
+	return Ray(m_camera->position(), Vector3(m_camera->position(), pixel_center));
 }
 
-Radiance3 Path_Tracer::gamma_correction(Radiance3 radiance) const
+Radiance3 Path_Tracer::inverse_gamma_correction(Radiance3 display_value) const
 {
 	return Radiance3(
-		gamma_correction(radiance.r),
-		gamma_correction(radiance.g),
-		gamma_correction(radiance.b));
+		inverse_gamma_correction(display_value.r),
+		inverse_gamma_correction(display_value.g),
+		inverse_gamma_correction(display_value.b));
 }
 
-double Path_Tracer::gamma_correction(double radiance) const
+double Path_Tracer::inverse_gamma_correction(double display_value) const
 {
-	return int(
-		std::pow(
-			std::min(1.0, std::max(0.0, radiance * m_gamma_coefficient)),
-			m_gamma_exponent)
-		* 255.0);
+	const double normalized = std::min(1.0, std::max(0.0, display_value / 255.0));
+	return std::pow(normalized, 1.0 / gamma_exponent()) / gamma_coefficient();
 }
 
 std::string Path_Tracer::build_progress_bar(double progress) const
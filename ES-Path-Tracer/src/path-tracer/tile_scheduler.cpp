@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "path-tracer/tile_scheduler.h"
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Tile_Scheduler::Tile_Scheduler(int width, int height, int tile_size) : 
+	m_window(image_window(width, height)),
+	m_tile_size(tile_size),
+	m_next_tile(0)
+{
+	if (tile_size <= 0)
+		throw std::invalid_argument("Tile size must be positive");
+
+	schedule(std::vector<int>());
+}
+
+Tile_Scheduler::Tile_Scheduler(const Tile& window, int tile_size, const std::vector<int>& tiles) :
+	m_window(window),
+	m_tile_size(tile_size),
+	m_next_tile(0)
+{
+	if (window.row_begin < 0 || window.col_begin < 0
+		|| window.row_end <= window.row_begin || window.col_end <= window.col_begin)
+		throw std::invalid_argument("Invalid window");
+	if (tile_size <= 0)
+		throw std::invalid_argument("Tile size must be positive");
+
+	schedule(tiles);
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// =========================== SCHEDULING FUNCTIONS ===========================
+// ============================================================================
+
+bool Tile_Scheduler::next(Tile& tile)
+{
+	const int index = m_next_tile.fetch_add(1, std::memory_order_relaxed);
+
+	if (index >= (int) m_tiles.size())
+		return false;
+
+	tile = m_tiles[index];
+	return true;
+}
+
+unsigned int Tile_Scheduler::morton_code(unsigned int x, unsigned int y)
+{
+	// Interleaves the lower 16 bits of x and y, with x in the even bits
+	unsigned int code = 0;
+
+	for (int bit = 0; bit < 16; ++bit)
+		code |= (((x >> bit) & 1u) << (2 * bit)) | (((y >> bit) & 1u) << (2 * bit + 1));
+
+	return code;
+}
+
+long long Tile_Scheduler::num_pixels() const
+{
+	long long num_pixels = 0;
+	for (const Tile& tile : m_tiles)
+		num_pixels += tile.num_pixels();
+	return num_pixels;
+}
+
+Tile_Scheduler::Tile Tile_Scheduler::bounds() const
+{
+	Tile bounds = m_tiles.front();
+
+	for (const Tile& tile : m_tiles)
+	{
+		bounds.row_begin = std::min(bounds.row_begin, tile.row_begin);
+		bounds.row_end = std::max(bounds.row_end, tile.row_end);
+		bounds.col_begin = std::min(bounds.col_begin, tile.col_begin);
+		bounds.col_end = std::max(bounds.col_end, tile.col_end);
+	}
+
+	return bounds;
+}
+
+void Tile_Scheduler::schedule(const std::vector<int>& tiles)
+{
+	const int tiles_x = tiles_per_row();
+	const int tiles_y = tiles_per_column();
+
+	std::vector<int> tile_indices(tiles);
+
+	if (tile_indices.empty())
+	{
+		tile_indices.resize(tiles_x * tiles_y);
+		std::iota(tile_indices.begin(), tile_indices.end(), 0);
+	}
+
+	// A tile listed twice is rendered once
+	std::sort(tile_indices.begin(), tile_indices.end());
+	tile_indices.erase(std::unique(tile_indices.begin(), tile_indices.end()), tile_indices.end());
+
+	std::vector<std::pair<unsigned int, Tile>> ordered_tiles;
+	ordered_tiles.reserve(tile_indices.size());
+
+	for (int tile_index : tile_indices)
+	{
+		if (tile_index < 0 || tile_index >= tiles_x * tiles_y)
+			throw std::invalid_argument("Tile outside the window");
+
+		const int tile_x = tile_index % tiles_x;
+		const int tile_y = tile_index / tiles_x;
+
+		Tile tile;
+		tile.row_begin = m_window.row_begin + tile_y * m_tile_size;
+		tile.row_end = std::min(m_window.row_end, tile.row_begin + m_tile_size);
+		tile.col_begin = m_window.col_begin + tile_x * m_tile_size;
+		tile.col_end = std::min(m_window.col_end, tile.col_begin + m_tile_size);
+
+		ordered_tiles.push_back(std::make_pair(morton_code(tile_x, tile_y), tile));
+	}
+
+	std::sort(ordered_tiles.begin(), ordered_tiles.end(),
+		[](const std::pair<unsigned int, Tile>& a, const std::pair<unsigned int, Tile>& b) 
+			{ return a.first < b.first; });
+
+	m_tiles.clear();
+	m_tiles.reserve(ordered_tiles.size());
+	for (const std::pair<unsigned int, Tile>& ordered_tile : ordered_tiles)
+		m_tiles.push_back(ordered_tile.second);
+}
+
+Tile_Scheduler::Tile Tile_Scheduler::image_window(int width, int height)
+{
+	if (width <= 0 || height <= 0)
+		throw std::invalid_argument("Image dimensions must be positive");
+
+	Tile window;
+	window.row_begin = 0;
+	window.row_end = height;
+	window.col_begin = 0;
+	window.col_end = width;
+	return window;
+}
+
+// ============================================================================
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "geometry/ray.h"
+#include "geometry/ray_packet.h"
+#include "geometry/ray_stream.h"
+#include "path-tracer/camera.h"
+#include "path-tracer/monte_carlo_path_tracer.h"
+#include "path-tracer/tile_scheduler.h"
+#include "path-tracer/wavefront_path_tracer.h"
+#include "random/random_sequence.h"
+#include "scene/scene.h"
+#include "shading/color3.h"
+#include "shading/surface_element.h"
+#include "stats/render_stats.h"
+
+// Number of material classes, one per combination of emissive, Lambertian, glossy and transmissive
+const int NUM_MATERIAL_CLASSES = 16;
+
+// ============================================================================
+// =============================== CONSTRUCTOR ================================
+// ============================================================================
+
+Wavefront_Path_Tracer::Wavefront_Path_Tracer(
+	const Camera* camera,
+	const scene::Scene* scene,
+	double window_width,
+	double aspect_ratio,
+	int resolution_width,
+	int samples_per_pixel,
+	double gamma_coefficient,
+	double gamma_exponent,
+	int num_threads)
+	: Monte_Carlo_Path_Tracer(
+		camera,
+		scene,
+		window_width,
+		aspect_ratio,
+		resolution_width,
+		samples_per_pixel,
+		gamma_coefficient,
+		gamma_exponent,
+		num_threads),
+	m_wavefront_size(DEFAULT_WAVEFRONT_SIZE) {}
+
+void Wavefront_Path_Tracer::set_wavefront_size(int wavefront_size)
+{
+	if (wavefront_size <= 0)
+		throw std::invalid_argument("Wavefront size must be positive");
+	m_wavefront_size = wavefront_size;
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// ================================== STAGES ==================================
+// ============================================================================
+
+void Wavefront_Path_Tracer::render_tile(const Tile_Scheduler::Tile& tile, Pass* pass) const
+{
+	const int width = resolution_width();
+	const int samples = samples_per_pixel();
+
+	// Generate: eye rays of the pixels of the tile that are still sampled
+	std::vector<std::pair<int, int>> pixels;
+	std::vector<Ray> eye_rays;
+	Ray_Stream rays(scene()->aabb());
+
+	for (int row = tile.row_begin; row < tile.row_end; ++row)
+	{
+		for (int col = tile.col_begin; col < tile.col_end; ++col)
+		{
+			if (pass->pixel_converged(row, col))
+				continue;
+
+			eye_rays.push_back(eye_ray(row, col));
+			rays.push(eye_rays.back(), (int) pixels.size());
+			pixels.push_back(std::make_pair(row, col));
+		}
+	}
+
+	if (pixels.empty())
+		return;
+
+	Wavefront wavefront;
+	Hit_Queue eye_ray_hits;
+
+	// Eye ray hits are shared by every sample of their pixel
+	for (size_t i = 0; i < pixels.size(); ++i)
+		wavefront.paths.push_back(Path_State(eye_rays[i]));
+	STATS_ADD(stats::EYE_RAYS, rays.size());
+	extend(wavefront, rays, eye_ray_hits);
+
+	for (size_t i = 0; i < pixels.size(); ++i)
+		wavefront.random_seqs.push_back(create_random_sequence(
+			pixels[i].first * width + pixels[i].second));
+
+	std::vector<Radiance3> pixel_radiance(pixels.size(), Radiance3(0.0));
+	const long long num_paths = (long long) eye_ray_hits.size() * samples;
+
+	Hit_Queue hits;
+	Shadow_Queue shadow_rays;
+
+	for (long long first_path = 0; first_path < num_paths; first_path += m_wavefront_size)
+	{
+		const int wavefront_paths = (int) std::min<long long>(m_wavefront_size, num_paths - first_path);
+
+		wavefront.paths.clear();
+		wavefront.pixels.clear();
+
+		for (int i = 0; i < wavefront_paths; ++i)
+		{
+			const long long path_index = first_path + i;
+			const int eye_ray_hit = (int) (path_index / samples);
+			const int pixel = eye_ray_hits.paths[eye_ray_hit];
+
+			wavefront.paths.push_back(Path_State(eye_rays[pixel]));
+			wavefront.paths.back().sample = pass->first_sample + path_index % samples;
+			wavefront.pixels.push_back(pixel);
+			hits.push(i, eye_ray_hits.surfels[eye_ray_hit]);
+		}
+
+		while (!hits.empty())
+		{
+			shade(wavefront, hits, rays, shadow_rays);
+			connect(wavefront, shadow_rays);
+
+			rays.sort();
+			STATS_ADD(stats::INDIRECT_RAYS, rays.size());
+			extend(wavefront, rays, hits);
+		}
+
+		for (int i = 0; i < wavefront_paths; ++i)
+		{
+			pixel_radiance[wavefront.pixels[i]] += wavefront.paths[i].radiance;
+			STATS_PATH_LENGTH(wavefront.paths[i].bounces);
+		}
+	}
+
+	// No other thread writes these pixels, so no lock is needed
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pass->add_estimate(pixels[i].first, pixels[i].second,
+			pixel_radiance[i] / samples, samples);
+}
+
+void Wavefront_Path_Tracer::extend(const Wavefront& wavefront, const Ray_Stream& rays, Hit_Queue& hits) const
+{
+	std::vector<Ray> packet_rays;
+	packet_rays.reserve(Ray_Packet::SIZE);
+
+	for (size_t first = 0; first < rays.size(); first += Ray_Packet::SIZE)
+	{
+		const int num_rays = (int) std::min<size_t>(Ray_Packet::SIZE, rays.size() - first);
+
+		// Paths in a packet may travel through media with different refractive indices
+		double refractive_indices[Ray_Packet::SIZE];
+		packet_rays.clear();
+		for (int i = 0; i < num_rays; ++i)
+		{
+			packet_rays.push_back(rays.ray(first + i));
+			refractive_indices[i] = wavefront.paths[rays.id(first + i)].refractive_index;
+		}
+
+		const Ray_Packet packet(packet_rays.data(), num_rays);
+		double distances[Ray_Packet::SIZE];
+		scene::Surface_Element surfels[Ray_Packet::SIZE];
+		std::fill(distances, distances + Ray_Packet::SIZE, std::numeric_limits<double>::infinity());
+
+		const int hit_mask = scene()->intersect(packet, packet.mask(), distances, surfels, 
+			refractive_indices);
+
+		for (int i = 0; i < num_rays; ++i)
+		{
+			if (hit_mask & (1 << i))
+				hits.push(rays.id(first + i), surfels[i]);
+		}
+	}
+}
+
+void Wavefront_Path_Tracer::shade(
+	Wavefront& wavefront,
+	Hit_Queue& hits,
+	Ray_Stream& rays,
+	Shadow_Queue& shadow_rays) const
+{
+	// Counting sort of the vertices by material class
+	std::vector<int> class_begin(NUM_MATERIAL_CLASSES + 1, 0);
+	std::vector<int> classes(hits.size());
+
+	for (size_t i = 0; i < hits.size(); ++i)
+	{
+		classes[i] = material_class(hits.surfels[i].material);
+		++class_begin[classes[i] + 1];
+	}
+
+	for (int c = 0; c < NUM_MATERIAL_CLASSES; ++c)
+		class_begin[c + 1] += class_begin[c];
+
+	std::vector<int> order(hits.size());
+	for (size_t i = 0; i < hits.size(); ++i)
+		order[class_begin[classes[i]]++] = (int) i;
+
+	rays.clear();
+
+	for (int i : order)
+	{
+		const int id = hits.paths[i];
+		const scene::Surface_Element& surfel = hits.surfels[i];
+		Path_State& path = wavefront.paths[id];
+		random::Random_Sequence& random_seq = *wavefront.random_seqs[wavefront.pixels[id]];
+
+		const bool direct_light_sampled = begin_vertex(path, surfel, random_seq);
+
+		if (direct_light_sampled)
+		{
+			Light_Connection connection;
+			sample_light_connection(path, surfel, random_seq, connection);
+			connection.weight = connection.weight * path.throughput;
+			connection.scattered_weight = connection.scattered_weight * path.throughput;
+			shadow_rays.push(id, connection);
+		}
+
+		if (scatter_path(path, surfel, direct_light_sampled, random_seq))
+			rays.push(path.ray, id);
+	}
+
+	hits.clear();
+}
+
+void Wavefront_Path_Tracer::connect(Wavefront& wavefront, Shadow_Queue& shadow_rays) const
+{
+	Ray_Stream stream(scene()->aabb());
+
+	for (size_t i = 0; i < shadow_rays.size(); ++i)
+		stream.push(shadow_rays.connections[i].shadow_ray, (int) i);
+	STATS_ADD(stats::SHADOW_RAYS, shadow_rays.size());
+
+	stream.sort();
+
+	std::vector<Ray> packet_rays;
+	packet_rays.reserve(Ray_Packet::SIZE);
+
+	for (size_t first = 0; first < stream.size(); first += Ray_Packet::SIZE)
+	{
+		const int num_rays = (int) std::min<size_t>(Ray_Packet::SIZE, stream.size() - first);
+
+		packet_rays.clear();
+		double distances[Ray_Packet::SIZE];
+		for (int i = 0; i < num_rays; ++i)
+		{
+			packet_rays.push_back(stream.ray(first + i));
+			distances[i] = shadow_rays.connections[stream.id(first + i)].distance;
+		}
+
+		const Ray_Packet packet(packet_rays.data(), num_rays);
+		scene::Surface_Element surfels[Ray_Packet::SIZE];
+
+		const int hit_mask = scene()->intersect(packet, packet.mask(), distances, surfels, 1.0);
+
+		for (int i = 0; i < num_rays; ++i)
+		{
+			const int id = stream.id(first + i);
+
+			wavefront.paths[shadow_rays.paths[id]].radiance += connect_light(
+				shadow_rays.connections[id], (hit_mask & (1 << i)) != 0, surfels[i]);
+		}
+	}
+
+	shadow_rays.clear();
+}
+
+// ============================================================================
+
+
+
+// ============================================================================
+// =========================== AUXILIARY FUNCTIONS ============================
+// ============================================================================
+
+int Wavefront_Path_Tracer::material_class(const scene::Surface_Element::Material_Data& material)
+{
+	return (material.emit != Irradiance3(0.0) ? 1 : 0)
+		| (material.lambertian_reflect != Color3(0.0) ? 2 : 0)
+		| (material.specular_reflect != Color3(0.0) ? 4 : 0)
+		| (material.transmit != Color3(0.0) ? 8 : 0);
+}
+
+// ============================================================================
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "random/alias_table.h"
+
+namespace random
+{
+	Alias_Table::Alias_Table(const std::vector<double>& weights)
+		: m_bins(weights.size()), m_probabilities(weights.size()), m_total_weight(0)
+	{
+		if (weights.empty())
+			throw std::invalid_argument("Empty weights");
+
+		for (double weight : weights)
+		{
+			if (weight < 0)
+				throw std::invalid_argument("Weights must be non-negative");
+			m_total_weight += weight;
+		}
+
+		if (m_total_weight <= 0)
+			throw std::invalid_argument("Weights must have a positive sum");
+
+		const int n = (int) weights.size();
+
+		// Scaled probabilities, whose mean is 1. Bins below 1 are filled up with larger ones
+		std::vector<double> scaled(n);
+		std::vector<int> small, large;
+
+		for (int i = 0; i < n; ++i)
+		{
+			m_probabilities[i] = weights[i] / m_total_weight;
+			scaled[i] = m_probabilities[i] * n;
+			(scaled[i] < 1.0 ? small : large).push_back(i);
+		}
+
+		while (!small.empty() && !large.empty())
+		{
+			const int less = small.back();
+			const int more = large.back();
+			small.pop_back();
+
+			m_bins[less].threshold = scaled[less];
+			m_bins[less].alias = more;
+
+			scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+
+			if (scaled[more] < 1.0)
+			{
+				large.pop_back();
+				small.push_back(more);
+			}
+		}
+
+		// Leftovers are 1 up to rounding errors
+		for (int i : large)
+			m_bins[i] = Bin();
+		for (int i : small)
+			m_bins[i] = Bin();
+
+		for (int i = 0; i < n; ++i)
+			if (m_bins[i].threshold >= 1.0)
+				m_bins[i].alias = i;
+	}
+
+	int Alias_Table::sample(double u) const
+	{
+		// The integer part of u * n selects the bin, the fractional part chooses bin or alias
+		const double scaled_u = u * m_bins.size();
+		const int bin = std::min((int) scaled_u, (int) m_bins.size() - 1);
+		const double remainder = scaled_u - bin;
+
+		return remainder < m_bins[bin].threshold ? bin : m_bins[bin].alias;
+	}
+}
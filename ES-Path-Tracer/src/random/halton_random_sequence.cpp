@@ -0,0 +1,75 @@
+#include <cstdint>
+
+#include "random/halton_random_sequence.h"
+#include "random/random_number_engine.h"
+
+namespace random
+{
+	static const int PRIMES[Halton_Random_Sequence::NUM_DIMENSIONS] = {
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+		59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+		137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+		227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311
+	};
+
+	Halton_Random_Sequence::Halton_Random_Sequence(std::uint64_t seed, std::uint64_t key)
+		: m_key(hash(seed, key))
+	{
+		for (int dimension = 0; dimension < NUM_DIMENSIONS; ++dimension)
+			m_offsets[dimension] = (hash(m_key, dimension) >> 11) * (1.0 / 9007199254740992.0);
+
+		start_sample(0);
+	}
+
+	void Halton_Random_Sequence::start_sample(std::uint64_t sample)
+	{
+		m_sample = sample;
+		set_dimension(0);
+	}
+
+	void Halton_Random_Sequence::set_dimension(size_t dimension)
+	{
+		m_index = dimension;
+
+		if (dimension >= NUM_DIMENSIONS)
+		{
+			m_engine.set_stream(hash(m_key, m_sample), m_key);
+			m_engine.advance(dimension - NUM_DIMENSIONS);
+		}
+	}
+
+	double Halton_Random_Sequence::next()
+	{
+		const size_t dimension = m_index++;
+
+		if (dimension >= NUM_DIMENSIONS)
+		{
+			// The stream is positioned when the sequence enters the padding dimensions
+			if (dimension == NUM_DIMENSIONS)
+				m_engine.set_stream(hash(m_key, m_sample), m_key);
+			return m_engine.next_double();
+		}
+
+		const double value = radical_inverse(PRIMES[dimension], m_sample) + m_offsets[dimension];
+		return value < 1.0 ? value : value - 1.0;
+	}
+
+	double Halton_Random_Sequence::radical_inverse(int base, std::uint64_t index)
+	{
+		const double inv_base = 1.0 / base;
+		double inv_base_power = 1.0;
+		std::uint64_t reversed_digits = 0;
+
+		while (index)
+		{
+			const std::uint64_t next_index = index / base;
+			reversed_digits = reversed_digits * base + (index - next_index * base);
+			inv_base_power *= inv_base;
+			index = next_index;
+		}
+
+		// Below 1 even when rounding would reach it
+		const double value = reversed_digits * inv_base_power;
+		return value < 1.0 ? value : 0.99999999999999989;
+	}
+}
@@ -1,12 +1,60 @@
+#include <atomic>
+#include <cstdint>
 #include <random>
 
 #include "random/random_number_engine.h"
 
 namespace random
 {
-	std::mt19937& mt_engine_singleton()
+	void PCG32::set_stream(std::uint64_t seed, std::uint64_t stream)
 	{
-		static std::mt19937 mt_engine = std::mt19937(std::random_device()());
-		return mt_engine;
+		m_state = 0;
+		m_increment = (stream << 1u) | 1u;
+		operator()();
+		m_state += seed;
+		operator()();
 	}
-}
\ No newline at end of file
+
+	void PCG32::advance(std::uint64_t delta)
+	{
+		// Jump ahead by composing the affine step delta times, in O(log delta) (Brown, 1994)
+		std::uint64_t accumulated_multiplier = 1;
+		std::uint64_t accumulated_increment = 0;
+		std::uint64_t current_multiplier = MULTIPLIER;
+		std::uint64_t current_increment = m_increment;
+
+		while (delta > 0)
+		{
+			if (delta & 1)
+			{
+				accumulated_multiplier *= current_multiplier;
+				accumulated_increment = accumulated_increment * current_multiplier + current_increment;
+			}
+
+			current_increment = (current_multiplier + 1) * current_increment;
+			current_multiplier *= current_multiplier;
+			delta >>= 1;
+		}
+
+		m_state = accumulated_multiplier * m_state + accumulated_increment;
+	}
+
+	PCG32& thread_engine()
+	{
+		static const std::uint64_t seed =
+			(std::uint64_t(std::random_device()()) << 32) | std::random_device()();
+		static std::atomic<std::uint64_t> next_stream(0);
+
+		thread_local PCG32 engine(seed, next_stream++);
+		return engine;
+	}
+
+	std::uint64_t hash(std::uint64_t a, std::uint64_t b)
+	{
+		// SplitMix64 finalizer applied to the combination of both values
+		std::uint64_t x = a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+}
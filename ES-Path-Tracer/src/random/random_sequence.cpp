@@ -3,6 +3,7 @@
 #include <cmath>
 
 #include "geometry/vector3.h"
+#include "random/random_number_engine.h"
 #include "random/random_sequence.h"
 
 namespace random
@@ -12,6 +13,11 @@ namespace random
 		return next();
 	}
 
+	double Random_Sequence::next_light_sample()
+	{
+		return thread_engine().next_double();
+	}
+
 	Vector3 Random_Sequence::uniform_distributed_hemisphere_sample()
 	{
 		double u = next_element();
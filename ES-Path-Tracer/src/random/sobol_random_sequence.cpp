@@ -0,0 +1,133 @@
+#include <cstdint>
+
+#include "random/random_number_engine.h"
+#include "random/sobol_random_sequence.h"
+
+namespace random
+{
+	/*	Generator matrices of the first four Sobol dimensions, as 32 direction numbers each, and
+		the products of each byte of the index by the matrix, so that a point takes four lookups */
+	struct Sobol_Matrices {
+		std::uint32_t directions[Sobol_Random_Sequence::DIMENSIONS_PER_GROUP][32];
+		std::uint32_t byte_products[Sobol_Random_Sequence::DIMENSIONS_PER_GROUP][4][256];
+
+		Sobol_Matrices()
+		{
+			// Degree, coefficients and initial numbers of the primitive polynomials (Joe & Kuo)
+			static const int degree[] = { 1, 2, 3 };
+			static const std::uint32_t coefficients[] = { 0, 1, 1 };
+			static const std::uint32_t initial[][3] = { { 1 }, { 1, 3 }, { 1, 3, 1 } };
+
+			// The first dimension is the van der Corput sequence
+			for (int bit = 0; bit < 32; ++bit)
+				directions[0][bit] = 1u << (31 - bit);
+
+			for (int dimension = 1; dimension < Sobol_Random_Sequence::DIMENSIONS_PER_GROUP; ++dimension)
+			{
+				const int s = degree[dimension - 1];
+				const std::uint32_t a = coefficients[dimension - 1];
+				std::uint32_t* v = directions[dimension];
+
+				for (int bit = 0; bit < s; ++bit)
+					v[bit] = initial[dimension - 1][bit] << (31 - bit);
+
+				for (int bit = s; bit < 32; ++bit)
+				{
+					v[bit] = v[bit - s] ^ (v[bit - s] >> s);
+
+					for (int j = 1; j < s; ++j)
+						if ((a >> (s - 1 - j)) & 1u)
+							v[bit] ^= v[bit - j];
+				}
+			}
+
+			for (int dimension = 0; dimension < Sobol_Random_Sequence::DIMENSIONS_PER_GROUP; ++dimension)
+			{
+				for (int byte = 0; byte < 4; ++byte)
+				{
+					for (std::uint32_t value = 0; value < 256; ++value)
+					{
+						std::uint32_t product = 0;
+						for (int bit = 0; bit < 8; ++bit)
+							if ((value >> bit) & 1u)
+								product ^= directions[dimension][8 * byte + bit];
+						byte_products[dimension][byte][value] = product;
+					}
+				}
+			}
+		}
+	};
+
+	Sobol_Random_Sequence::Sobol_Random_Sequence(std::uint64_t seed, std::uint64_t key)
+		: m_key(hash(seed, key)), m_group(-1)
+	{
+		start_sample(0);
+	}
+
+	void Sobol_Random_Sequence::start_sample(std::uint64_t sample)
+	{
+		m_sample = sample;
+		m_index = 0;
+		m_group = -1;
+	}
+
+	void Sobol_Random_Sequence::set_dimension(size_t dimension)
+	{
+		m_index = dimension;
+	}
+
+	double Sobol_Random_Sequence::next()
+	{
+		const size_t group = m_index / DIMENSIONS_PER_GROUP;
+
+		if ((long long) group != m_group)
+			compute_group(group);
+
+		return m_point[m_index++ % DIMENSIONS_PER_GROUP];
+	}
+
+	void Sobol_Random_Sequence::compute_group(size_t group)
+	{
+		const std::uint64_t group_seed = hash(m_key, group);
+		const std::uint32_t index = nested_uniform_scramble((std::uint32_t) m_sample, (std::uint32_t) group_seed);
+
+		for (int dimension = 0; dimension < DIMENSIONS_PER_GROUP; ++dimension)
+		{
+			const std::uint32_t seed = (std::uint32_t) hash(group_seed, dimension);
+			m_point[dimension] = nested_uniform_scramble(sobol(index, dimension), seed) * (1.0 / 4294967296.0);
+		}
+
+		m_group = (long long) group;
+	}
+
+	std::uint32_t Sobol_Random_Sequence::sobol(std::uint32_t index, int dimension)
+	{
+		static const Sobol_Matrices matrices;
+		const std::uint32_t (*products)[256] = matrices.byte_products[dimension];
+
+		return products[0][index & 0xFFu] ^ products[1][(index >> 8) & 0xFFu]
+			^ products[2][(index >> 16) & 0xFFu] ^ products[3][index >> 24];
+	}
+
+	std::uint32_t Sobol_Random_Sequence::nested_uniform_scramble(std::uint32_t value, std::uint32_t seed)
+	{
+		// Laine-Karras style permutation on the reversed bits, which scrambles each bit by the 
+		// bits above it, as Owen scrambling does
+		value = reverse_bits(value);
+		value += seed;
+		value ^= value * 0x6c50b47cu;
+		value ^= value * 0xb82f1e52u;
+		value ^= value * 0xc7afe638u;
+		value ^= value * 0x8d22f6e6u;
+		return reverse_bits(value);
+	}
+
+	std::uint32_t Sobol_Random_Sequence::reverse_bits(std::uint32_t value)
+	{
+		value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+		value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+		value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+		value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+		return (value >> 16) | (value << 16);
+	}
+}
@@ -1,22 +1,46 @@
-#include <cmath>
-#include <random>
-#include <vector>
+#include <cstdint>
 
+#include "random/random_number_engine.h"
 #include "random/uniform_random_sequence.h"
 
 namespace random
 {
-	double Uniform_Random_Sequence::next()
+	Uniform_Random_Sequence::Uniform_Random_Sequence()
+		: m_key(hash(thread_engine()(), thread_engine()()))
 	{
-		if (m_index < sequence.size())
-			return sequence[m_index++];
-    
-		std::uniform_real_distribution<double> dist(0.0, 1.0);
-		double r = dist(m_mt_engine);
+		start_sample(0);
+	}
 
-		sequence.push_back(r);
-		++m_index;
+	Uniform_Random_Sequence::Uniform_Random_Sequence(std::uint64_t seed, std::uint64_t key)
+		: m_key(hash(seed, key))
+	{
+		start_sample(0);
+	}
+
+	void Uniform_Random_Sequence::start_sample(std::uint64_t sample)
+	{
+		m_sample = sample;
+		m_engine.set_stream(hash(m_key, sample), m_key);
+		m_index = 0;
+	}
 
-		return r;
+	void Uniform_Random_Sequence::set_dimension(size_t dimension)
+	{
+		// Each dimension takes one number of the sample's stream. Dimensions are mostly read in
+		// order, so the stream is only restarted to go back
+		if (dimension < m_index)
+		{
+			m_engine.set_stream(hash(m_key, m_sample), m_key);
+			m_index = 0;
+		}
+
+		m_engine.advance(dimension - m_index);
+		m_index = dimension;
+	}
+
+	double Uniform_Random_Sequence::next()
+	{
+		++m_index;
+		return m_engine.next_double();
 	}
-}
\ No newline at end of file
+}
@@ -1,8 +1,9 @@
-#include <random>
+#include <cmath>
 #include <vector>
 
+#include "geometry/ray_packet.h"
 #include "geometry/triangle.h"
-#include "random/random_number_engine.h"
+#include "random/alias_table.h"
 #include "scene/area_light.h"
 #include "scene/light.h"
 #include "shading/color3.h"
@@ -10,7 +11,8 @@
 namespace scene
 {
     Area_Light::Area_Light(const Radiance3& m_power, const std::vector<const Triangle*>& triangles)
-        : Light(m_power), m_area(total_area(triangles)), m_kd_tree(triangles), m_triangles(triangles) {}
+        : Light(m_power), m_area(total_area(triangles)), m_kd_tree(triangles), m_triangles(triangles),
+		m_triangle_selection(triangle_areas(triangles)) {}
 
 	bool Area_Light::intersect(const Ray& ray, double& t, Surface_Element& surfel) const
     {
@@ -19,33 +21,56 @@ namespace scene
 		if (!triangle)
 			return false;
 
+		return fill_surface_element(ray, *triangle, t, surfel);
+    }
+
+	int Area_Light::intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+		Surface_Element surfels[Ray_Packet::SIZE]) const
+	{
+		const Triangle* triangles[Ray_Packet::SIZE];
+		m_kd_tree.intersect(packet, mask, triangles);
+
+		int hit_mask = 0;
+
+		for (int i = 0; i < packet.size(); ++i)
+			if (triangles[i] && fill_surface_element(packet.ray(i), *triangles[i], t[i], surfels[i]))
+				hit_mask |= 1 << i;
+
+		return hit_mask;
+	}
+
+	bool Area_Light::fill_surface_element(const Ray& ray, const Triangle& triangle, double& t,
+		Surface_Element& surfel) const
+	{
 		std::vector<double> bar_weights;
-		if (!ray.intersect(*triangle, t, bar_weights))
+		if (!ray.intersect(triangle, t, bar_weights))
 			return false;
 
-		surfel.geometric.normal = triangle->normal();
+		surfel.geometric.normal = triangle.normal();
 		surfel.geometric.position = ray.origin + t * ray.direction;
+		surfel.geometric.triangle = &triangle;
 		surfel.material.emit = m_power;
 		return true;
-    }
+	}
 
-	void Area_Light::sample_point(Point3& sample_position, Vector3& sample_normal) const
+	void Area_Light::sample_point(const Triangle& triangle, double u, double v, 
+		Point3& sample_position, Vector3& sample_normal) const
 	{
-		const Triangle& triangle = *sample_triangle();
-		
-		std::uniform_real_distribution<double> dist(0.0, 1.0);
-		double alpha = dist(random::mt_engine_singleton());
-		double beta = dist(random::mt_engine_singleton());
+		double sqrt_u = std::sqrt(u);
+
+		// Barycentric weights uniformly distributed over the triangle
+		double alpha = 1.0 - sqrt_u;
+		double beta = v * sqrt_u;
 		double gamma = 1.0 - alpha - beta;
 
 		sample_normal = triangle.normal();
 		sample_position = Point3(
 			(alpha * triangle.vertex(0)->x) + (beta * triangle.vertex(1)->x)
-				+ (gamma * triangle.vertex(3)->x),
+				+ (gamma * triangle.vertex(2)->x),
 			(alpha * triangle.vertex(0)->y) + (beta * triangle.vertex(1)->y)
-				+ (gamma * triangle.vertex(3)->y),
+				+ (gamma * triangle.vertex(2)->y),
 			(alpha * triangle.vertex(0)->z) + (beta * triangle.vertex(1)->z)
-				+ (gamma * triangle.vertex(3)->z)
+				+ (gamma * triangle.vertex(2)->z)
 		);
 	}
 
@@ -59,19 +84,18 @@ namespace scene
 		return total_area;
 	}
 
-	const Triangle* Area_Light::sample_triangle() const
+	std::vector<double> Area_Light::triangle_areas(const std::vector<const Triangle*>& triangles)
+	{
+		std::vector<double> areas;
+
+		for (const Triangle* triangle : triangles)
+			areas.push_back(triangle->area());
+
+		return areas;
+	}
+
+	const Triangle& Area_Light::sample_triangle(double u) const
 	{
-		std::uniform_real_distribution<double> dist(0.0, 1.0);
-		double random_number = dist(random::mt_engine_singleton());
-		double inv_total_area = 1.0 / m_area;
-
-		for (const Triangle* triangle : m_triangles)
-		{
-			random_number -= triangle->area() * inv_total_area;
-			if (random_number <= 0.0)
-				return triangle;
-		}
-
-		return m_triangles.back();
+		return *m_triangles[m_triangle_selection.sample(u)];
 	}
 }
\ No newline at end of file
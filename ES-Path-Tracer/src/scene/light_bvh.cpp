@@ -0,0 +1,248 @@
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry/aab.h"
+#include "geometry/point3.h"
+#include "geometry/triangle.h"
+#include "geometry/vector3.h"
+#include "scene/area_light.h"
+#include "scene/light_bvh.h"
+
+namespace scene
+{
+	Light_BVH::Light_BVH(const std::vector<Area_Light*>& area_lights)
+	{
+		std::vector<Emitter> emitters;
+
+		for (const Area_Light* light : area_lights)
+		{
+			for (const Triangle* triangle : light->triangles())
+			{
+				const Point3 centroid(
+					(triangle->vertex(0)->x + triangle->vertex(1)->x + triangle->vertex(2)->x) / 3.0,
+					(triangle->vertex(0)->y + triangle->vertex(1)->y + triangle->vertex(2)->y) / 3.0,
+					(triangle->vertex(0)->z + triangle->vertex(1)->z + triangle->vertex(2)->z) / 3.0);
+				emitters.push_back(Emitter(triangle, light, centroid));
+			}
+		}
+
+		if (emitters.empty())
+			return;
+
+		m_nodes.reserve(2 * emitters.size() - 1);
+		build(emitters, 0, emitters.size(), -1);
+	}
+
+	int Light_BVH::build(std::vector<Emitter>& emitters, size_t begin, size_t end, int parent)
+	{
+		const int index = (int) m_nodes.size();
+		m_nodes.push_back(Node());
+		m_nodes[index].parent = parent;
+
+		if (end - begin == 1)
+		{
+			const Emitter& emitter = emitters[begin];
+			const Triangle& triangle = *emitter.triangle;
+			Node& leaf = m_nodes[index];
+
+			leaf.triangle = emitter.triangle;
+			leaf.light = emitter.light;
+			leaf.axis = triangle.normal();
+			leaf.cone_angle = 0;
+			leaf.power = triangle.area() * (emitter.light->m_power.r + emitter.light->m_power.g
+				+ emitter.light->m_power.b) / 3.0;
+			leaf.bounds = AAB(
+				std::min({ triangle.vertex(0)->x, triangle.vertex(1)->x, triangle.vertex(2)->x }),
+				std::max({ triangle.vertex(0)->x, triangle.vertex(1)->x, triangle.vertex(2)->x }),
+				std::min({ triangle.vertex(0)->y, triangle.vertex(1)->y, triangle.vertex(2)->y }),
+				std::max({ triangle.vertex(0)->y, triangle.vertex(1)->y, triangle.vertex(2)->y }),
+				std::min({ triangle.vertex(0)->z, triangle.vertex(1)->z, triangle.vertex(2)->z }),
+				std::max({ triangle.vertex(0)->z, triangle.vertex(1)->z, triangle.vertex(2)->z }));
+
+			m_leaves[emitter.triangle] = index;
+			return index;
+		}
+
+		// Split at the median centroid along the axis where centroids spread the most
+		Point3 min_centroid(emitters[begin].centroid), max_centroid(emitters[begin].centroid);
+
+		for (size_t i = begin + 1; i < end; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				min_centroid[axis] = std::min(min_centroid[axis], emitters[i].centroid[axis]);
+				max_centroid[axis] = std::max(max_centroid[axis], emitters[i].centroid[axis]);
+			}
+		}
+
+		int split_axis = 0;
+		for (int axis = 1; axis < 3; ++axis)
+			if (max_centroid[axis] - min_centroid[axis] > max_centroid[split_axis] - min_centroid[split_axis])
+				split_axis = axis;
+
+		const size_t middle = begin + (end - begin) / 2;
+		std::nth_element(emitters.begin() + begin, emitters.begin() + middle, emitters.begin() + end,
+			[split_axis](const Emitter& a, const Emitter& b)
+			{
+				return a.centroid[split_axis] < b.centroid[split_axis];
+			});
+
+		const int left = build(emitters, begin, middle, index);
+		const int right = build(emitters, middle, end, index);
+
+		m_nodes[index].right = right;
+		merge(m_nodes[index], m_nodes[left], m_nodes[right]);
+
+		return index;
+	}
+
+	void Light_BVH::merge(Node& node, const Node& left, const Node& right)
+	{
+		node.power = left.power + right.power;
+		node.bounds = AAB(
+			std::min(left.bounds.min_x, right.bounds.min_x),
+			std::max(left.bounds.max_x, right.bounds.max_x),
+			std::min(left.bounds.min_y, right.bounds.min_y),
+			std::max(left.bounds.max_y, right.bounds.max_y),
+			std::min(left.bounds.min_z, right.bounds.min_z),
+			std::max(left.bounds.max_z, right.bounds.max_z));
+
+		// Smallest cone around the wider child's axis that also contains the other cone
+		const Node& wide = left.cone_angle >= right.cone_angle ? left : right;
+		const Node& narrow = left.cone_angle >= right.cone_angle ? right : left;
+
+		const double angle_between = std::acos(
+			std::min(1.0, std::max(-1.0, dot_prod(wide.axis, narrow.axis))));
+
+		if (std::min(angle_between + narrow.cone_angle, M_PI) <= wide.cone_angle)
+		{
+			node.axis = wide.axis;
+			node.cone_angle = wide.cone_angle;
+			return;
+		}
+
+		const double cone_angle = 0.5 * (wide.cone_angle + angle_between + narrow.cone_angle);
+
+		if (cone_angle >= M_PI || std::sin(angle_between) < 1e-6)
+		{
+			node.axis = wide.axis;
+			node.cone_angle = M_PI;
+			return;
+		}
+
+		// Rotate the wide axis towards the narrow one
+		const double rotation = cone_angle - wide.cone_angle;
+		node.axis = ((std::sin(angle_between - rotation) * wide.axis)
+			+ (std::sin(rotation) * narrow.axis)) / std::sin(angle_between);
+		node.axis = node.axis.normalize();
+		node.cone_angle = cone_angle;
+	}
+
+	double Light_BVH::importance(const Node& node, const Point3& position) const
+	{
+		const Point3 center(
+			0.5 * (node.bounds.min_x + node.bounds.max_x),
+			0.5 * (node.bounds.min_y + node.bounds.max_y),
+			0.5 * (node.bounds.min_z + node.bounds.max_z));
+		const Vector3 half_diagonal(center, Point3(node.bounds.max_x, node.bounds.max_y,
+			node.bounds.max_z));
+		const double radius = half_diagonal.magnitude();
+
+		Vector3 to_position(center, position);
+		const double distance = to_position.magnitude();
+
+		// Points inside the bounds may receive light from any direction
+		if (distance <= radius)
+			return node.power / std::max(radius * radius, 1e-12);
+
+		to_position /= distance;
+
+		// Smallest angle between a normal in the cone and a direction towards the point
+		const double angle = std::acos(std::min(1.0, std::max(-1.0, dot_prod(node.axis, to_position))));
+		const double bounds_angle = std::asin(radius / distance);
+		const double min_angle = std::max(0.0, angle - node.cone_angle - bounds_angle);
+
+		// Emitters are one-sided
+		if (min_angle >= 0.5 * M_PI)
+			return 0;
+
+		return node.power * std::cos(min_angle) / (distance * distance);
+	}
+
+	double Light_BVH::left_probability(int node, const Point3& position) const
+	{
+		const Node& left = m_nodes[node + 1];
+		const Node& right = m_nodes[m_nodes[node].right];
+
+		const double left_importance = importance(left, position);
+		const double right_importance = importance(right, position);
+
+		// No child is expected to light the point, fall back to power
+		if (left_importance + right_importance <= 0)
+		{
+			if (left.power + right.power <= 0)
+				return 0.5;
+			return left.power / (left.power + right.power);
+		}
+
+		return left_importance / (left_importance + right_importance);
+	}
+
+	const Triangle& Light_BVH::sample(const Point3& position, double u, const Area_Light*& light,
+		double& probability) const
+	{
+		if (m_nodes.empty())
+			throw std::logic_error("No lights in the hierarchy");
+
+		int node = 0;
+		probability = 1;
+
+		while (!m_nodes[node].is_leaf())
+		{
+			const double p_left = left_probability(node, position);
+
+			// Reuse u for the next level by rescaling the part of [0, 1) of the chosen child
+			if (u < p_left)
+			{
+				u /= p_left;
+				probability *= p_left;
+				node = node + 1;
+			}
+			else
+			{
+				u = (u - p_left) / (1 - p_left);
+				probability *= 1 - p_left;
+				node = m_nodes[node].right;
+			}
+
+			u = std::min(u, 1.0 - 1e-12);
+		}
+
+		light = m_nodes[node].light;
+		return *m_nodes[node].triangle;
+	}
+
+	double Light_BVH::probability(const Point3& position, const Triangle& triangle) const
+	{
+		const std::unordered_map<const Triangle*, int>::const_iterator it = m_leaves.find(&triangle);
+
+		if (it == m_leaves.end())
+			return 0;
+
+		double probability = 1;
+
+		for (int child = it->second, node = m_nodes[child].parent; node >= 0;
+			child = node, node = m_nodes[node].parent)
+		{
+			const double p_left = left_probability(node, position);
+			probability *= (child == node + 1) ? p_left : 1 - p_left;
+		}
+
+		return probability;
+	}
+}
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "geometry/ray.h"
+#include "geometry/ray_packet.h"
 #include "geometry/triangle.h"
 #include "scene/mesh_object.h"
 #include "scene/object.h"
@@ -22,29 +23,55 @@ namespace scene
         if (!tri_ptr)
             return false;
 
+        fill_surface_element(ray, *tri_ptr, t, surfel);
+        return true;
+    }
+
+	int Mesh_Object::intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+		Surface_Element surfels[Ray_Packet::SIZE]) const
+	{
+		const Triangle* triangles[Ray_Packet::SIZE];
+		m_kd_tree.intersect(packet, mask, triangles);
+
+		int hit_mask = 0;
+
+		for (int i = 0; i < packet.size(); ++i)
+		{
+			if (!triangles[i])
+				continue;
+
+			fill_surface_element(packet.ray(i), *triangles[i], t[i], surfels[i]);
+			hit_mask |= 1 << i;
+		}
+
+		return hit_mask;
+	}
+
+	void Mesh_Object::fill_surface_element(const Ray &ray, const Triangle& triangle, double &t,
+		Surface_Element& surfel) const
+	{
         std::vector<double> bar_weights;
-        ray.intersect(*tri_ptr, t, bar_weights);
+        ray.intersect(triangle, t, bar_weights);
 
         // Compute the shading normal
-        surfel.shading.normal = bar_weights[0] * (*tri_ptr->normal(0)) + 
-            bar_weights[1] * (*tri_ptr->normal(1)) + 
-            bar_weights[2] * (*tri_ptr->normal(2));
+        surfel.shading.normal = bar_weights[0] * (*triangle.normal(0)) + 
+            bar_weights[1] * (*triangle.normal(1)) + 
+            bar_weights[2] * (*triangle.normal(2));
         
         // Compute the geometric normal
-        surfel.geometric.normal = tri_ptr->normal();
+        surfel.geometric.normal = triangle.normal();
         
         // Compute the geometric position
         surfel.geometric.position = ray.origin + t * ray.direction;
+		surfel.geometric.triangle = &triangle;
         
 		// Compute the tangent plane vectors
-        const Vector3& edge = Vector3(*tri_ptr->vertex(0), *tri_ptr->vertex(2));
+        const Vector3& edge = Vector3(*triangle.vertex(0), *triangle.vertex(2));
 		surfel.geometric.tangent0 = edge;
 		surfel.geometric.tangent1 = cross_prod(edge, surfel.geometric.normal);
 
 		surfel.material = m_material;
-
-        return true;
-    }
+	}
 
     const AAB& Mesh_Object::aabb() const
     {
@@ -1,11 +1,18 @@
+#include <algorithm>
 #include <vector>
 #include <cfloat>
 
 #include "shading/color3.h"
+#include "geometry/aab.h"
+#include "geometry/ray_packet.h"
 #include "geometry/vector3.h"
+#include "random/alias_table.h"
+#include "scene/light_bvh.h"
 #include "scene/object.h"
 #include "scene/scene.h"
 #include "shading/surface_element.h"
+#include "stats/render_stats.h"
+#include "stats/trace.h"
 
 using std::vector;
 
@@ -29,12 +36,57 @@ namespace scene
 		//m_point_lights.clear();
 		m_area_lights.clear();
 		m_total_light_area = 0;
+		m_light_selection = random::Alias_Table();
+		m_light_bvh = Light_BVH();
+		m_lights_finalized = true;
+		m_aabb = AAB();
+	}
+
+	void Scene::add_object(Object* ptr)
+	{
+		expand_aabb(ptr->aabb());
+		m_objects.push_back(ptr);
 	}
 
 	void Scene::add_area_light(Area_Light* ptr)
 	{
+		expand_aabb(ptr->aabb());
 		m_area_lights.push_back(ptr);
 		m_total_light_area += ptr->area();
+		m_lights_finalized = false;
+	}
+
+	void Scene::finalize()
+	{
+		if (m_lights_finalized)
+			return;
+
+		STATS_PHASE_TIMER(stats::ACCELERATOR_BUILD_PHASE);
+		TRACE_SPAN("light selection build", "build");
+
+		std::vector<double> light_areas;
+		for (const Area_Light* area_light : m_area_lights)
+			light_areas.push_back(area_light->area());
+		m_light_selection = random::Alias_Table(light_areas);
+		m_light_bvh = Light_BVH(m_area_lights);
+		m_lights_finalized = true;
+	}
+
+	void Scene::expand_aabb(const AAB& aabb)
+	{
+		if (m_objects.empty() && m_area_lights.empty())
+		{
+			m_aabb = aabb;
+			return;
+		}
+
+		m_aabb = AAB(
+			std::min(m_aabb.min_x, aabb.min_x),
+			std::max(m_aabb.max_x, aabb.max_x),
+			std::min(m_aabb.min_y, aabb.min_y),
+			std::max(m_aabb.max_y, aabb.max_y),
+			std::min(m_aabb.min_z, aabb.min_z),
+			std::max(m_aabb.max_z, aabb.max_z));
 	}
 
     bool Scene::intersect(const Ray& ray, double& t, Surface_Element& result,
@@ -72,4 +124,48 @@ namespace scene
 
         return found_intersection;
     }
+
+	int Scene::intersect(const Ray_Packet& packet, int mask, double t[Ray_Packet::SIZE],
+		Surface_Element result[Ray_Packet::SIZE], const double refractive_indices[Ray_Packet::SIZE]) const
+	{
+		int found_mask = 0;
+		double hit_t[Ray_Packet::SIZE];
+
+		// Objects only fill the members of their own surfaces, so each one gets fresh surfels
+		for (const Object* obj : m_objects)
+		{
+			Surface_Element surfels[Ray_Packet::SIZE];
+			int hit_mask = obj->intersect(packet, mask, hit_t, surfels);
+
+			for (int i = 0; i < Ray_Packet::SIZE; ++i)
+			{
+				if ((hit_mask & (1 << i)) && hit_t[i] < t[i])
+				{
+					t[i] = hit_t[i];
+					surfels[i].material.refractive_index_exterior = refractive_indices[i];
+					result[i] = surfels[i];
+					found_mask |= 1 << i;
+				}
+			}
+		}
+
+		for (const Area_Light* area_light : m_area_lights)
+		{
+			Surface_Element surfels[Ray_Packet::SIZE];
+			int hit_mask = area_light->intersect(packet, mask, hit_t, surfels);
+
+			for (int i = 0; i < Ray_Packet::SIZE; ++i)
+			{
+				if ((hit_mask & (1 << i)) && hit_t[i] < t[i])
+				{
+					t[i] = hit_t[i];
+					surfels[i].material.refractive_index_exterior = refractive_indices[i];
+					result[i] = surfels[i];
+					found_mask |= 1 << i;
+				}
+			}
+		}
+
+		return found_mask;
+	}
 }
\ No newline at end of file
@@ -48,6 +48,7 @@ namespace scene
 		surfel.geometric.position = ray.origin + (t * ray.direction);
 		const Vector3& normal = (surfel.geometric.position - m_center).normalize();
 		surfel.geometric.normal = normal;
+		surfel.geometric.triangle = nullptr;
 		surfel.shading.normal = normal;
 		surfel.material = m_material;
 
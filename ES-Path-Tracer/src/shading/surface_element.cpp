@@ -16,16 +16,24 @@ namespace scene
 		const Vector3& w_i,
 		Vector3& w_o,
 		Color3& coefficient, 
-		random::Random_Sequence& rnd) const
+		random::Random_Sequence& rnd,
+		bool& delta) const
     {
 		const Vector3& inv_geometric_normal = -1 * geometric.normal;
 		const Vector3& normal = dot_prod(w_i, inv_geometric_normal) > 0
 			? geometric.normal
 			: inv_geometric_normal;
 
-        /*  Choose a next number on [0, 1], then reduce it by each kind of 
-            scatering's probability until it becomes negative */
-        double r = rnd.next();
+		/*	Choose a next number on [0, total), then reduce it by each kind of scattering's 
+			probability until it becomes negative. Lobes are chosen in proportion to their 
+			reflectance and the path is never absorbed here: the coefficient keeps the lobe's 
+			reflectance, so that the path's throughput falls with it and Russian roulette 
+			terminates the path */
+		const double total = scatter_probability();
+		if (total <= 0.0)
+			return false;
+
+        double r = rnd.next() * total;
         
 		static const Color3& zero_color = Color3::zero();
 		static const Vector3& zero_vector = Vector3(0.0);
@@ -33,13 +41,13 @@ namespace scene
         // Lambertian scattering
         if (material.lambertian_reflect != zero_color)
         {
-            double prob_lambertian_avg = (material.lambertian_reflect[0]
-				+ material.lambertian_reflect[1] + material.lambertian_reflect[2]) / 3.0;
+            double prob_lambertian_avg = lobe_probability(material.lambertian_reflect);
             r -= prob_lambertian_avg;
             
             if (r < 0.0)
             {
-				coefficient = material.lambertian_reflect / prob_lambertian_avg;
+				coefficient = material.lambertian_reflect * (total / prob_lambertian_avg);
+				delta = false;
 				Vector3 sample = rnd.cos_distributed_hemisphere_sample();
 				w_o = (sample[0] * geometric.tangent0)
 					+ (sample[1] * normal)
@@ -51,14 +59,14 @@ namespace scene
         // Specular scattering
         if (material.specular_reflect != zero_color)
         {
-            const double prob_specular_avg = (material.specular_reflect[0] 
-					+ material.specular_reflect[1] + material.specular_reflect[2]) / 3.0;
+            const double prob_specular_avg = lobe_probability(material.specular_reflect);
             r -= prob_specular_avg;
 
             if (r < 0.0)
             {
                 w_o = mirror_reflect(w_i);
-				coefficient = material.specular_reflect / prob_specular_avg;
+				coefficient = material.specular_reflect * (total / prob_specular_avg);
+				delta = true;
                 return true;
             }
         }
@@ -66,13 +74,13 @@ namespace scene
         // Transmissive scattering
         if (material.transmit != zero_color)
         {
-            const double prob_transmit_avg = (material.transmit[0] + material.transmit[1]
-				+ material.transmit[2]) / 3.0;
+            const double prob_transmit_avg = lobe_probability(material.transmit);
             r -= prob_transmit_avg;
 
             if (r < 0.0)
             {
-                coefficient = material.transmit / prob_transmit_avg;
+                coefficient = material.transmit * (total / prob_transmit_avg);
+				delta = true;
                 w_o = refract(w_i);
                 return w_o != zero_vector;    // w_o is zero on total internal refraction
             }
@@ -82,6 +90,24 @@ namespace scene
         return false;
     }
 
+	double Surface_Element::scatter_pdf(const Vector3& w_i, const Vector3& w_o) const
+	{
+		const Vector3& inv_geometric_normal = -1 * geometric.normal;
+		const Vector3& normal = dot_prod(w_i, inv_geometric_normal) > 0
+			? geometric.normal
+			: inv_geometric_normal;
+
+		const double cosine = dot_prod(w_o, normal);
+
+		if (cosine <= 0.0 || material.lambertian_reflect == Color3::zero())
+			return 0.0;
+
+		static const double inv_pi = 1.0 / M_PI;
+
+		// Lobes are chosen relative to the total probability
+		return lobe_probability(material.lambertian_reflect) / scatter_probability() * cosine * inv_pi;
+	}
+
 	// Assumes both vectors point outwards
 	Radiance3 Surface_Element::evaluate_bsdf(const Vector3& w_i, const Vector3& w_o) const
 	{
@@ -114,6 +140,32 @@ namespace scene
 		return specular_part + diffuse_part;
 	}
 
+	Radiance3 Surface_Element::evaluate_lambertian_bsdf(const Vector3& w_i, const Vector3& w_o) const
+	{
+		const Vector3& geometric_normal = dot_prod(w_i, geometric.normal) > 0
+			? geometric.normal
+			: -1 * geometric.normal;
+		const Vector3& shading_normal = geometric_normal == geometric.normal
+			? shading.normal
+			: geometric_normal;
+
+		if (dot_prod(w_o, geometric_normal) < 0)
+			return Radiance3(0.0);
+
+		return std::max(0.0, dot_prod(w_i, shading_normal)) * material.lambertian_reflect;
+	}
+
+	double Surface_Element::lobe_probability(const Color3& lobe_color)
+	{
+		return (lobe_color[0] + lobe_color[1] + lobe_color[2]) / 3.0;
+	}
+
+	double Surface_Element::scatter_probability() const
+	{
+		return lobe_probability(material.lambertian_reflect) + lobe_probability(material.specular_reflect)
+			+ lobe_probability(material.transmit);
+	}
+
 	// Assumes incoming is pointing inwards
 	Vector3 Surface_Element::mirror_reflect(const Vector3& incoming, Vector3 normal) const
 	{
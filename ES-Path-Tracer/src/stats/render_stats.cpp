@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <ostream>
+
+#include "image/aligned_allocator.h"
+#include "stats/render_stats.h"
+
+// Names of the counters in JSON, and their labels in the table, in the order of stats::Counter
+static const char* const COUNTER_NAMES[] = {
+	"eye_rays",
+	"indirect_rays",
+	"shadow_rays",
+	"kd_tree_nodes",
+	"triangle_tests",
+	"samples",
+	"fitness_evaluations",
+	"generations"
+};
+
+static const char* const COUNTER_LABELS[] = {
+	"Eye rays",
+	"Indirect rays",
+	"Shadow rays",
+	"Kd-tree nodes visited",
+	"Triangle tests",
+	"Samples",
+	"ES fitness evaluations",
+	"ES generations"
+};
+
+static const char* const PHASE_NAMES[] = { "scene_build", "accelerator_build", "render", "output" };
+static const char* const PHASE_LABELS[] = { "Scene build", "Accelerator build", "Render", "Output" };
+
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == stats::NUM_COUNTERS, "Missing counter name");
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == stats::NUM_PHASES, "Missing phase name");
+
+/*	Counters of every thread that has counted, protected by registry_lock. A list keeps their 
+	addresses, and its allocator the alignment that operator new does not guarantee */
+typedef std::list<stats::Thread_Counters, 
+	Aligned_Allocator<stats::Thread_Counters, stats::CACHE_LINE_SIZE>> Counters_Registry;
+
+static std::mutex registry_lock;
+static Counters_Registry& registry()
+{
+	static Counters_Registry counters;
+	return counters;
+}
+
+static void clear(stats::Thread_Counters& counters)
+{
+	std::fill(counters.counters, counters.counters + stats::NUM_COUNTERS, 0);
+	std::fill(counters.path_lengths, counters.path_lengths + stats::MAX_PATH_LENGTH + 1, 0);
+	std::fill(counters.phase_seconds, counters.phase_seconds + stats::NUM_PHASES, 0.0);
+}
+
+namespace stats
+{
+	// ============================================================================
+	// ============================ COUNTING FUNCTIONS ============================
+	// ============================================================================
+
+	Thread_Counters& thread_counters()
+	{
+		// Only the first call of each thread takes the lock
+		static thread_local Thread_Counters* counters = nullptr;
+
+		if (!counters)
+		{
+			std::lock_guard<std::mutex> lock(registry_lock);
+			registry().emplace_back();
+			counters = &registry().back();
+			clear(*counters);
+		}
+
+		return *counters;
+	}
+
+	Render_Stats::Render_Stats() : m_num_pixels(0)
+	{
+		clear(m_totals);
+	}
+
+	Render_Stats Render_Stats::collect()
+	{
+		Render_Stats stats;
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		for (const Thread_Counters& counters : registry())
+		{
+			for (int i = 0; i < NUM_COUNTERS; ++i)
+				stats.m_totals.counters[i] += counters.counters[i];
+			for (int i = 0; i <= MAX_PATH_LENGTH; ++i)
+				stats.m_totals.path_lengths[i] += counters.path_lengths[i];
+			for (int i = 0; i < NUM_PHASES; ++i)
+				stats.m_totals.phase_seconds[i] += counters.phase_seconds[i];
+		}
+
+		return stats;
+	}
+
+	void Render_Stats::reset()
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		for (Thread_Counters& counters : registry())
+			clear(counters);
+	}
+
+	double Render_Stats::samples_per_pixel() const
+	{
+		return m_num_pixels > 0 ? (double) m_totals.counters[SAMPLES] / m_num_pixels : 0.0;
+	}
+
+	double Render_Stats::mean_path_length() const
+	{
+		std::uint64_t num_paths = 0;
+		double bounces = 0.0;
+
+		for (int i = 0; i <= MAX_PATH_LENGTH; ++i)
+		{
+			num_paths += m_totals.path_lengths[i];
+			bounces += (double) i * m_totals.path_lengths[i];
+		}
+
+		return num_paths > 0 ? bounces / num_paths : 0.0;
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ============================= OUTPUT FUNCTIONS =============================
+	// ============================================================================
+
+	void Render_Stats::write_json(std::ostream& out) const
+	{
+		out << "{\n  \"counters\": {";
+		for (int i = 0; i < NUM_COUNTERS; ++i)
+			out << (i ? "," : "") << "\n    \"" << COUNTER_NAMES[i] << "\": " << m_totals.counters[i];
+
+		out << "\n  },\n  \"pixels\": " << m_num_pixels
+			<< ",\n  \"samples_per_pixel\": " << samples_per_pixel()
+			<< ",\n  \"mean_path_length\": " << mean_path_length();
+
+		// The last bar counts the paths of MAX_PATH_LENGTH bounces or more
+		out << ",\n  \"path_lengths\": [";
+		for (int i = 0; i <= MAX_PATH_LENGTH; ++i)
+			out << (i ? ", " : "") << m_totals.path_lengths[i];
+
+		out << "],\n  \"phase_ms\": {";
+		for (int i = 0; i < NUM_PHASES; ++i)
+			out << (i ? "," : "") << "\n    \"" << PHASE_NAMES[i] << "\": " << 1000.0 * m_totals.phase_seconds[i];
+
+		out << "\n  }\n}\n";
+	}
+
+	void Render_Stats::write_table(std::ostream& out) const
+	{
+		const std::ios::fmtflags flags = out.flags();
+		const std::streamsize precision = out.precision();
+		out << std::fixed << std::setprecision(2);
+
+		out << "Render statistics" << std::endl;
+		for (int i = 0; i < NUM_COUNTERS; ++i)
+			out << "  " << std::left << std::setw(26) << COUNTER_LABELS[i]
+				<< std::right << std::setw(16) << m_totals.counters[i] << std::endl;
+
+		out << "  " << std::left << std::setw(26) << "Samples per pixel"
+			<< std::right << std::setw(16) << samples_per_pixel() << std::endl;
+
+		std::uint64_t num_paths = 0;
+		for (int i = 0; i <= MAX_PATH_LENGTH; ++i)
+			num_paths += m_totals.path_lengths[i];
+
+		out << "Path lengths (mean " << mean_path_length() << " bounces)" << std::endl;
+		for (int i = 0; i <= MAX_PATH_LENGTH; ++i)
+		{
+			if (!m_totals.path_lengths[i])
+				continue;
+
+			out << "  " << std::right << std::setw(3) << i << (i == MAX_PATH_LENGTH ? "+" : " ")
+				<< std::setw(16) << m_totals.path_lengths[i]
+				<< std::setw(9) << 100.0 * m_totals.path_lengths[i] / num_paths << " %" << std::endl;
+		}
+
+		out << "Phase times (ms)" << std::endl;
+		for (int i = 0; i < NUM_PHASES; ++i)
+			out << "  " << std::left << std::setw(26) << PHASE_LABELS[i]
+				<< std::right << std::setw(16) << 1000.0 * m_totals.phase_seconds[i] << std::endl;
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	// ============================================================================
+}
@@ -0,0 +1,190 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "stats/trace.h"
+
+// Spans of one thread, written only by that thread
+struct Thread_Trace {
+	int id;
+	std::string name;
+	std::vector<stats::Trace_Event> events;
+	long long dropped_events;
+};
+
+// Timestamps are taken from the start of the program
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// Buffers of every thread that has recorded spans, protected by registry_lock
+static std::mutex registry_lock;
+static std::vector<std::unique_ptr<Thread_Trace>>& registry()
+{
+	static std::vector<std::unique_ptr<Thread_Trace>> traces;
+	return traces;
+}
+
+// Buffer of the calling thread. Only the first call of each thread takes the lock
+static Thread_Trace& thread_trace()
+{
+	static thread_local Thread_Trace* trace = nullptr;
+
+	if (!trace)
+	{
+		std::unique_ptr<Thread_Trace> new_trace(new Thread_Trace());
+		new_trace->dropped_events = 0;
+		trace = new_trace.get();
+
+		std::lock_guard<std::mutex> lock(registry_lock);
+		new_trace->id = (int) registry().size();
+		new_trace->name = "thread " + std::to_string(new_trace->id);
+		registry().push_back(std::move(new_trace));
+	}
+
+	return *trace;
+}
+
+static std::string escape(const std::string& text)
+{
+	std::string escaped;
+
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+static std::int64_t nanoseconds(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+namespace stats
+{
+	std::atomic<bool> Trace::s_enabled(false);
+
+	// ============================================================================
+	// ============================ RECORDING FUNCTIONS ===========================
+	// ============================================================================
+
+	void Trace::set_thread_name(const std::string& name)
+	{
+		Thread_Trace& trace = thread_trace();
+
+		std::lock_guard<std::mutex> lock(registry_lock);
+		trace.name = name;
+	}
+
+	void Trace::record(
+		const char* name,
+		const char* category,
+		std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end,
+		int row,
+		int col)
+	{
+		Thread_Trace& trace = thread_trace();
+
+		if (trace.events.size() >= (size_t) MAX_EVENTS_PER_THREAD)
+		{
+			++trace.dropped_events;
+			return;
+		}
+
+		Trace_Event event;
+		event.name = name;
+		event.category = category;
+		event.start = nanoseconds(start - epoch);
+		event.duration = nanoseconds(end - start);
+		event.row = row;
+		event.col = col;
+		trace.events.push_back(event);
+	}
+
+	void Trace::clear()
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		for (const std::unique_ptr<Thread_Trace>& trace : registry())
+		{
+			trace->events.clear();
+			trace->dropped_events = 0;
+		}
+	}
+
+	// ============================================================================
+
+
+
+	// ============================================================================
+	// ============================= OUTPUT FUNCTIONS =============================
+	// ============================================================================
+
+	void Trace::write_json(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+
+		const std::ios::fmtflags flags = out.flags();
+		const std::streamsize precision = out.precision();
+		out << std::fixed << std::setprecision(3);
+
+		long long dropped_events = 0;
+		bool first = true;
+
+		out << "{\"traceEvents\":[";
+
+		for (const std::unique_ptr<Thread_Trace>& trace : registry())
+		{
+			dropped_events += trace->dropped_events;
+
+			// Metadata event naming the thread
+			out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+				<< trace->id << ",\"args\":{\"name\":\"" << escape(trace->name) << "\"}}";
+			first = false;
+
+			// Complete events, in microseconds
+			for (const Trace_Event& event : trace->events)
+			{
+				out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+					<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->id
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0;
+
+				if (event.row >= 0)
+					out << ",\"args\":{\"row\":" << event.row << ",\"col\":" << event.col << "}";
+
+				out << "}";
+			}
+		}
+
+		out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped_events << "}}\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	void Trace::save(const std::string& filename)
+	{
+		std::ofstream out(filename);
+		if (!out)
+			throw std::runtime_error("Cannot write " + filename);
+
+		write_json(out);
+
+		out.close();
+		if (!out)
+			throw std::runtime_error("Cannot write " + filename);
+	}
+
+	// ============================================================================
+}